@@ -13,9 +13,9 @@ void setup()
   Serial.begin(115200);
   LTE_SERIAL.begin(115200);
 
-  //UART_USB.println("Setting RTS low.");
-  pinMode(14, OUTPUT);
-  digitalWrite(14, 0);
+  // Pin 14 is wired to the modem's RTS input; the library drives it
+  // for hardware flow control
+  base.setFlowControl(14);
 
   // Initialize LTE Base
   Serial.println("Initializing...");
@@ -54,8 +54,9 @@ void loop()
   //  It sends the command it's given as an argument to the modem, and
   //  listens for a response. If the response contains the word "OK",
   //  the BoosterPack confirms that it has received our command, and
-  //  the function returns true. The function waits 2 seconds for a
-  //  response by default.
+  //  the function returns true. How long it waits for a response is
+  //  learned from how quickly the modem has answered similar commands
+  //  (see LTE_Timeouts.h).
   //  
   //  *** bool sendATCommand(const char* command) ***
   //  *** bool receiveData(uint timeout, uint baudDelay) ***
@@ -71,13 +72,19 @@ void loop()
   //  For example, in the following code:
   //      sendATCommand("AT+Command1");
   //      sendATCommand("AT+Command2");
-  //      receiveData(300,1000);
+  //      receiveData(300,1000,RECV_IDLE);
   //  We don't care about waiting for a response frmo the first AT command,
   //  only the second. In addition, because the timeout value is 300ms, we
   //  expect a quick response from the modem. Because the baudDelay is high,
   //  we continue to wait for data transmission for a long time after the
   //  initial connection is established - even if received data bytes are
   //  few and far between. This is perfect for slower/inconsistent connections.
+  //  Called without a timeout, receiveData() uses the learned deadline of
+  //  the command that was sent, like getCommandOK().
+  //  By default, receiveData() returns as soon as the modem sends a final
+  //  result code such as "OK" or "ERROR". RECV_IDLE tells it to keep
+  //  listening until the line goes quiet, so that the responses to both
+  //  commands are captured.
   //
   //
   //  After sending a command, you can access the response with char* getData().
@@ -1,6 +1,6 @@
 #include <Energia.h>
-#include <aJSON.h>
-#include "LTE_TCP.h"
+#include "LTE_HTTP.h"
+#include "LTE_JSON.h"
 
 //////////////////////////////////////////////////////////////////
 //       Getting Weather/Location Data with OpenWeatherMap      //
@@ -11,10 +11,10 @@
 //  This requires you to create a free account online, and      //
 //  generate an API key.                                        //
 //                                                              //
-//  We use the LTE_TCP class to open a socket and send a REST   //
-//  request to the OpenWeatherMap endpoint with our home city   //
-//  and API key, and use the Energia aJSON library to parse     //
-//  the response.                                               //
+//  We use the LTE_HTTP class to send a REST request to the     //
+//  OpenWeatherMap endpoint with our home city and API key, and //
+//  the LTE_JSON class to pick the fields we need out of the    //
+//  response while it is received, without storing all of it.  //
 //                                                              //
 //////////////////////////////////////////////////////////////////
  
@@ -25,8 +25,13 @@
 // Define UART pins between boosterpack and launchpad
 #define LTE_SERIAL Serial1
 
-// Initialize LTEHttp object
+// Initialize LTE_TCP object, and an HTTP client using its socket
 LTE_TCP lte(&LTE_SERIAL, &Serial);
+LTE_HTTP http(&lte);
+
+// JSON tokenizer, and the fields of the response we want
+LTE_JSON json;
+int city, description, temperature;
 
 void setup()
 {
@@ -34,9 +39,9 @@ void setup()
   Serial.begin(115200);
   LTE_SERIAL.begin(115200);
 
-  //UART_USB.println("Setting RTS low.");
-  pinMode(14, OUTPUT);
-  digitalWrite(14, 0);
+  // Pin 14 is wired to the modem's RTS input; the library drives it
+  // for hardware flow control
+  lte.setFlowControl(14);
 
   delay(2000);
 
@@ -47,74 +52,44 @@ void setup()
   }
   else Serial.println("Initialization success!");
   Serial.println("UART connection ready.\r\n");
+
+  city = json.addPath("name");
+  description = json.addPath("weather[0].description");
+  temperature = json.addPath("main.temp");
+  http.onBody(LTE_JSON::onData, &json);
 }
 
 void loop()
 {
-  // Open TCP connection
-  if (!lte.socketOpen("api.openweathermap.org")) {
-    Serial.println("Failed to open TCP socket.\r\n");
-  }
-  else {
-    // Form an HTTP packet
-    char packet[256];
-    strcpy(packet, "GET /data/2.5/weather?q=");
-    strcat(packet, HOME_CITY);
-    strcat(packet, "&appid=");
-    strcat(packet, OWM_API_KEY);
-    strcat(packet, " HTTP/1.0\r\nConnection: close\r\n\r\n");
-    
-    Serial.print("HTTP Packet:\r\n");
-    Serial.print(packet);
-    
-    // Send HTTP packet
-    if (lte.socketWrite(packet) == -1) {
-      Serial.println("... Failed to send.\r\n");
-    }
-
-    // Wait for a response
-    delay(5000);
+  // Form the request path
+  char path[128];
+  strcpy(path, "/data/2.5/weather?q=");
+  strcat(path, HOME_CITY);
+  strcat(path, "&appid=");
+  strcat(path, OWM_API_KEY);
 
-    // Receive a response
-    int num = lte.socketReceive();
-    if (num < 0) {
-      Serial.println("... Error in receiving data.\r\n");
-    } else {
-      Serial.println("Response received.");
+  Serial.print("GET ");
+  Serial.println(path);
 
-      // First, use socketParseFind() to find the start of the JSON object
-      // and skip past the HTTP header information. Then, use the aJSON
-      // library to parse the JSON object.
-      aJsonObject* owm_json = aJson.parse(lte.socketParseFind("\r\n\r\n"));
-      if (owm_json != NULL) {
-        aJsonObject* city = aJson.getObjectItem(owm_json, "name");
-        aJsonObject* weather = aJson.getObjectItem(owm_json, "weather");
-        if (city != NULL && weather != NULL) {
-          Serial.print("The weather in ");
-          Serial.print(city->valuestring);
-          Serial.print(" is: ");
-
-          aJsonObject* arrayptr = weather->child;
-          while(arrayptr != NULL) {
-            Serial.print(aJson.getObjectItem(arrayptr, "description")->valuestring);
-            if (arrayptr->next != NULL) Serial.print(", ");
-            arrayptr = arrayptr->next;
-          }
-          Serial.println("");
-          
-          Serial.print("The temperature is: ");
-          aJsonObject* main = aJson.getObjectItem(owm_json, "main");
-          Serial.print(((double)(aJson.getObjectItem(main, "temp")->valuefloat) * (9/(double)5)) - 459.67);
-          Serial.println(" degrees Fahrenheit.");
-        }
-      } else Serial.println("Error.");
-    }
+  // Send the request. The body is passed to json as it arrives.
+  json.reset();
+  int status = http.get("api.openweathermap.org", path);
+  if (status < 0) {
+    Serial.println("... Request failed.\r\n");
+  }
+  else if (status != 200 || !json.found(city) || !json.found(temperature)) {
+    Serial.print("Error, status ");
+    Serial.println(status);
+  }
+  else {
+    Serial.print("The weather in ");
+    Serial.print(json.getString(city));
+    Serial.print(" is: ");
+    Serial.println(json.getString(description));
 
-    // Closing socket
-    while(!lte.socketClose()) {
-      Serial.println("... Failed to close TCP socket.\r\n");
-      delay(200);
-    }
+    Serial.print("The temperature is: ");
+    Serial.print((json.getFloat(temperature) * (9/(double)5)) - 459.67);
+    Serial.println(" degrees Fahrenheit.");
   }
 
   Serial.println("\r\n");
@@ -1,11 +1,18 @@
 #include <Energia.h>
-#include "LTE_TCP.h"
+#include "LTE_HTTP.h"
 
 // Define UART pins between boosterpack and launchpad
 #define LTE_SERIAL Serial1
 
-// Initialize LTE_TCP object
+// Initialize LTE_TCP object, and an HTTP client using its socket
 LTE_TCP lte(&LTE_SERIAL, &Serial);
+LTE_HTTP http(&lte);
+
+// Prints each piece of the response body as it arrives
+void printBody(const char* buf, uint32_t len, void* context)
+{
+  Serial.write((const uint8_t*) buf, len);
+}
 
 void setup()
 {
@@ -13,9 +20,9 @@ void setup()
   Serial.begin(115200);
   LTE_SERIAL.begin(115200);
 
-  //UART_USB.println("Setting RTS low.");
-  pinMode(14, OUTPUT);
-  digitalWrite(14, 0);
+  // Pin 14 is wired to the modem's RTS input; the library drives it
+  // for hardware flow control
+  lte.setFlowControl(14);
 
   delay(2000);
 
@@ -25,7 +32,13 @@ void setup()
     Serial.println("Initialization failed");
   }
   else Serial.println("Initialization success!");
+
+  // Move the UART to the fastest rate the line carries
+  Serial.print("Baud rate: ");
+  Serial.println(lte.negotiateBaudRate());
   Serial.println("UART connection ready.\r\n");
+
+  http.onBody(printBody);
 }
 
 void loop()
@@ -35,62 +48,32 @@ void loop()
   //                 Transfer data over TCP/IP                    //
   //////////////////////////////////////////////////////////////////
   //                                                              //
-  //  This example sends a simple HTTP GET request using a TCP    //
-  //  socket, and its related functions. To do this, we open a    //
-  //  socket, form an HTTP request, send it over the TCP socket,  //
-  //  and read any responses.                                     //
+  //  This example sends a simple HTTP GET request with the       //
+  //  LTE_HTTP client. It opens a TCP socket, sends the request   //
+  //  and prints the response body while it is received.          //
   //                                                              //
   //  The website we're querying is www.energia.nu, and the       //
   //  resource is /hello. This page returns a basic website with  //
   //  the text "Hello, World."                                    //
   //                                                              //
+  //  The connection is kept alive, so the next request in        //
+  //  loop() is sent without opening a new socket, as long as the //
+  //  server keeps it open.                                       //
+  //                                                              //
   //////////////////////////////////////////////////////////////////
   
-  // Open TCP connection
-  Serial.println("Opening TCP socket ...");
-  if (!lte.socketOpen("www.energia.nu")) {
-    Serial.println("Failed to open TCP socket.\r\n");
-  }
-  else {
-    Serial.println("... Success! Opened TCP connection to \"www.energia.nu\".\r\n");
-    
-    // Form an HTTP packet
-    char* httpPacket = "GET /hello HTTP/1.1\r\nHost: www.energia.nu\r\nConnection: close\r\n\r\n";
-    Serial.print("HTTP Packet to send:\r\n");
-    Serial.println(httpPacket);
-    Serial.println("");
-    
-    // Send HTTP packet
-    Serial.println("Sending Packet ...");
-    if (lte.socketWrite(httpPacket) == -1) {
-      Serial.println("... Failed to send.\r\n");
-    } else {
-      Serial.println("... Success!\r\n");
-    }
-
-    // Wait for a response
-    delay(2000);
-
-    // Receive a response
-    Serial.println("Attempting to receive response ...");
-    int num = lte.socketReceive();
-    if (num < 0) {
-      Serial.println("... Error in receiving data.\r\n");
-    } else {
-      Serial.print("... Success! ");
-      Serial.print(num);
-      Serial.println(" bytes received.");
-      Serial.println("Received data: ");
-      Serial.println(lte.receivedData());
-    }
-
-    // Closing socket
-    Serial.println("Closing socket ...");
-    if (lte.socketClose()) {
-      Serial.println("... Success!\r\n");
-    } else {
-      Serial.println("... Failed to close TCP socket.\r\n");
-    }
+  Serial.println("Sending GET /hello to \"www.energia.nu\" ...");
+  Serial.println("Received data: ");
+  int status = http.get("www.energia.nu", "/hello");
+  Serial.println("");
+  if (status < 0) {
+    Serial.println("... Request failed.\r\n");
+  } else {
+    Serial.print("... Success! Status ");
+    Serial.print(status);
+    Serial.print(", ");
+    Serial.print(http.getBodyLength());
+    Serial.println(" body bytes received.");
   }
 
   Serial.println("\r\n");
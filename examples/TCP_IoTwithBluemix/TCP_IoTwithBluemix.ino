@@ -2,10 +2,9 @@
 #include <I2CBitBang.h>
 #include <StLsm6ds3.h>
 
-#include <aJSON.h>
 #include <Energia.h>
 
-#include "LTE_TCP.h"
+#include "LTE_MQTT.h"
 
 ///////////////////////////////////////////////////////////////////
 //      Using IBM Bluemix & Twilio & Onboard Sensors for         //
@@ -17,11 +16,14 @@
 //  sent to your phone whenever your launchpad is moved. We      //
 //  also use the onboard sensors to measure temperature.         //
 //                                                               //
+//  The EVK4 stays connected to an MQTT broker and publishes     //
+//  each motion event (QoS 1) and the temperature (QoS 0) on     //
+//  it; Node-RED subscribes to the motion events. Messages       //
+//  published close together go out in one AT command.           //
+//                                                               //
 //  *** Set up IBM Bluemix ***                                   //
 //  1) Create a free account at www.bluemix.net                  //
 //  2) Catalog > Boilerplates > Node-RED Starter                 //
-//     i. Name your app                                          //
-//    ii. Fill in your app name in the define below              //
 //  3) Go to your application                                    //
 //                                                               //
 //  *** Set up Twilio ***                                        //
@@ -30,21 +32,21 @@
 //  3) Find Account SID and Authentication Token in Dashboard    //
 //                                                               //
 //  *** Node-RED editor ***                                      //
-//  1) Create the following nodes in the editor, and             //
-//     connect them as shown                                     //
-//    [http (input)] ----> [http response (output)]              //
+//  1) Import node_red_template.json, or create the following    //
+//     nodes in the editor, and connect them as shown            //
+//    [mqtt (input)] ----> [debug]                               //
 //         |                                                     //
 //         V                                                     //
 //    [function] --> [template] --> [twilio (output)]            //
 //                                                               //
 //  2) Edit the nodes to have the following values:              //
-//  [http (input)]                                               //
-//    * Method: GET                                              //
-//    * URL: /sensor                                             //
+//  [mqtt (input)]                                               //
+//    * Server: the MQTT_BROKER below, port 1883                 //
+//    * Topic: evk4/+/motion                                     //
 //  [function]                                                   //
 //    * Function:                                                //
-//      msg.payload.movement = msg.payload.movement.toLowerCase()//
-//      if (msg.payload.movement === "true") {                   //
+//      var event = JSON.parse(msg.payload);                     //
+//      if (event.movement === true) {                           //
 //        return msg;                                            //
 //      }                                                        //
 //    * Outputs: 1                                               //
@@ -64,20 +66,26 @@
 //                                                               //
 ///////////////////////////////////////////////////////////////////
 
-// COPY YOUR BLUEMIX APP NAME HERE
-// For example, the APP_NAME of myapp.bluemix.net would be "myapp"
-#define APP_NAME "my"
+// MQTT broker the EVK4 and Node-RED both connect to. The public test
+// broker is open to anyone: use your own for anything but a trial, and
+// set the same server in the Node-RED template's mqtt-broker node.
+#define MQTT_BROKER "test.mosquitto.org"
+
+// Unique name of this EVK4. The broker keeps its session under it.
+#define DEVICE_ID "evk4-0001"
 
 // Define UART pins between boosterpack and launchpad
 #define LTE_SERIAL Serial1
 
-// Initialize LTEHttp object
+// Initialize LTE tcp object, and the MQTT client on its socket
 LTE_TCP lte(&LTE_SERIAL, &Serial);
+LTE_MQTT mqtt(&lte);
 
 // Initialize onboard sensors
 StLsm6ds3 myStLsm6ds3(0x6A, &Serial);
 long long last_temp;
 long long last_moved;
+long long last_connect;
 bool moving;
 
 void setup()
@@ -88,9 +96,9 @@ void setup()
   Wire.begin();
   myStLsm6ds3.begin();
   
-  //UART_USB.println("Setting RTS low.");
-  pinMode(14, OUTPUT);
-  digitalWrite(14, 0);
+  // Pin 14 is wired to the modem's RTS input; the library drives it
+  // for hardware flow control
+  lte.setFlowControl(14);
 
   delay(2000);
 
@@ -102,9 +110,10 @@ void setup()
   else Serial.println("Initialization success!");
   Serial.println("Initialized. UART connection ready.\r\n");
 
+  connectBroker();
   last_temp = millis();
   last_moved = millis();
-  bool moving = false;
+  moving = false;
 }
 
 void loop()
@@ -114,25 +123,22 @@ void loop()
   myStLsm6ds3.readTemperature(temp);
   myStLsm6ds3.readGyro(gyro);
 
+  // Reconnect at most every 10 seconds if the connection was lost
+  if (!mqtt.connected() && ((millis() - last_connect) > 10000)) {
+    connectBroker();
+  }
+
   // If sufficient movement, then tell your Bluemix App to 
   // send a text message.
   if ((abs(gyro[0]) + abs(gyro[1]) + abs(gyro[2])) > 20) {
     Serial.println("Someone's moving your EVK4!");
     if (!moving) {
       Serial.println("Sending text via Twilio ...");
-      char remoteURL[256];
-      //strcpy(remoteURL, "http://");
-      strcpy(remoteURL, APP_NAME);
-      strcat(remoteURL, ".mybluemix.net");
-      char* resource = "/sensor?movement=true";
-
-      // Send request, get response
-      char* response = sendHttpGet(remoteURL, resource);
-
-      // Parse response into JSON object
-      Serial.println("Response received:");
-      aJsonObject* response_json = aJson.parse(strstr(response, "{"));
-      Serial.println(aJson.print(response_json));
+      // QoS 1: the broker acknowledges it, see messageAcked()
+      if (mqtt.publish("evk4/" DEVICE_ID "/motion",
+                       "{\"movement\":true}", 1) < 0) {
+        Serial.println("... Failed to publish.");
+      }
     }
     moving = true;
     last_moved = millis();
@@ -143,7 +149,7 @@ void loop()
     moving = false;
   }
 
-  // Prints current temperature in both Celcius and
+  // Prints and publishes current temperature in both Celcius and
   // Fahrenheit every 10 seconds
   if ((millis() - last_temp) > 10000) {
     last_temp = millis();
@@ -152,44 +158,34 @@ void loop()
     Serial.print(" degrees Celcius, or ");
     Serial.print(((temp*9.0/5.0)) + 32.0);
     Serial.println(" degrees Fahrenheit.");
-  }
 
-  delay(100);
-}
-
-// Returns response data from HTTP GET request
-char* sendHttpGet(char* remoteURL, char* resource) {
-  int tries = 0;
-  while(!lte.socketOpen(remoteURL) && tries < 5) tries++;
-  if (tries >= 5) {
-    Serial.println("Failed to open connection.");
-    return "";
-  }
-  Serial.println("Connection opened.");
-
-  char packet[256];
-  strcpy(packet, "GET ");
-  strcat(packet, resource);
-  strcat(packet, " HTTP/1.1\r\nConnection: close\r\nHost: ");
-  strcat(packet, remoteURL);
-  strcat(packet, "\r\n");
-  strcat(packet, "Content-Length: 0\r\n\r\n");
-
-  if (lte.socketWrite(packet) == -1) {
-    Serial.println("... Failed to send.");
-    return "";
+    char payload[32];
+    int tenths = (int) (temp * 10.0);
+    sprintf(payload, "{\"celsius\":%s%d.%d}", (tenths < 0) ? "-" : "",
+            abs(tenths) / 10, abs(tenths) % 10);
+    mqtt.publish("evk4/" DEVICE_ID "/temperature", payload);
   }
 
-  delay(2000);
+  // Sends what was published, reads acknowledgements, keeps the
+  // connection alive
+  mqtt.loop();
 
-  if (lte.socketReceive() <= 0) Serial.println("... Error in receiving.");
-  char* ret = lte.getReceivedData();
+  delay(100);
+}
 
-  // Closing socket
-  while(!lte.socketClose()) {
-    Serial.println("... Failed to close socket.");
-    delay(200);
+// Connects to the broker. The session is persistent, so the broker
+// keeps it while the EVK4 is offline.
+void connectBroker() {
+  last_connect = millis();
+  Serial.println("Connecting to MQTT broker ...");
+  mqtt.onAck(messageAcked);
+  if (mqtt.connect(MQTT_BROKER, 1883, DEVICE_ID)) {
+    Serial.println("Connected.");
   }
+  else Serial.println("... Failed to connect.");
+}
 
-  return ret;
+// Called when the broker has received a motion event
+void messageAcked(uint16_t packetId, void* context) {
+  Serial.println("Motion event delivered.");
 }
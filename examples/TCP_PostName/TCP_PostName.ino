@@ -38,9 +38,9 @@ void setup()
   Serial.begin(115200);
   LTE_SERIAL.begin(115200);
 
-  //UART_USB.println("Setting RTS low.");
-  pinMode(14, OUTPUT);
-  digitalWrite(14, 0);
+  // Pin 14 is wired to the modem's RTS input; the library drives it
+  // for hardware flow control
+  lte.setFlowControl(14);
 
   delay(2000);
 
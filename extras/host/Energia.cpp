@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Host-side Energia shim for the Telit LE910 library.
+ */
+
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Energia.h"
+
+HostConsole Serial;
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+static const uint64_t bootMicros = monotonicMicros();
+
+uint32_t millis() {
+    return (uint32_t) ((monotonicMicros() - bootMicros) / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t) (monotonicMicros() - bootMicros);
+}
+
+void delay(uint32_t ms) {
+    usleep(ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    usleep(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void) pin;
+    (void) mode;
+}
+
+// Pin levels, so that the simulated modem can see RTS
+static uint8_t pinLevels[256];
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    pinLevels[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    return pinLevels[pin];
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+        if (write(buffer[n]) == 0) break;
+        n++;
+    }
+    return n;
+}
+
+size_t Print::print(long n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return write(buf);
+}
+
+size_t HostConsole::write(uint8_t c) {
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HostConsole::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
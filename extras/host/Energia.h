@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Host-side Energia shim for the Telit LE910 library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * This header stands in for <Energia.h> when the library is built on a
+ * Linux host. It provides the small subset of the Energia core that the
+ * library uses: millis()/micros()/delay(), pin functions (no-ops), and a
+ * Print/Stream/HardwareSerial hierarchy whose I/O methods are virtual so a
+ * simulated modem (see LE910Sim.h) can sit behind the serial port.
+ */
+
+
+#ifndef LTE_HOST_ENERGIA_H_
+#define LTE_HOST_ENERGIA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+
+class Print {
+public:
+    virtual ~Print() {};
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) {
+        if (str == NULL) return 0;
+        return write((const uint8_t*) str, strlen(str));
+    }
+    size_t write(const char* buffer, size_t size) {
+        return write((const uint8_t*) buffer, size);
+    }
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(long n);
+    size_t println() { return write("\r\n"); }
+    size_t println(const char* str) { return print(str) + println(); }
+    size_t println(long n) { return print(n) + println(); }
+};
+
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+
+class HardwareSerial : public Stream {
+public:
+    virtual void begin(unsigned long baud) { (void) baud; };
+    virtual void end() {};
+    virtual int available() { return 0; };
+    virtual int read() { return -1; };
+    virtual int peek() { return -1; };
+    virtual void flush() {};
+    virtual size_t write(uint8_t) { return 1; };
+    using Print::write;
+};
+
+
+// Writes to the host's stdout. Stands in for the LaunchPad's USB UART.
+class HostConsole : public HardwareSerial {
+public:
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    using Print::write;
+};
+
+extern HostConsole Serial;
+
+#endif
@@ -0,0 +1,933 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Scripted Telit LE910 modem simulator for host builds.
+ */
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "LE910Sim.h"
+
+
+/** LE910 simulator constructor. Starts with command echo on, like a modem
+ *  fresh out of reset, at 115200 baud with a 2 ms command latency.
+ */
+LE910Sim::LE910Sim() {
+    lastOutUs = 0;
+    lastInUs = 0;
+    defaultLatencyMs = 2;
+    numLatencies = 0;
+    cmdLatencyMs = 0;
+    mode = MODE_COMMAND;
+    ssendConn = 0;
+    ssendLeft = 0;
+    onlineConn = 0;
+    escapeGuardMs = 1000;
+    dnsLatencyMs = 0;
+    escapeCount = 0;
+    escapeQueued = false;
+    escapeQueueIndex = 0;
+    escapeUs = 0;
+    echo = true;
+    ifcByTe = 2;
+    ifcByDce = 2;
+    errorAboveBaud = 0;
+    errorInterval = 0;
+    errorCount = 0;
+    rtsPin = -1;
+    rtsHeld = false;
+    rtsHeldUs = 0;
+    attached = true;
+    pdpActive = false;
+    peerHandler = NULL;
+    peerContext = NULL;
+    for (int i = 0; i <= SIM_SSL_SOCKET; i++) {
+        sockets[i].state = 0;
+        sockets[i].port = 0;
+        sockets[i].srMode = 0;
+        sockets[i].noCarrierMode = 0;
+        sockets[i].udp = false;
+    }
+    sslEnabled = false;
+    sslAuth = 0;
+    sslSRingMode = 0;
+    sslClosure = 0;
+    secDataType = 0;
+    sessionValid = false;
+    sessionPort = 0;
+    fullHandshakeMs = 0;
+    resumedHandshakeMs = 0;
+    setBaud(115200);
+    resetStats();
+}
+
+/** Opens the LaunchPad side of the UART. The modem keeps its own rate. */
+void LE910Sim::begin(unsigned long baud) {
+    hostBaud = baud;
+}
+
+/** Sets the UART rate of both sides, used to pace bytes in both directions.
+ *
+ *  @param  baud    Bits per second. 10 bits are sent per byte.
+ */
+void LE910Sim::setBaud(uint32_t baud) {
+    if (baud == 0) return;
+    modemBaud = baud;
+    hostBaud = baud;
+    byteUs = (10000000UL + baud - 1) / baud;
+}
+
+/** Sets the processing latency of every command without its own latency.
+ *
+ *  @param  ms  Time between the end of a command and its first response byte.
+ */
+void LE910Sim::setLatency(uint32_t ms) {
+    defaultLatencyMs = ms;
+}
+
+/** Sets the processing latency of the commands starting with cmdPrefix,
+ *  for example "AT#SGACT" or "AT#SD".
+ *
+ *  @param  cmdPrefix   Command prefix.
+ *  @param  ms          Latency in milliseconds.
+ *  @return bool        False if the latency table is full.
+ */
+bool LE910Sim::setLatency(const char* cmdPrefix, uint32_t ms) {
+    for (int i = 0; i < numLatencies; i++) {
+        if (latencies[i].prefix == cmdPrefix) {
+            latencies[i].ms = ms;
+            return true;
+        }
+    }
+    if (numLatencies >= SIM_MAX_LATENCIES) return false;
+    latencies[numLatencies].prefix = cmdPrefix;
+    latencies[numLatencies].ms = ms;
+    numLatencies++;
+    return true;
+}
+
+/** Makes the modem ignore the commands starting with cmdPrefix, so that
+ *  they time out.
+ *
+ *  @param  cmdPrefix   Command prefix, NULL to answer every command.
+ */
+void LE910Sim::setUnanswered(const char* cmdPrefix) {
+    unanswered = (cmdPrefix == NULL) ? "" : cmdPrefix;
+}
+
+/** Corrupts every interval-th byte in either direction while the modem's
+ *  UART runs faster than aboveBaud, like a line too long or noisy for it.
+ *
+ *  @param  aboveBaud   Fastest rate that works.
+ *  @param  interval    Bytes per corrupted byte, 0 for none.
+ */
+void LE910Sim::setLineErrors(uint32_t aboveBaud, uint32_t interval) {
+    errorAboveBaud = aboveBaud;
+    errorInterval = interval;
+    errorCount = 0;
+}
+
+/** Wires the modem's RTS input to a LaunchPad pin. With AT+IFC RTS flow
+ *  control, the modem sends nothing while the pin is high.
+ *
+ *  @param  pin     Pin number, -1 for none.
+ */
+void LE910Sim::setRTSPin(int pin) {
+    rtsPin = pin;
+    rtsHeld = false;
+}
+
+/** Sets the silence required before and after "+++" for it to be taken as
+ *  the online mode escape sequence (ATS12, 1 s by default).
+ *
+ *  @param  ms  Guard time in milliseconds.
+ */
+void LE910Sim::setEscapeGuard(uint32_t ms) {
+    escapeGuardMs = ms;
+}
+
+/** Sets the time a DNS lookup adds to AT#QDNS, and to AT#SD when it is
+ *  given a host name rather than an IP address.
+ *
+ *  @param  ms      Lookup time.
+ */
+void LE910Sim::setDNSLatency(uint32_t ms) {
+    dnsLatencyMs = ms;
+}
+
+/** Sets the time AT#SSLD takes for the TLS handshake.
+ *
+ *  @param  fullMs      Full handshake.
+ *  @param  resumedMs   Abbreviated handshake resuming a kept session.
+ */
+void LE910Sim::setHandshakeLatency(uint32_t fullMs, uint32_t resumedMs) {
+    fullHandshakeMs = fullMs;
+    resumedHandshakeMs = resumedMs;
+}
+
+/** Returns a certificate or key stored with AT#SSLSECDATA.
+ *
+ *  @param  type    0 client certificate, 1 CA certificate, 2 client key.
+ */
+const std::string& LE910Sim::certificate(int type) {
+    static const std::string empty;
+    return ((type < 0) || (type > 2)) ? empty : certs[type];
+}
+
+/** Sets what the remote peer sends back after each AT#SSEND payload.
+ *
+ *  @param  reply   Reply bytes. May contain NUL bytes.
+ *  @param  len     Reply length. 0 disables the reply.
+ */
+void LE910Sim::setRemoteReply(const char* reply, size_t len) {
+    remoteReply.assign(reply, len);
+}
+
+/** Sets a function called with every AT#SSEND, AT#SSENDEXT or
+ *  AT#SSLSENDEXT payload, after the OK. It answers by calling
+ *  pushRemoteData(). The scripted reply is not sent while one is set.
+ *
+ *  @param  handler Remote peer, NULL to go back to the scripted reply.
+ *  @param  context Passed to handler unchanged.
+ */
+void LE910Sim::setRemoteHandler(SimPeerHandler handler, void* context) {
+    peerHandler = handler;
+    peerContext = context;
+}
+
+/** Queues data from the remote peer on a socket, as if it had arrived over
+ *  the network.
+ */
+void LE910Sim::pushRemoteData(int connId, const char* buf, size_t len) {
+    Socket* s = peer(connId);
+    if (s == NULL) return;
+    checkEscape();
+    if ((mode == MODE_ONLINE) && (connId == onlineConn)) {
+        schedule(buf, len, now());
+        return;
+    }
+    s->pending.append(buf, len);
+    if (s->udp) s->datagrams.push_back(len);
+    if (s->state == 2) s->state = 3;
+    if ((s->state == 3) && (connId == SIM_SSL_SOCKET)) {
+        char sring[32];
+        snprintf(sring, sizeof(sring), "SSLSRING: 1,%u",
+                 (unsigned int) s->pending.size());
+        if (sslSRingMode == 1) sendUnsolicited(sring);
+    }
+    else if (s->state == 3) {
+        char sring[32];
+        if (s->srMode == 1)
+            snprintf(sring, sizeof(sring), "SRING: %d,%u", connId,
+                     (unsigned int) s->pending.size());
+        else snprintf(sring, sizeof(sring), "SRING: %d", connId);
+        sendUnsolicited(sring);
+    }
+}
+
+/** Returns everything the remote peer received on a socket. */
+const std::string& LE910Sim::remoteReceived(int connId) {
+    static const std::string empty;
+    Socket* s = peer(connId);
+    return (s == NULL) ? empty : s->received;
+}
+
+/** Closes a socket from the remote side. A socket in command mode is
+ *  reported with "NO CARRIER" in the format selected with AT#SCFGEXT2, and
+ *  data already received on it can still be read with AT#SRECV.
+ */
+void LE910Sim::remoteClose(int connId) {
+    Socket* s = peer(connId);
+    if ((s == NULL) || (s->state == 0)) return;
+    checkEscape();
+    s->state = 0;
+    if (connId == SIM_SSL_SOCKET) {
+        s->pending.clear();
+        s->datagrams.clear();
+        sessionValid = (sslClosure == 1);
+        return;     // Found out with AT#SSLS
+    }
+    if ((mode == MODE_ONLINE) && (connId == onlineConn)) {
+        mode = MODE_COMMAND;
+        escapeQueued = false;
+        sendUnsolicited("NO CARRIER");
+        return;
+    }
+    char urc[32];
+    if (s->noCarrierMode == 1)
+        snprintf(urc, sizeof(urc), "NO CARRIER: %d", connId);
+    else if (s->noCarrierMode == 2)
+        snprintf(urc, sizeof(urc), "NO CARRIER: %d,1", connId);
+    else return;
+    sendUnsolicited(urc);
+}
+
+/** Deactivates the PDP context from the network side, without telling the
+ *  host. Every socket is closed; the next AT#SD fails until the context is
+ *  activated again.
+ *
+ *  @return void
+ */
+void LE910Sim::dropContext() {
+    checkEscape();
+    pdpActive = false;
+    for (int i = 1; i <= SIM_SSL_SOCKET; i++) {
+        sockets[i].state = 0;
+        sockets[i].pending.clear();
+        sockets[i].datagrams.clear();
+    }
+    if (mode == MODE_ONLINE) {
+        mode = MODE_COMMAND;
+        escapeQueued = false;
+        sendUnsolicited("NO CARRIER");
+    }
+}
+
+/** Sends an unsolicited result code line, e.g. "SRING: 1", framed by
+ *  "\r\n" like the modem does. It goes out after any queued response.
+ *
+ *  @param  line    URC line without "\r\n".
+ *  @param  delayMs Delay from now before the line is sent.
+ */
+void LE910Sim::sendUnsolicited(const char* line, uint32_t delayMs) {
+    std::string urc = std::string("\r\n") + line + "\r\n";
+    schedule(urc.data(), urc.size(), now() + (uint64_t) delayMs * 1000);
+}
+
+void LE910Sim::resetStats() {
+    commands = 0;
+    dnsQueries = 0;
+    handshakes = 0;
+    resumptions = 0;
+    txBytes = 0;
+    rxBytes = 0;
+}
+
+uint64_t LE910Sim::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+/** Number of queued bytes whose transmission has completed. Queued bytes
+ *  are in time order, so this is a binary search for the first byte still
+ *  on the wire.
+ */
+size_t LE910Sim::readyCount() {
+    uint64_t t = now();
+    bool held = (rtsPin >= 0) && (ifcByTe == 2) &&
+                (digitalRead(rtsPin) == HIGH);
+    if (held && !rtsHeld) {
+        rtsHeld = true;
+        rtsHeldUs = t;
+    }
+    else if (!held && rtsHeld) {
+        // Whatever was not on the wire yet goes out that much later
+        uint64_t pausedUs = t - rtsHeldUs;
+        for (size_t i = 0; i < outQueue.size(); i++)
+            if (outQueue[i].readyUs > rtsHeldUs)
+                outQueue[i].readyUs += pausedUs;
+        if (lastOutUs > rtsHeldUs) lastOutUs += pausedUs;
+        rtsHeld = false;
+    }
+    if (rtsHeld) t = rtsHeldUs;
+    size_t lo = 0;
+    size_t hi = outQueue.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (outQueue[mid].readyUs <= t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int LE910Sim::available() {
+    checkEscape();
+    return (int) readyCount();
+}
+
+/** Waits until every written byte has gone out on the wire. */
+void LE910Sim::flush() {
+    while (lastInUs > now()) {}
+}
+
+int LE910Sim::read() {
+    checkEscape();
+    if (readyCount() == 0) return -1;
+    Byte b = outQueue.front();
+    outQueue.pop_front();
+    txBytes++;
+    if (b.baud != hostBaud) return 0xFF;    // Framing garbage
+    if (lineError()) b.c ^= 0x80;
+    return b.c;
+}
+
+int LE910Sim::peek() {
+    if (readyCount() == 0) return -1;
+    if (outQueue.front().baud != hostBaud) return 0xFF;
+    return outQueue.front().c;
+}
+
+/** Counts a byte crossing the line, returning true if it is corrupted. */
+bool LE910Sim::lineError() {
+    if ((errorInterval == 0) || (modemBaud <= errorAboveBaud)) return false;
+    if (++errorCount < errorInterval) return false;
+    errorCount = 0;
+    return true;
+}
+
+/** Queues bytes towards the LaunchPad. The first byte goes out no earlier
+ *  than startUs, and bytes follow each other at the UART character time.
+ */
+void LE910Sim::schedule(const char* buf, size_t len, uint64_t startUs) {
+    uint64_t t = (lastOutUs > startUs) ? lastOutUs : startUs;
+    for (size_t i = 0; i < len; i++) {
+        t += byteUs;
+        Byte b;
+        b.readyUs = t;
+        b.baud = modemBaud;
+        b.c = (uint8_t) buf[i];
+        outQueue.push_back(b);
+    }
+    lastOutUs = t;
+}
+
+void LE910Sim::respond(const std::string& response) {
+    schedule(response.data(), response.size(),
+             lastInUs + (uint64_t) cmdLatencyMs * 1000);
+}
+
+void LE910Sim::ok(const std::string& info) {
+    if (info.empty()) respond("\r\nOK\r\n");
+    else respond("\r\n" + info + "\r\n\r\nOK\r\n");
+}
+
+void LE910Sim::error() {
+    respond("\r\nERROR\r\n");
+}
+
+uint32_t LE910Sim::latencyFor(const std::string& cmd) {
+    for (int i = 0; i < numLatencies; i++) {
+        if (cmd.compare(0, latencies[i].prefix.size(),
+                        latencies[i].prefix) == 0)
+            return latencies[i].ms;
+    }
+    return defaultLatencyMs;
+}
+
+LE910Sim::Socket* LE910Sim::socket(int connId) {
+    if ((connId < 1) || (connId > SIM_NUM_SOCKETS)) return NULL;
+    return &sockets[connId];
+}
+
+/** Like socket(), but also accepts SIM_SSL_SOCKET. */
+LE910Sim::Socket* LE910Sim::peer(int connId) {
+    if (connId == SIM_SSL_SOCKET) return &sockets[SIM_SSL_SOCKET];
+    return socket(connId);
+}
+
+/** Switches a socket to online mode after sending CONNECT. Data that was
+ *  pending on the socket follows the CONNECT.
+ */
+void LE910Sim::goOnline(int connId) {
+    Socket* s = socket(connId);
+    mode = MODE_ONLINE;
+    onlineConn = connId;
+    escapeCount = 0;
+    escapeQueued = false;
+    s->state = 1;
+    respond("\r\nCONNECT\r\n");
+    if (!s->pending.empty()) {
+        schedule(s->pending.data(), s->pending.size(), 0);
+        s->pending.clear();
+        s->datagrams.clear();
+    }
+}
+
+/** Handles a byte written in online mode. "+++" preceded by the guard time
+ *  queues an OK for when the guard time after it has passed; any byte
+ *  before that cancels the escape and the '+' are sent as data.
+ *
+ *  @param  c           Byte written.
+ *  @param  prevInUs    Arrival time of the previous byte.
+ */
+void LE910Sim::onlineByte(uint8_t c, uint64_t prevInUs) {
+    uint64_t guardUs = (uint64_t) escapeGuardMs * 1000;
+    if ((c == '+') && (escapeCount < 3) &&
+        ((escapeCount > 0) || (lastInUs - byteUs >= prevInUs + guardUs))) {
+        escapeCount++;
+        if (escapeCount == 3) {
+            escapeQueued = true;
+            escapeQueueIndex = outQueue.size();
+            escapeUs = lastInUs + guardUs;
+            cmdLatencyMs = 0;
+            schedule("\r\nOK\r\n", 6, escapeUs);
+        }
+        return;
+    }
+
+    // Not an escape: the '+' were data
+    if (escapeQueued) {
+        outQueue.erase(outQueue.begin() + escapeQueueIndex, outQueue.end());
+        lastOutUs = outQueue.empty() ? 0 : outQueue.back().readyUs;
+        escapeQueued = false;
+    }
+    Socket* s = socket(onlineConn);
+    s->received.append(escapeCount, '+');
+    s->received += (char) c;
+    escapeCount = 0;
+}
+
+/** Leaves online mode once the guard time after "+++" has passed. */
+void LE910Sim::checkEscape() {
+    if (!escapeQueued || (now() < escapeUs)) return;
+    Socket* s = socket(onlineConn);
+    s->state = s->pending.empty() ? 2 : 3;
+    mode = MODE_COMMAND;
+    escapeQueued = false;
+    escapeCount = 0;
+}
+
+/** Receives one byte from the LaunchPad. */
+size_t LE910Sim::write(uint8_t c) {
+    // Block while the LaunchPad's TX buffer is full
+    uint64_t fifoUs = (uint64_t) SIM_TX_FIFO * byteUs;
+    while (lastInUs > now() + fifoUs) {}
+
+    checkEscape();
+    uint64_t t = now();
+    uint64_t prevInUs = lastInUs;
+    lastInUs = ((lastInUs > t) ? lastInUs : t) + byteUs;
+    rxBytes++;
+
+    if (hostBaud != modemBaud) {    // Framing errors, the command is lost
+        line.clear();
+        return 1;
+    }
+    if (lineError()) c ^= 0x80;
+
+    if (mode == MODE_ONLINE) {
+        onlineByte(c, prevInUs);
+        return 1;
+    }
+
+    if (mode == MODE_SSEND) {
+        if (ssendLeft > 0) {        // AT#SSENDEXT: exact byte count
+            ssendData += (char) c;
+            if (--ssendLeft == 0) finishSend();
+        } else if (c == 0x1A) {     // Ctrl-Z ends the payload
+            finishSend();
+        } else if (c == 0x1B) {     // ESC aborts it
+            mode = MODE_COMMAND;
+            cmdLatencyMs = latencyFor("AT#SSEND");
+            ok();
+        } else {
+            ssendData += (char) c;
+        }
+        return 1;
+    }
+
+    if (echo) {
+        char e = (char) c;
+        schedule(&e, 1, lastInUs);
+    }
+    if (c == '\r') {
+        if (!line.empty()) {
+            std::string cmd = line;
+            line.clear();
+            commands++;
+            cmdLatencyMs = latencyFor(cmd);
+            if (unanswered.empty() ||
+                (cmd.compare(0, unanswered.size(), unanswered) != 0))
+                execute(cmd);
+        }
+    } else if ((c != '\n') && (!line.empty() || (toupper(c) == 'A'))) {
+        line += (char) c;   // Like the modem, skip bytes until "AT"
+    }
+    return 1;
+}
+
+/** Completes an AT#SSEND, AT#SSENDEXT or AT#SSLSENDEXT: the remote peer
+ *  receives the payload, and its handler or scripted reply answers, if set.
+ *  Completes AT#SSLSECDATA by storing the certificate.
+ */
+void LE910Sim::finishSend() {
+    mode = MODE_COMMAND;
+    if (ssendConn == 0) {
+        cmdLatencyMs = latencyFor("AT#SSLSECDATA");
+        certs[secDataType] = ssendData;
+        ok();
+        return;
+    }
+    Socket* s = peer(ssendConn);
+    cmdLatencyMs = latencyFor("AT#SSEND");
+    s->received += ssendData;
+    ok();
+    if (peerHandler != NULL) peerHandler(this, ssendConn, ssendData,
+                                         peerContext);
+    else if (!remoteReply.empty()) pushRemoteData(ssendConn,
+        remoteReply.data(), remoteReply.size());
+}
+
+/** Executes one AT command line and queues its response. */
+void LE910Sim::execute(const std::string& cmd) {
+    int a = 0, b = 0, c = 0;
+    char host[256];
+
+    if ((cmd == "AT") || (cmd == "ATV1") ||
+        (cmd.compare(0, 7, "AT#BND=") == 0) ||
+        (cmd.compare(0, 10, "AT+CGDCONT") == 0) ||
+        (cmd.compare(0, 8, "AT#SCFG=") == 0) ||
+        (cmd.compare(0, 7, "AT+CMEE") == 0)) {
+        ok();
+    }
+    else if ((cmd == "ATE0") || (cmd == "ATE1")) {
+        echo = (cmd == "ATE1");
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT+IPR=%d", &a) == 1) {
+        static const int rates[] = { 9600, 19200, 38400, 57600, 115200,
+                                     230400, 460800, 921600 };
+        bool valid = false;
+        for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+            if (rates[i] == a) valid = true;
+        if (!valid) error();
+        else {
+            ok();                   // At the old rate
+            modemBaud = a;
+            byteUs = (10000000UL + a - 1) / a;
+        }
+    }
+    else if (sscanf(cmd.c_str(), "AT+IFC=%d,%d", &a, &b) == 2) {
+        if (((a != 0) && (a != 2)) || ((b != 0) && (b != 2))) error();
+        else {
+            ifcByTe = a;
+            ifcByDce = b;
+            ok();
+        }
+    }
+    else if (cmd == "AT+IFC?") {
+        char info[16];
+        snprintf(info, sizeof(info), "+IFC: %d,%d", ifcByTe, ifcByDce);
+        ok(info);
+    }
+    else if (cmd == "AT+CGMI") ok("Telit");
+    else if (cmd == "AT+CGMM") ok("LE910-SV V2");
+    else if (cmd == "AT+CGMR") ok("17.00.523");
+    else if (cmd == "AT+CGSN") ok("359852050000000");
+    else if (cmd == "AT+CIMI") ok("311480000000000");
+    else if (cmd == "AT+FCLASS?") ok("0");
+    else if (cmd == "AT+CGATT?") ok(attached ? "+CGATT: 1" : "+CGATT: 0");
+    else if ((cmd == "AT+CGATT=1") || (cmd == "AT+CGATT=0")) {
+        attached = (cmd == "AT+CGATT=1");
+        ok();
+    }
+    else if (cmd == "AT#SGACT?") {
+        ok(pdpActive ? "#SGACT: 3,1" : "#SGACT: 3,0");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SGACT=%d,%d", &a, &b) == 2) {
+        if (b == 0) {
+            pdpActive = false;
+            for (int i = 1; i <= SIM_SSL_SOCKET; i++) {
+                sockets[i].state = 0;
+                sockets[i].pending.clear();
+                sockets[i].datagrams.clear();
+            }
+            ok();
+        } else if (pdpActive || !attached) {
+            error();
+        } else {
+            pdpActive = true;
+            ok("#SGACT: 10.0.0.2");
+        }
+    }
+    else if (sscanf(cmd.c_str(), "AT#QDNS=\"%255[^\"]\"", host) == 1) {
+        if (!pdpActive) {
+            error();
+            return;
+        }
+        dnsQueries++;
+        cmdLatencyMs += dnsLatencyMs;
+        ok(std::string("#QDNS: \"") + host + "\",\"10.0.0.1\"");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SD=%d,%d,%d,%255[^,],", &a, &b, &c,
+                    host) == 4) {
+        Socket* s = socket(a);
+        if ((s == NULL) || !pdpActive || (s->state != 0) || (b < 0) ||
+            (b > 1)) {
+            error();
+            return;
+        }
+        s->udp = (b == 1);
+        if (s->udp) cmdLatencyMs = latencyFor("AT");    // No handshake
+        for (const char* p = host; *p != '\0'; p++) {
+            if (isalpha((unsigned char) *p)) {
+                dnsQueries++;   // The modem resolves the name itself
+                cmdLatencyMs += dnsLatencyMs;
+                break;
+            }
+        }
+        s->state = 2;
+        s->port = c;
+        s->host = host;
+        if ((s->host.size() >= 2) && (s->host[0] == '"'))
+            s->host = s->host.substr(1, s->host.size() - 2);
+        s->pending.clear();
+        s->datagrams.clear();
+        s->received.clear();
+        size_t lastComma = cmd.rfind(',');
+        int fields = 1;
+        for (size_t i = 0; i < cmd.size(); i++) fields += (cmd[i] == ',');
+        if ((fields == 7) && (atoi(cmd.c_str() + lastComma + 1) == 0))
+            goOnline(a);
+        else
+            ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SO=%d", &a) == 1) {
+        Socket* s = socket(a);
+        if ((s == NULL) || (s->state < 2) || (s->state > 3)) {
+            error();
+            return;
+        }
+        goOnline(a);
+    }
+    else if (cmd == "AT#SS") {
+        std::string info;
+        char entry[80];
+        for (int i = 1; i <= SIM_NUM_SOCKETS; i++) {
+            if (sockets[i].state == 0)
+                snprintf(entry, sizeof(entry), "#SS: %d,0", i);
+            else
+                snprintf(entry, sizeof(entry), "#SS: %d,%d,10.0.0.2,%d,%s,%d",
+                         i, sockets[i].state, 1024 + i,
+                         sockets[i].host.c_str(), sockets[i].port);
+            if (i > 1) info += "\r\n";
+            info += entry;
+        }
+        ok(info);
+    }
+    else if (sscanf(cmd.c_str(), "AT#SCFGEXT=%d,%d", &a, &b) == 2) {
+        Socket* s = socket(a);
+        if ((s == NULL) || (b < 0) || (b > 1)) {
+            error();
+            return;
+        }
+        s->srMode = b;
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SCFGEXT2=%d,%*d,%*d,%*d,%*d,%d", &a,
+                    &b) == 2) {
+        Socket* s = socket(a);
+        if ((s == NULL) || (b < 0) || (b > 2)) {
+            error();
+            return;
+        }
+        s->noCarrierMode = b;
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSEND=%d", &a) == 1) {
+        Socket* s = socket(a);
+        if ((s == NULL) || (s->state < 2) || (s->state > 3)) {
+            error();
+            return;
+        }
+        mode = MODE_SSEND;
+        ssendConn = a;
+        ssendLeft = 0;
+        ssendData.clear();
+        respond("\r\n> ");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSENDUDPEXT=%d,%d,%255[^,],%d", &a, &b,
+                    host, &c) == 4) {
+        Socket* s = socket(a);
+        if ((s == NULL) || !s->udp || (s->state < 2) || (s->state > 3) ||
+            (b < 1) || (b > 1500) || (c < 1) || (c > 65535)) {
+            error();
+            return;
+        }
+        mode = MODE_SSEND;
+        ssendConn = a;
+        ssendLeft = b;
+        ssendData.clear();
+        respond("\r\n> ");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSENDEXT=%d,%d", &a, &b) == 2) {
+        Socket* s = socket(a);
+        if ((s == NULL) || (s->state < 2) || (s->state > 3) || (b < 1) ||
+            (b > 1500)) {
+            error();
+            return;
+        }
+        mode = MODE_SSEND;
+        ssendConn = a;
+        ssendLeft = b;
+        ssendData.clear();
+        respond("\r\n> ");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SRECV=%d,%d", &a, &b) == 2) {
+        Socket* s = socket(a);
+        int udpInfo = 0;
+        sscanf(cmd.c_str(), "AT#SRECV=%*d,%*d,%d", &udpInfo);
+        if ((s == NULL) || (b < 1) || (b > 1500) || s->pending.empty() ||
+            (udpInfo < 0) || (udpInfo > 1)) {
+            error();
+            return;
+        }
+        // A UDP read stops at the end of the datagram
+        size_t n = s->pending.size() < (size_t) b ? s->pending.size() : b;
+        size_t left = 0;
+        if (s->udp) {
+            if (n > s->datagrams.front()) n = s->datagrams.front();
+            left = s->datagrams.front() - n;
+            if (left > 0) s->datagrams.front() = left;
+            else s->datagrams.pop_front();
+        }
+        char header[96];
+        if (udpInfo == 1)
+            snprintf(header, sizeof(header), "\r\n#SRECV: %s,%d,%d,%d,%d\r\n",
+                     s->host.c_str(), s->port, a, (int) n, (int) left);
+        else
+            snprintf(header, sizeof(header), "\r\n#SRECV: %d,%d\r\n", a,
+                     (int) n);
+        respond(header + s->pending.substr(0, n) + "\r\n\r\nOK\r\n");
+        s->pending.erase(0, n);
+        if (s->pending.empty() && (s->state == 3)) s->state = 2;
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLEN=%d,%d", &a, &b) == 2) {
+        if ((a != 1) || (b < 0) || (b > 1) || (sslEnabled == (b == 1))) {
+            error();    // The modem refuses to enable it twice
+            return;
+        }
+        sslEnabled = (b == 1);
+        ok();
+    }
+    else if (cmd == "AT#SSLEN?") {
+        ok(sslEnabled ? "#SSLEN: 1,1" : "#SSLEN: 1,0");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLSECCFG=%d,%d,%d", &a, &b, &c) == 3) {
+        if ((a != 1) || !sslEnabled || (c < 0) || (c > 2)) {
+            error();
+            return;
+        }
+        sslAuth = c;
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLSECDATA=%d,1,%d,%d", &a, &b, &c) == 3) {
+        if ((a != 1) || !sslEnabled || (b < 0) || (b > 2) || (c < 1) ||
+            (c > 4096)) {
+            error();
+            return;
+        }
+        mode = MODE_SSEND;
+        ssendConn = 0;
+        ssendLeft = c;
+        secDataType = b;
+        ssendData.clear();
+        respond("\r\n> ");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLCFG=%d,%*d,%*d,%*d,%*d,%*d,%d", &a,
+                    &b) == 2) {
+        if ((a != 1) || !sslEnabled) {
+            error();
+            return;
+        }
+        sslSRingMode = b;
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLD=%d,%d,\"%255[^\"]\",%d", &a, &b,
+                    host, &c) == 4) {
+        Socket* s = peer(SIM_SSL_SOCKET);
+        bool noCerts = ((sslAuth >= 1) && certs[1].empty()) ||
+                       ((sslAuth == 2) && (certs[0].empty() || certs[2].empty()));
+        if ((a != 1) || !sslEnabled || !pdpActive || (s->state != 0) ||
+            noCerts) {
+            error();
+            return;
+        }
+        if (sessionValid && (sessionHost == host) && (sessionPort == b)) {
+            resumptions++;
+            cmdLatencyMs += resumedHandshakeMs;
+        } else {
+            handshakes++;
+            cmdLatencyMs += fullHandshakeMs;
+        }
+        sessionValid = false;
+        sessionHost = host;
+        sessionPort = b;
+        sslClosure = c;
+        s->state = 2;
+        s->port = b;
+        s->host = host;
+        s->pending.clear();
+        s->datagrams.clear();
+        s->received.clear();
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLS=%d", &a) == 1) {
+        if (a != 1) {
+            error();
+            return;
+        }
+        int state = !sslEnabled ? 0 :
+                    (sockets[SIM_SSL_SOCKET].state == 0) ? 1 : 2;
+        char info[32];
+        snprintf(info, sizeof(info), "#SSLS: 1,%d", state);
+        ok(info);
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLSENDEXT=%d,%d", &a, &b) == 2) {
+        Socket* s = peer(SIM_SSL_SOCKET);
+        if ((a != 1) || (s->state < 2) || (s->state > 3) || (b < 1) ||
+            (b > 1023)) {
+            error();
+            return;
+        }
+        mode = MODE_SSEND;
+        ssendConn = SIM_SSL_SOCKET;
+        ssendLeft = b;
+        ssendData.clear();
+        respond("\r\n> ");
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLRECV=%d,%d", &a, &b) == 2) {
+        Socket* s = peer(SIM_SSL_SOCKET);
+        if ((a != 1) || (b < 1) || (b > 1000) || (s->state == 0)) {
+            error();
+            return;
+        }
+        if (s->pending.empty()) {
+            ok("#SSLRECV: 0\r\nTIMEOUT");
+            return;
+        }
+        size_t n = s->pending.size() < (size_t) b ? s->pending.size() : b;
+        char header[32];
+        snprintf(header, sizeof(header), "\r\n#SSLRECV: %d\r\n", (int) n);
+        respond(header + s->pending.substr(0, n) + "\r\n\r\nOK\r\n");
+        s->pending.erase(0, n);
+        if (s->pending.empty() && (s->state == 3)) s->state = 2;
+    }
+    else if (sscanf(cmd.c_str(), "AT#SSLH=%d", &a) == 1) {
+        Socket* s = peer(SIM_SSL_SOCKET);
+        if ((a != 1) || (s->state == 0)) {
+            error();
+            return;
+        }
+        s->state = 0;
+        s->pending.clear();
+        s->datagrams.clear();
+        sessionValid = (sslClosure == 1);
+        ok();
+    }
+    else if (sscanf(cmd.c_str(), "AT#SH=%d", &a) == 1) {
+        Socket* s = socket(a);
+        if (s == NULL) {
+            error();
+            return;
+        }
+        s->state = 0;
+        s->pending.clear();
+        s->datagrams.clear();
+        ok();
+    }
+    else error();
+}
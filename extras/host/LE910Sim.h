@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Scripted Telit LE910 modem simulator for host builds.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LE910Sim class is a HardwareSerial that behaves like the UART of a
+ * Telit LE910 modem. Bytes written to it are parsed as AT commands, and the
+ * responses are queued back with realistic timing: every byte costs one
+ * character time at the configured baud rate in each direction, and every
+ * command has a processing latency before the modem starts answering.
+ *
+ * The simulator keeps enough state (echo, GPRS attach, PDP context, six
+ * sockets with pending receive data) to run the library's init(), socket
+ * open/write/receive/close sequences unmodified. A scripted remote peer
+ * answers every AT#SSEND or AT#SSENDEXT payload with a configurable reply,
+ * and the host can push data into a socket directly with pushRemoteData().
+ * A peer that has to look at what it receives, e.g. a protocol stand-in,
+ * is set with setRemoteHandler() and called with each payload instead.
+ * Data arriving on a socket in command mode is announced with SRING, in the
+ * format selected with AT#SCFGEXT.
+ *
+ * AT#QDNS resolves every name to 10.0.0.1. Name lookups, by AT#QDNS or by
+ * AT#SD given a host name, take the time set with setDNSLatency().
+ *
+ * dropContext() deactivates the PDP context as a network would, closing
+ * every socket without notice. Commands set with setUnanswered() get no
+ * response at all, like a command whose response was lost.
+ *
+ * The SSL socket (SSId 1) is addressed as connection SIM_SSL_SOCKET by the
+ * remote peer functions. AT#SSLD takes the handshake time set with
+ * setHandshakeLatency(): the full time, or the resumed time when the last
+ * connection to the same host:port was dialed with closure type 1 (keep
+ * the session). Server authentication fails without a CA certificate
+ * loaded with AT#SSLSECDATA.
+ *
+ * Sockets dialed with txProt 1 are UDP: AT#SD answers without the dial
+ * latency, every payload sent or pushed is one datagram, AT#SRECV reads at
+ * most one datagram and, with UDPInfo 1, reports its sender (the dialed
+ * host:port), and AT#SSENDUDPEXT is accepted.
+ *
+ * Sockets dialed in online mode (AT#SD connMode 0) or resumed with AT#SO
+ * pass bytes through in both directions until the "+++" escape sequence,
+ * surrounded by the escape guard time, suspends them again.
+ *
+ * Writes block once more than SIM_TX_FIFO bytes are waiting to go out on
+ * the wire, like the LaunchPad's buffered serial driver.
+ *
+ * The modem's UART rate (setBaud(), AT+IPR) and the LaunchPad's (begin())
+ * are kept apart: while they differ, bytes written are lost and bytes read
+ * are garbage. AT+IPR answers at the old rate and switches after its OK.
+ * setLineErrors() corrupts bytes at rates a long or noisy line cannot
+ * carry. With AT+IFC RTS flow control on (the default, as on the LE910)
+ * and setRTSPin(), the modem stops sending while the pin is high.
+ */
+
+
+#ifndef LTE_HOST_LE910SIM_H_
+#define LTE_HOST_LE910SIM_H_
+
+#include <deque>
+#include <string>
+
+#include "Energia.h"
+
+#define SIM_NUM_SOCKETS     6
+#define SIM_SSL_SOCKET      (SIM_NUM_SOCKETS + 1)   // SSId 1
+#define SIM_MAX_LATENCIES   8
+#define SIM_TX_FIFO         256     // LaunchPad serial TX buffer, bytes
+
+class LE910Sim;
+
+// Remote peer called with each payload written to a socket
+typedef void (*SimPeerHandler)(LE910Sim* sim, int connId,
+                               const std::string& data, void* context);
+
+class LE910Sim : public HardwareSerial {
+public:
+    LE910Sim();
+
+    // HardwareSerial interface, seen from the LaunchPad side
+    virtual void begin(unsigned long baud);
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+    virtual size_t write(uint8_t c);
+    using Print::write;
+
+    // Pacing and latency
+    void setBaud(uint32_t baud);
+    void setLatency(uint32_t ms);                        // All commands
+    bool setLatency(const char* cmdPrefix, uint32_t ms); // Per command
+    void setEscapeGuard(uint32_t ms);                    // "+++" guard time
+    void setDNSLatency(uint32_t ms);                     // Name lookups
+    void setHandshakeLatency(uint32_t fullMs, uint32_t resumedMs); // AT#SSLD
+    void setUnanswered(const char* cmdPrefix);           // Lost responses
+    void setLineErrors(uint32_t aboveBaud, uint32_t interval); // Bit errors
+    void setRTSPin(int pin);                             // Modem's RTS input
+    uint32_t modemBaudRate() { return modemBaud; };
+
+    // Scripted remote peer
+    void setRemoteReply(const char* reply, size_t len);
+    void setRemoteHandler(SimPeerHandler handler, void* context = NULL);
+    void pushRemoteData(int connId, const char* buf, size_t len);
+    const std::string& remoteReceived(int connId);
+    void remoteClose(int connId);
+    void dropContext();                 // Network deactivates the PDP context
+
+    // Unsolicited result codes
+    void sendUnsolicited(const char* line, uint32_t delayMs = 0);
+
+    // Statistics
+    uint32_t commandCount() { return commands; };
+    uint32_t bytesToHost() { return txBytes; };
+    uint32_t bytesFromHost() { return rxBytes; };
+    uint32_t dnsLookups() { return dnsQueries; };
+    uint32_t fullHandshakes() { return handshakes; };
+    uint32_t resumedHandshakes() { return resumptions; };
+    const std::string& certificate(int type);   // AT#SSLSECDATA DataType
+    void resetStats();
+
+private:
+    struct Byte {
+        uint64_t readyUs;
+        uint32_t baud;  // Rate it was sent at
+        uint8_t c;
+    };
+    struct Latency {
+        std::string prefix;
+        uint32_t ms;
+    };
+    struct Socket {
+        int state;      // Same codes as AT#SS
+        int port;
+        std::string host;
+        std::string pending;
+        std::string received;
+        int srMode;     // AT#SCFGEXT SRING format, 0 without byte count
+        int noCarrierMode;  // AT#SCFGEXT2 "NO CARRIER" format
+        bool udp;       // Dialed with AT#SD txProt 1
+        std::deque<size_t> datagrams;   // Sizes of the datagrams in pending
+    };
+    enum Mode { MODE_COMMAND, MODE_SSEND, MODE_ONLINE };
+
+    uint64_t now();
+    size_t readyCount();
+    void schedule(const char* buf, size_t len, uint64_t startUs);
+    void respond(const std::string& response);
+    void ok(const std::string& info = "");
+    void error();
+    void execute(const std::string& cmd);
+    void finishSend();
+    uint32_t latencyFor(const std::string& cmd);
+    Socket* socket(int connId);
+    Socket* peer(int connId);
+    void goOnline(int connId);
+    void onlineByte(uint8_t c, uint64_t prevInUs);
+    void checkEscape();
+    bool lineError();
+
+    std::deque<Byte> outQueue;      // Modem -> LaunchPad
+    uint64_t lastOutUs;             // Time last queued byte is on the wire
+    uint64_t lastInUs;              // Time last written byte arrived
+    uint32_t byteUs;                // One UART character time
+    uint32_t modemBaud;             // AT+IPR
+    uint32_t hostBaud;              // LaunchPad side, begin()
+    uint32_t errorAboveBaud;        // Rates above this corrupt bytes
+    uint32_t errorInterval;         // Every errorInterval-th byte, 0 for none
+    uint32_t errorCount;            // Bytes towards the next corrupted one
+    int rtsPin;                     // -1 if RTS is not wired
+    bool rtsHeld;                   // Output paused by RTS since rtsHeldUs
+    uint64_t rtsHeldUs;
+    uint32_t defaultLatencyMs;
+    Latency latencies[SIM_MAX_LATENCIES];
+    int numLatencies;
+    uint32_t cmdLatencyMs;          // Latency of command being answered
+    std::string unanswered;         // Prefix of commands not answered
+
+    Mode mode;
+    std::string line;               // Command being assembled
+    int ssendConn;                  // Socket being written in MODE_SSEND,
+                                    // 0 for AT#SSLSECDATA
+    size_t ssendLeft;               // Bytes AT#SSENDEXT still expects
+    std::string ssendData;
+    int onlineConn;                 // Socket in MODE_ONLINE
+    uint32_t escapeGuardMs;
+    uint32_t dnsLatencyMs;
+    int escapeCount;                // '+' received after a guard time
+    bool escapeQueued;              // OK for "+++" queued
+    size_t escapeQueueIndex;        // Where in outQueue that OK starts
+    uint64_t escapeUs;              // When the escape takes effect
+
+    bool echo;
+    int ifcByTe;                    // AT+IFC: 2 if RTS pauses output
+    int ifcByDce;                   // AT+IFC: 2 if CTS is driven
+    bool attached;
+    bool pdpActive;
+    Socket sockets[SIM_SSL_SOCKET + 1];
+    std::string remoteReply;
+    SimPeerHandler peerHandler;
+    void* peerContext;
+
+    // SSL engine
+    bool sslEnabled;
+    int sslAuth;                    // AT#SSLSECCFG auth_mode
+    int sslSRingMode;               // AT#SSLCFG SSLSRingMode
+    int sslClosure;                 // AT#SSLD closureType of the connection
+    int secDataType;                // AT#SSLSECDATA being received
+    std::string certs[3];           // Client cert, CA cert, client key
+    bool sessionValid;              // A kept session can be resumed
+    std::string sessionHost;
+    int sessionPort;
+    uint32_t fullHandshakeMs;
+    uint32_t resumedHandshakeMs;
+
+    uint32_t commands;
+    uint32_t dnsQueries;
+    uint32_t handshakes;
+    uint32_t resumptions;
+    uint32_t txBytes;
+    uint32_t rxBytes;
+};
+
+#endif
@@ -0,0 +1,1256 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * AT round-trip benchmark for the Telit LE910 library on a Linux host.
+ *
+ * Runs the library's public API against the LE910 simulator and reports
+ * wall-clock latency of each call, plus throughput of bulk transfers.
+ *
+ * Usage: lte_bench [-n iterations] [-b baud] [-l latency_ms] [-s bulk_bytes]
+ *                  [-m]
+ *
+ * -m prints the library's own metrics after the run (needs LTE_METRICS).
+ */
+
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "Energia.h"
+#include "LE910Sim.h"
+#include "LTE_HTTP.h"
+#include "LTE_JSON.h"
+#include "LTE_MQTT.h"
+#include "LTE_Queue.h"
+#include "LTE_Socket.h"
+#include "LTE_SocketPool.h"
+#include "LTE_TCP.h"
+
+
+LE910Sim modem;
+LTE_TCP lte(&modem);
+
+static const char request[] =
+    "GET /hello HTTP/1.1\r\nHost: 10.0.0.1\r\nConnection: close\r\n\r\n";
+static const char reply[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 13\r\n"
+    "\r\nHello, World.";
+static const char chunkedReply[] =
+    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+    "7\r\nHello, \r\n6;ext=1\r\nWorld.\r\n0\r\nX-Trailer: 1\r\n\r\n";
+static const char closeHeader[] =
+    "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n";
+static const char jsonReply[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+    "Content-Length: 244\r\n\r\n"
+    "{\"coord\":{\"lon\":-96.8,\"lat\":32.78},\"weather\":[{\"id\":800,"
+    "\"main\":\"Clear\",\"description\":\"clear sky\",\"icon\":\"01d\"}],"
+    "\"main\":{\"temp\":301.52,\"pressure\":1015,\"humidity\":48},"
+    "\"tags\":[[1,2],[true,null]],\"note\":\"caf\\u00e9 \\\"ok\\\"\","
+    "\"name\":\"Dallas\",\"cod\":200}";
+
+#define SMALL_WRITE  32     // Bytes per write in small write tests
+#define SMALL_TOTAL  1024   // Bytes written in small write tests
+#define PACKET_SIZE  300    // Default socketOpen() packet size
+#define SLOW_LATENCY 50     // Latency of the commands in benchQueue(), ms
+#define DIAL_LATENCY 100    // AT#SD latency: TCP handshake over LTE, ms
+#define DNS_LATENCY  80     // Name lookup time, ms
+#define FULL_HANDSHAKE 300  // AT#SSLD with a full TLS handshake, ms
+#define RESUMED_HANDSHAKE 100   // AT#SSLD resuming a kept session, ms
+#define MQTT_BATCH   8      // Messages published in the MQTT batch tests
+#define QUEUED       32     // Records uploaded from RAM
+#define SPILLED      80     // Records uploaded with some in storage
+#define OVERFILLED   200    // Records that fill both RAM and storage
+#define SLOW_REPLY   600    // AT+CIMI latency in benchTimeouts(), ms
+#define SLOW_ATTACH  1200   // AT+CGATT=1 latency in benchTimeouts(), ms
+#define RTS_PIN      14     // LaunchPad pin wired to the modem's RTS
+#define NOISY_BAUD   460800 // Fastest rate the line carries in benchBaud()
+#define NOISY_BYTES  16     // Bytes per corrupted byte above NOISY_BAUD
+
+// Commands answered after SLOW_LATENCY in benchQueue()
+static const char* const slowCommands[] = {
+    "AT+CGMI", "AT+CGMM", "AT+CGMR", "AT+CGSN"
+};
+
+
+struct Stat {
+    const char* name;
+    uint32_t count;
+    uint32_t failures;
+    double minMs;
+    double maxMs;
+    double sumMs;
+    double bytes;           // Bytes transferred, for throughput
+};
+
+enum {
+    STAT_INIT,
+    STAT_COMMAND_OK,
+    STAT_SOCKET_OPEN,
+    STAT_SOCKET_WRITE,
+    STAT_SOCKET_RECEIVE,
+    STAT_IDLE_RECEIVE,
+    STAT_SOCKET_READY,
+    STAT_SOCKET_CLOSE,
+    STAT_SOCKET_REOPEN,
+    STAT_CONTEXT_LOST,
+    STAT_REMOTE_CLOSE,
+    STAT_READ_CLOSED,
+    STAT_BULK_RECEIVE,
+    STAT_STREAM_RECEIVE,
+    STAT_BULK_WRITE,
+    STAT_SMALL_WRITE,
+    STAT_BUFFER_WRITE,
+    STAT_BUFFER_PARTIAL,
+    STAT_SECOND_OPEN,
+    STAT_MULTI_WRITE,
+    STAT_MULTI_SERVICE,
+    STAT_ONLINE_OPEN,
+    STAT_ONLINE_WRITE,
+    STAT_ONLINE_READ,
+    STAT_ONLINE_SUSPEND,
+    STAT_ONLINE_CLOSED,
+    STAT_CLOSE_REQUEST,
+    STAT_POOLED_REQUEST,
+    STAT_POOL_RECONNECT,
+    STAT_OPEN_BY_NAME,
+    STAT_OPEN_DNS_CACHED,
+    STAT_UDP_OPEN,
+    STAT_UDP_EXCHANGE,
+    STAT_UDP_DATAGRAMS,
+    STAT_HTTP_GET,
+    STAT_HTTP_KEEP_ALIVE,
+    STAT_HTTP_CHUNKED,
+    STAT_HTTP_JSON,
+    STAT_HTTP_TO_CLOSE,
+    STAT_TLS_OPEN,
+    STAT_TLS_REQUEST,
+    STAT_TLS_RESUMED,
+    STAT_HTTPS_GET,
+    STAT_MQTT_CONNECT,
+    STAT_MQTT_ECHO,
+    STAT_MQTT_BATCHED,
+    STAT_MQTT_UNBATCHED,
+    STAT_MQTT_PING,
+    STAT_MQTT_LONG_TOPIC,
+    STAT_MQTT_MALFORMED,
+    STAT_QUEUE_UPLOAD,
+    STAT_QUEUE_SPILLED,
+    STAT_QUEUE_FULL,
+    STAT_QUEUE_BAD_STORAGE,
+    STAT_BLOCKING_CMDS,
+    STAT_QUEUED_CMDS,
+    STAT_PIPELINED_CMDS,
+    STAT_LONGEST_POLL,
+    STAT_UNANSWERED,
+    STAT_SLOW_RETRY,
+    STAT_SLOW_ATTACH,
+    STAT_NEGOTIATE,
+    STAT_FAST_RECEIVE,
+    STAT_NEGOTIATE_NOISY,
+    STAT_INIT_FAST,
+    NUM_STATS
+};
+
+static Stat stats[NUM_STATS] = {
+    { "init()",             0, 0, 0, 0, 0, 0 },
+    { "getCommandOK(\"AT\")", 0, 0, 0, 0, 0, 0 },
+    { "socketOpen()",       0, 0, 0, 0, 0, 0 },
+    { "socketWrite()",      0, 0, 0, 0, 0, 0 },
+    { "socketReceive()",    0, 0, 0, 0, 0, 0 },
+    { "idle socketReceive()", 0, 0, 0, 0, 0, 0 },
+    { "socketReady()",      0, 0, 0, 0, 0, 0 },
+    { "socketClose()",      0, 0, 0, 0, 0, 0 },
+    { "socketOpen() again", 0, 0, 0, 0, 0, 0 },
+    { "open after lost PDP", 0, 0, 0, 0, 0, 0 },
+    { "write after NO CARRIER", 0, 0, 0, 0, 0, 0 },
+    { "read after NO CARRIER", 0, 0, 0, 0, 0, 0 },
+    { "bulk socketReceive()", 0, 0, 0, 0, 0, 0 },
+    { "bulk socketReceive(cb)", 0, 0, 0, 0, 0, 0 },
+    { "bulk socketWrite()", 0, 0, 0, 0, 0, 0 },
+    { "32B socketWrite()",  0, 0, 0, 0, 0, 0 },
+    { "32B socketBufferWrite()", 0, 0, 0, 0, 0, 0 },
+    { "buffered write, peer gone", 0, 0, 0, 0, 0, 0 },
+    { "2nd socketOpen()",   0, 0, 0, 0, 0, 0 },
+    { "3 sockets write()",  0, 0, 0, 0, 0, 0 },
+    { "3 sockets service",  0, 0, 0, 0, 0, 0 },
+    { "socketOpenOnline()", 0, 0, 0, 0, 0, 0 },
+    { "bulk onlineWrite()", 0, 0, 0, 0, 0, 0 },
+    { "bulk onlineRead()",  0, 0, 0, 0, 0, 0 },
+    { "socketSuspend()",    0, 0, 0, 0, 0, 0 },
+    { "remote close, online", 0, 0, 0, 0, 0, 0 },
+    { "request, new socket", 0, 0, 0, 0, 0, 0 },
+    { "request, pooled",    0, 0, 0, 0, 0, 0 },
+    { "request, reconnected", 0, 0, 0, 0, 0, 0 },
+    { "open by name",       0, 0, 0, 0, 0, 0 },
+    { "open by name, cached", 0, 0, 0, 0, 0, 0 },
+    { "socketOpenUDP()",    0, 0, 0, 0, 0, 0 },
+    { "UDP send, receiveFrom", 0, 0, 0, 0, 0, 0 },
+    { "UDP 3 datagrams",    0, 0, 0, 0, 0, 0 },
+    { "HTTP GET",           0, 0, 0, 0, 0, 0 },
+    { "HTTP GET keep-alive", 0, 0, 0, 0, 0, 0 },
+    { "HTTP GET chunked",   0, 0, 0, 0, 0, 0 },
+    { "HTTP GET, JSON paths", 0, 0, 0, 0, 0, 0 },
+    { "HTTP GET, body to close", 0, 0, 0, 0, 0, 0 },
+    { "TLS socketOpen()",   0, 0, 0, 0, 0, 0 },
+    { "TLS request",        0, 0, 0, 0, 0, 0 },
+    { "TLS reopen, resumed", 0, 0, 0, 0, 0, 0 },
+    { "HTTPS GET keep-alive", 0, 0, 0, 0, 0, 0 },
+    { "MQTT connect",       0, 0, 0, 0, 0, 0 },
+    { "MQTT QoS 1 echo",    0, 0, 0, 0, 0, 0 },
+    { "8 PUBLISH, batched", 0, 0, 0, 0, 0, 0 },
+    { "8 PUBLISH, unbatched", 0, 0, 0, 0, 0, 0 },
+    { "MQTT PINGREQ",       0, 0, 0, 0, 0, 0 },
+    { "QoS 1, long topic acked", 0, 0, 0, 0, 0, 0 },
+    { "MQTT malformed length", 0, 0, 0, 0, 0, 0 },
+    { "upload 32 records",  0, 0, 0, 0, 0, 0 },
+    { "upload 80, spilled", 0, 0, 0, 0, 0, 0 },
+    { "push, queue full",   0, 0, 0, 0, 0, 0 },
+    { "push, storage failing", 0, 0, 0, 0, 0, 0 },
+    { "4 getCommandOK()",   0, 0, 0, 0, 0, 0 },
+    { "4 queueCommand()",   0, 0, 0, 0, 0, 0 },
+    { "4 pipelined commands", 0, 0, 0, 0, 0, 0 },
+    { "longest poll()",     0, 0, 0, 0, 0, 0 },
+    { "unanswered command", 0, 0, 0, 0, 0, 0 },
+    { "slow reply, retried", 0, 0, 0, 0, 0, 0 },
+    { "slow attach",        0, 0, 0, 0, 0, 0 },
+    { "negotiate 921600",   0, 0, 0, 0, 0, 0 },
+    { "slow consumer, 921600", 0, 0, 0, 0, 0, 0 },
+    { "negotiate, noisy line", 0, 0, 0, 0, 0, 0 },
+    { "init(), modem at 921600", 0, 0, 0, 0, 0, 0 },
+};
+
+static uint32_t startUs;
+static uint32_t latency = 2;    // Simulated command latency, ms
+static char* bulk;          // Binary bulk payload, every byte value
+static int bulkBytes = 4096;
+
+// Checks streamed chunks against the bulk payload
+struct StreamCheck {
+    const char* expected;
+    int len;
+    int received;
+    bool match;
+};
+
+static void checkChunk(const char* buf, uint32_t len, void* context) {
+    StreamCheck* check = (StreamCheck*) context;
+    if ((check->received + (int) len > check->len) ||
+        (memcmp(check->expected + check->received, buf, len) != 0))
+        check->match = false;
+    check->received += len;
+}
+
+// checkChunk() taking its time, e.g. writing to an SD card
+static void slowChunk(const char* buf, uint32_t len, void* context) {
+    checkChunk(buf, len, context);
+    delayMicroseconds(len * 50);
+}
+
+static void begin() {
+    startUs = micros();
+}
+
+static double end(int stat, bool ok, int bytes = 0) {
+    double ms = (micros() - startUs) / 1000.0;
+    Stat* s = &stats[stat];
+    if ((s->count == 0) || (ms < s->minMs)) s->minMs = ms;
+    if ((s->count == 0) || (ms > s->maxMs)) s->maxMs = ms;
+    s->sumMs += ms;
+    s->bytes += (bytes > 0) ? bytes : 0;
+    s->count++;
+    if (!ok) s->failures++;
+    return ms;
+}
+
+// Waits, outside the timed sections, for SRING to announce socket data
+static bool waitAvailable(int bytes) {
+    uint32_t start = millis();
+    while (lte.socketAvailable() < bytes) {
+        if (millis() - start > 1000) return false;
+    }
+    return true;
+}
+
+// Single commands and one request/reply exchange in command mode
+static void benchCommandMode() {
+    begin();
+    end(STAT_INIT, lte.init(4));
+
+    begin();
+    end(STAT_COMMAND_OK, lte.getCommandOK("AT"));
+
+    begin();
+    end(STAT_SOCKET_OPEN, lte.socketOpen((char*) "10.0.0.1", 80));
+
+    begin();
+    end(STAT_SOCKET_WRITE, lte.socketWrite((char*) request) ==
+        (int) (sizeof(request) - 1));
+
+    waitAvailable(sizeof(reply) - 1);
+    begin();
+    end(STAT_SOCKET_RECEIVE, lte.socketReceive() ==
+        (int) (sizeof(reply) - 1));
+
+    // Nothing pending: SRING lets this return without asking the modem
+    begin();
+    end(STAT_IDLE_RECEIVE, lte.socketReceive() == 0);
+
+    begin();
+    end(STAT_SOCKET_READY, lte.socketReady());
+
+    begin();
+    end(STAT_SOCKET_CLOSE, lte.socketClose());
+
+    // Context and socket settings unchanged: only AT#SD goes out
+    uint32_t commands = modem.commandCount();
+    begin();
+    end(STAT_SOCKET_REOPEN, lte.socketOpen((char*) "10.0.0.1", 80) &&
+        (modem.commandCount() == commands + 1));
+    lte.socketClose();
+
+    // The failed dial finds the context gone, reactivates it and redials
+    modem.dropContext();
+    begin();
+    end(STAT_CONTEXT_LOST, lte.socketOpen((char*) "10.0.0.1", 80) &&
+        lte.socketReady());
+    lte.socketClose();
+
+    // The remote close arrives as a URC; the write fails without AT traffic
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    modem.remoteClose(DEFAULT_CONN_ID);
+    delay(5);
+    lte.poll();
+    commands = modem.commandCount();
+    begin();
+    end(STAT_REMOTE_CLOSE, (lte.socketWrite((char*) request) == -1) &&
+        (modem.commandCount() == commands));
+    lte.socketClose();
+
+    // What the server sent before closing is still there to read
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    modem.pushRemoteData(DEFAULT_CONN_ID, reply, sizeof(reply) - 1);
+    modem.remoteClose(DEFAULT_CONN_ID);
+    delay(5);
+    lte.poll();
+    begin();
+    end(STAT_READ_CLOSED, !lte.socketReady() &&
+        (lte.socketReceive() == (int) (sizeof(reply) - 1)) &&
+        (memcmp(lte.getReceivedData(), reply, sizeof(reply) - 1) == 0) &&
+        (lte.socketReceive() == -1));
+    lte.socketClose();
+}
+
+// Closes the connection as soon as the first packet arrives
+static void dropPeer(LE910Sim* sim, int connId, const std::string& data,
+                     void* context) {
+    sim->remoteClose(connId);
+}
+
+// Bulk transfers through AT#SRECV and AT#SSENDEXT
+static void benchBulk() {
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, bulkBytes);
+    waitAvailable(bulkBytes);
+    begin();
+    int n = lte.socketReceive();
+    end(STAT_BULK_RECEIVE, (n == bulkBytes) &&
+        (memcmp(lte.getReceivedData(), bulk, n) == 0), n);
+    lte.socketClose();
+
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    StreamCheck check = { bulk, bulkBytes, 0, true };
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, bulkBytes);
+    waitAvailable(bulkBytes);
+    begin();
+    n = lte.socketReceive(checkChunk, &check);
+    end(STAT_STREAM_RECEIVE, (n == bulkBytes) && check.match &&
+        (check.received == bulkBytes), n);
+    lte.socketClose();
+
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    modem.setRemoteReply("", 0);
+    begin();
+    n = lte.socketWrite((const uint8_t*) bulk, bulkBytes);
+    end(STAT_BULK_WRITE, (n == bulkBytes) &&
+        (modem.remoteReceived(DEFAULT_CONN_ID) ==
+         std::string(bulk, bulkBytes)), n);
+
+    // Chatty small records, one AT#SSENDEXT each or merged into packets
+    int smallBytes = (bulkBytes < SMALL_TOTAL) ? bulkBytes : SMALL_TOTAL;
+    std::string sent = modem.remoteReceived(DEFAULT_CONN_ID);
+    bool ok = true;
+    begin();
+    for (int i = 0; i < smallBytes; i += SMALL_WRITE) {
+        int len = (smallBytes - i < SMALL_WRITE) ? smallBytes - i : SMALL_WRITE;
+        if (lte.socketWrite((const uint8_t*) bulk + i, len) != len) ok = false;
+    }
+    sent.append(bulk, smallBytes);
+    end(STAT_SMALL_WRITE, ok &&
+        (modem.remoteReceived(DEFAULT_CONN_ID) == sent), smallBytes);
+
+    ok = true;
+    begin();
+    for (int i = 0; i < smallBytes; i += SMALL_WRITE) {
+        int len = (smallBytes - i < SMALL_WRITE) ? smallBytes - i : SMALL_WRITE;
+        if (lte.socketBufferWrite((const uint8_t*) bulk + i, len) != len)
+            ok = false;
+    }
+    ok = ok && lte.socketFlush();
+    sent.append(bulk, smallBytes);
+    end(STAT_BUFFER_WRITE, ok &&
+        (modem.remoteReceived(DEFAULT_CONN_ID) == sent), smallBytes);
+
+    // The peer goes away after the first of three packets: the packet it
+    // took is still counted
+    modem.setRemoteHandler(dropPeer);
+    begin();
+    n = lte.socketBufferWrite((const uint8_t*) bulk, 3 * PACKET_SIZE);
+    end(STAT_BUFFER_PARTIAL, n == PACKET_SIZE, n);
+    modem.setRemoteHandler(NULL);
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+    lte.socketClose();
+}
+
+// Three sockets open at once, serviced in turn by serviceSockets()
+static void benchMultiSocket() {
+    static const int ports[] = { 80, 1883, 443 };
+    LTE_Socket socks[] = {
+        LTE_Socket(&lte, 1), LTE_Socket(&lte, 2), LTE_Socket(&lte, 3)
+    };
+    StreamCheck checks[3];
+    modem.setRemoteReply("", 0);
+
+    bool ok = true;
+    for (int i = 0; i < 3; i++) {
+        if (i == 1) begin();
+        ok = socks[i].open((char*) "10.0.0.1", ports[i]) && ok;
+        if (i == 1) end(STAT_SECOND_OPEN, ok);
+    }
+
+    begin();
+    for (int i = 0; i < 3; i++) {
+        ok = (socks[i].write((const uint8_t*) request, sizeof(request) - 1) ==
+              (int) (sizeof(request) - 1)) && ok;
+    }
+    for (int i = 0; i < 3; i++) {
+        ok = (modem.remoteReceived(i + 1) ==
+              std::string(request, sizeof(request) - 1)) && ok;
+    }
+    end(STAT_MULTI_WRITE, ok, 3 * (sizeof(request) - 1));
+
+    // Each socket receives its own share of the bulk payload
+    int share = bulkBytes / 3;
+    for (int i = 0; i < 3; i++) {
+        checks[i].expected = bulk + i * share;
+        checks[i].len = share;
+        checks[i].received = 0;
+        checks[i].match = true;
+        socks[i].onReceive(checkChunk, &checks[i]);
+        modem.pushRemoteData(i + 1, bulk + i * share, share);
+    }
+    begin();
+    uint32_t start = millis();
+    int received = 0;
+    while ((received < 3 * share) && (millis() - start < 5000))
+        received += lte.serviceSockets();
+    ok = (received == 3 * share);
+    for (int i = 0; i < 3; i++)
+        ok = ok && checks[i].match && (checks[i].received == share);
+    end(STAT_MULTI_SERVICE, ok, received);
+
+    for (int i = 2; i >= 0; i--) {
+        socks[i].onReceive(NULL);
+        socks[i].close();
+    }
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+}
+
+// Bulk transfers in online data mode
+static void benchOnline() {
+    begin();
+    end(STAT_ONLINE_OPEN, lte.socketOpenOnline((char*) "10.0.0.1", 80));
+
+    begin();
+    int n = lte.onlineWrite(bulk, bulkBytes);
+    end(STAT_ONLINE_WRITE, n == bulkBytes, n);
+
+    char* buf = (char*) malloc(bulkBytes);
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, bulkBytes);
+    begin();
+    n = lte.onlineRead(buf, bulkBytes, 200);
+    end(STAT_ONLINE_READ, (n == bulkBytes) &&
+        (memcmp(buf, bulk, bulkBytes) == 0), n);
+    free(buf);
+
+    begin();
+    end(STAT_ONLINE_SUSPEND, lte.socketSuspend() &&
+        (modem.remoteReceived(DEFAULT_CONN_ID) ==
+         std::string(bulk, bulkBytes)));
+    lte.socketClose();
+
+    // The server closes: onlineRead() stops at NO CARRIER, and
+    // socketSuspend() finds the modem already in command mode
+    char tail[64];
+    lte.socketOpenOnline((char*) "10.0.0.1", 80);
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, 32);
+    modem.remoteClose(DEFAULT_CONN_ID);
+    begin();
+    n = lte.onlineRead(tail, sizeof(tail), 200);
+    bool ok = (n == 32) && (memcmp(tail, bulk, 32) == 0) &&
+              !lte.isOnline() && !lte.socketReady();
+    lte.socketOpenOnline((char*) "10.0.0.1", 80);
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, 32);
+    modem.remoteClose(DEFAULT_CONN_ID);
+    ok = lte.socketSuspend() && ok;
+    end(STAT_ONLINE_CLOSED, ok && !lte.isOnline() && !lte.socketReady() &&
+        lte.getCommandOK("AT"));
+}
+
+// Sends the request on a socket and reads the whole reply
+static bool exchange(LTE_SocketPool* pool, int conn_id) {
+    char buf[sizeof(reply)];
+    int n = pool ? pool->write(conn_id, (const uint8_t*) request,
+                               sizeof(request) - 1)
+                 : lte.socketWrite(conn_id, (const uint8_t*) request,
+                                   sizeof(request) - 1);
+    if (n != (int) (sizeof(request) - 1)) return false;
+    uint32_t start = millis();
+    while ((lte.socketAvailable(conn_id) < (int) sizeof(reply) - 1) &&
+           (millis() - start < 1000))
+        ;
+    return (lte.socketReceive(conn_id, buf, sizeof(buf)) ==
+            (int) (sizeof(reply) - 1)) &&
+           (memcmp(buf, reply, sizeof(reply) - 1) == 0);
+}
+
+// Repeated requests to one server, with and without the socket pool
+static void benchPool() {
+    begin();
+    bool ok = lte.socketOpen((char*) "10.0.0.1", 80, 1) && exchange(NULL, 1);
+    end(STAT_CLOSE_REQUEST, lte.socketClose(1) && ok);
+
+    LTE_SocketPool pool(&lte);
+    int id = pool.acquire((char*) "10.0.0.1", 80);
+    exchange(&pool, id);
+    pool.release(id);
+
+    begin();
+    id = pool.acquire((char*) "10.0.0.1", 80);
+    ok = (id > 0) && exchange(&pool, id);
+    pool.release(id);
+    end(STAT_POOLED_REQUEST, ok);
+
+    // The server drops the idle connection; the pool dials it again
+    modem.remoteClose(id);
+    delay(5);
+    begin();
+    id = pool.acquire((char*) "10.0.0.1", 80);
+    ok = (id > 0) && exchange(&pool, id);
+    pool.release(id);
+    end(STAT_POOL_RECONNECT, ok);
+
+    pool.closeAll();
+}
+
+// Connects by host name, with the modem resolving it on every AT#SD and
+// with the DNS cache
+static void benchDNS() {
+    char host[] = "api.example.com";
+    modem.resetStats();
+    begin();
+    bool ok = lte.socketOpen(host, 80) && (modem.dnsLookups() == 1);
+    end(STAT_OPEN_BY_NAME, lte.socketClose() && ok);
+
+    lte.setDNSCache(true);
+    lte.socketOpen(host, 80);   // Fills the cache
+    lte.socketClose();
+    modem.resetStats();
+    begin();
+    ok = lte.socketOpen(host, 80) && (modem.dnsLookups() == 0);
+    end(STAT_OPEN_DNS_CACHED, lte.socketClose() && ok);
+    lte.setDNSCache(false);
+    lte.clearDNSCache();
+}
+
+// UDP: no handshake to open, one datagram per write, and reads that keep
+// datagram boundaries and report the sender
+static void benchUDP() {
+    begin();
+    bool ok = lte.socketOpenUDP((char*) "10.0.0.1", 5683, 4, 5683);
+    end(STAT_UDP_OPEN, ok);
+
+    char buf[sizeof(reply)];
+    char ip[16];
+    int port = 0;
+    begin();
+    ok = (lte.socketWrite(4, (const uint8_t*) request, sizeof(request) - 1) ==
+          (int) (sizeof(request) - 1));
+    for (uint32_t start = millis();
+         ok && (lte.socketAvailable(4) <= 0) && (millis() - start < 1000); )
+        ;
+    ok = ok && (lte.socketReceiveFrom(4, buf, sizeof(buf), ip, &port) ==
+                (int) (sizeof(reply) - 1)) &&
+         (memcmp(buf, reply, sizeof(reply) - 1) == 0) &&
+         (strcmp(ip, "10.0.0.1") == 0) && (port == 5683);
+    end(STAT_UDP_EXCHANGE, ok);
+
+    // Three datagrams waiting at once, the last longer than the buffer;
+    // then a datagram to another address
+    modem.setRemoteReply("", 0);
+    modem.pushRemoteData(4, "first", 5);
+    modem.pushRemoteData(4, "second!", 7);
+    std::string big(100, 'x');
+    modem.pushRemoteData(4, big.data(), big.size());
+    for (uint32_t start = millis();
+         (lte.socketAvailable(4) < 112) && (millis() - start < 1000); )
+        ;
+    begin();
+    ok = (lte.socketReceiveFrom(4, buf, 16) == 5) &&
+         (memcmp(buf, "first", 5) == 0) &&
+         (lte.socketReceiveFrom(4, buf, 16) == 7) &&
+         (memcmp(buf, "second!", 7) == 0) &&
+         (lte.socketReceiveFrom(4, buf, 16) == 16) &&
+         (lte.socketAvailable(4) == 0) &&
+         (lte.socketReceiveFrom(4, buf, 16) == 0);
+    end(STAT_UDP_DATAGRAMS, ok &&
+        (lte.socketSendTo(4, (const uint8_t*) "ack", 3, "10.0.0.9", 7000) == 3) &&
+        (modem.remoteReceived(4) ==
+         std::string(request, sizeof(request) - 1) + "ack"));
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+    lte.socketClose(4);
+}
+
+// Collects an HTTP response body
+static void appendBody(const char* buf, uint32_t len, void* context) {
+    ((std::string*) context)->append(buf, len);
+}
+
+// Tokenizes the JSON body one byte at a time, as if every byte arrived in
+// its own receive, and checks that the tokens match
+static bool checkJSON() {
+    static const uint8_t expected[] = {
+        JSON_OBJECT_START, JSON_KEY, JSON_OBJECT_START, JSON_KEY, JSON_NUMBER,
+        JSON_KEY, JSON_NUMBER, JSON_OBJECT_END, JSON_KEY, JSON_ARRAY_START,
+        JSON_OBJECT_START, JSON_KEY, JSON_NUMBER, JSON_KEY, JSON_STRING,
+        JSON_KEY, JSON_STRING, JSON_KEY, JSON_STRING, JSON_OBJECT_END,
+        JSON_ARRAY_END, JSON_KEY, JSON_OBJECT_START, JSON_KEY, JSON_NUMBER,
+        JSON_KEY, JSON_NUMBER, JSON_KEY, JSON_NUMBER, JSON_OBJECT_END,
+        JSON_KEY, JSON_ARRAY_START, JSON_ARRAY_START, JSON_NUMBER,
+        JSON_NUMBER, JSON_ARRAY_END, JSON_ARRAY_START, JSON_TRUE, JSON_NULL,
+        JSON_ARRAY_END, JSON_ARRAY_END, JSON_KEY, JSON_STRING, JSON_KEY,
+        JSON_STRING, JSON_KEY, JSON_NUMBER, JSON_OBJECT_END
+    };
+    const char* body = strstr(jsonReply, "\r\n\r\n") + 4;
+    LTE_JSON json;
+    unsigned int n = 0;
+    bool ok = true;
+    for (const char* p = body; *p != '\0'; p++) {
+        json.setInput(p, 1);
+        uint8_t token;
+        while ((token = json.next()) != JSON_NONE) {
+            if ((n >= sizeof(expected)) || (token != expected[n++])) ok = false;
+            if ((token == JSON_STRING) && json.pathIs("note"))
+                ok = ok && (strcmp(json.getValue(), "caf\xc3\xa9 \"ok\"") == 0);
+            if (json.pathIs("tags[0][1]"))
+                ok = ok && (strcmp(json.getValue(), "2") == 0);
+        }
+    }
+    return ok && (n == sizeof(expected)) && json.isDone();
+}
+
+// HTTP requests on a new connection, a kept-alive one, and with a chunked
+// response
+// Answers with the bulk payload as a body delimited by the close of the
+// connection. It takes several AT#SRECV, so NO CARRIER arrives mid-body.
+static void closePeer(LE910Sim* sim, int connId, const std::string& data,
+                      void* context) {
+    std::string reply = closeHeader + std::string(bulk, bulkBytes);
+    sim->pushRemoteData(connId, reply.data(), reply.size());
+    sim->remoteClose(connId);
+}
+
+static void benchHTTP() {
+    LTE_HTTP http(&lte);
+    std::string body;
+    http.onBody(appendBody, &body);
+
+    begin();
+    bool ok = (http.get((char*) "10.0.0.1", "/hello") == 200) &&
+              (body == "Hello, World.") && http.isKeepAlive();
+    end(STAT_HTTP_GET, ok);
+
+    // Only the request and the AT#SRECV for the response go out
+    body.clear();
+    uint32_t commands = modem.commandCount();
+    begin();
+    ok = (http.get((char*) "10.0.0.1", "/hello") == 200) &&
+         (body == "Hello, World.") && (modem.commandCount() == commands + 2);
+    end(STAT_HTTP_KEEP_ALIVE, ok);
+
+    modem.setRemoteReply(chunkedReply, sizeof(chunkedReply) - 1);
+    body.clear();
+    begin();
+    ok = (http.get((char*) "10.0.0.1", "/hello") == 200) &&
+         (body == "Hello, World.") && (http.getBodyLength() == 13);
+    end(STAT_HTTP_CHUNKED, ok);
+
+    // Three fields picked out of the body while it is received
+    modem.setRemoteReply(jsonReply, sizeof(jsonReply) - 1);
+    LTE_JSON json;
+    int temp = json.addPath("main.temp");
+    int desc = json.addPath("weather[0].description");
+    int name = json.addPath("name");
+    int tag = json.addPath("tags[1][1]");
+    http.onBody(LTE_JSON::onData, &json);
+    begin();
+    ok = (http.get((char*) "10.0.0.1", "/weather") == 200) && json.isDone() &&
+         (json.getFloat(temp) == 301.52) &&
+         (strcmp(json.getString(desc), "clear sky") == 0) &&
+         (strcmp(json.getString(name), "Dallas") == 0) &&
+         (json.getType(tag) == JSON_NULL);
+    end(STAT_HTTP_JSON, ok && checkJSON());
+
+    // No Content-Length: the body ends where the server closes
+    http.onBody(appendBody, &body);
+    body.clear();
+    modem.setRemoteHandler(closePeer);
+    begin();
+    ok = (http.get((char*) "10.0.0.1", "/hello") == 200) &&
+         (body == std::string(bulk, bulkBytes));
+    end(STAT_HTTP_TO_CLOSE, ok, bulkBytes);
+    modem.setRemoteHandler(NULL);
+
+    http.close();
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+}
+
+// TLS on the modem's SSL socket: a full handshake, a request, a reopen
+// that resumes the session, and HTTP over it
+static void benchTLS() {
+    static const char ca[] =
+        "-----BEGIN CERTIFICATE-----\nMIIBsimulated\n-----END CERTIFICATE-----\n";
+    bool ok = lte.sslSetCertificate(SSL_CERT_CA, (const uint8_t*) ca,
+                                    sizeof(ca) - 1) &&
+              lte.sslSetAuthMode(SSL_AUTH_SERVER) &&
+              (modem.certificate(SSL_CERT_CA) == ca);
+
+    lte.setSSLSessionReuse(false);  // Forget any session of a previous run
+    lte.socketOpen((char*) "10.0.0.1", 443, SSL_CONN_ID);
+    lte.socketClose(SSL_CONN_ID);
+    lte.setSSLSessionReuse(true);
+
+    modem.resetStats();
+    begin();
+    ok = ok && lte.socketOpen((char*) "10.0.0.1", 443, SSL_CONN_ID) &&
+         (modem.fullHandshakes() == 1);
+    end(STAT_TLS_OPEN, ok);
+
+    begin();
+    end(STAT_TLS_REQUEST, exchange(NULL, SSL_CONN_ID) &&
+        (modem.remoteReceived(SIM_SSL_SOCKET) ==
+         std::string(request, sizeof(request) - 1)));
+    lte.socketClose(SSL_CONN_ID);
+
+    begin();
+    ok = lte.socketOpen((char*) "10.0.0.1", 443, SSL_CONN_ID) &&
+         (modem.resumedHandshakes() == 1) && (modem.fullHandshakes() == 1);
+    end(STAT_TLS_RESUMED, ok);
+
+    LTE_HTTP https(&lte, SSL_CONN_ID);
+    https.get((char*) "10.0.0.1", "/hello", 443);
+    begin();
+    ok = (https.get((char*) "10.0.0.1", "/hello", 443) == 200) &&
+         (https.getBodyLength() == 13) && (modem.resumedHandshakes() == 2);
+    end(STAT_HTTPS_GET, ok);
+    https.close();
+}
+
+// MQTT broker stand-in: answers CONNECT, PUBLISH, SUBSCRIBE and PINGREQ
+// from the simulator's remote peer, and sends messages on "bench/echo"
+// back to the client
+struct Broker {
+    std::string input;      // Start of a packet split between sends
+    bool session;           // A persistent session is kept
+    int publishes;          // PUBLISH packets received
+    int clientAcks;         // PUBACK packets received
+    uint16_t lastAckId;     // Packet ID of the last of them
+    int pings;              // PINGREQ packets received
+};
+
+static void brokerPeer(LE910Sim* sim, int connId, const std::string& data,
+                       void* context) {
+    Broker* broker = (Broker*) context;
+    broker->input += data;
+    std::string out;
+    while (broker->input.size() >= 2) {
+        const std::string& in = broker->input;
+        size_t pos = 1;
+        uint32_t len = 0;
+        for (int shift = 0; pos < in.size(); shift += 7) {
+            uint8_t c = in[pos++];
+            len |= (uint32_t) (c & 0x7F) << shift;
+            if (!(c & 0x80)) break;
+        }
+        if (in.size() < pos + len) break;
+        std::string packet = in.substr(0, pos + len);
+        std::string body = in.substr(pos, len);
+        uint8_t type = packet[0];
+        switch (type & 0xF0) {
+        case 0x10: {    // CONNECT; flags follow "\0\4MQTT\4"
+            bool clean = body[7] & 0x02;
+            out += std::string("\x20\x02", 2) +
+                   (char) ((broker->session && !clean) ? 1 : 0) + '\0';
+            broker->session = !clean;
+            break;
+        }
+        case 0x30: {    // PUBLISH
+            broker->publishes++;
+            uint32_t topicLen = ((uint8_t) body[0] << 8) | (uint8_t) body[1];
+            if (type & 0x02)
+                out += std::string("\x40\x02", 2) + body.substr(2 + topicLen, 2);
+            if (body.compare(2, topicLen, "bench/echo") == 0) out += packet;
+            break;
+        }
+        case 0x40:      // PUBACK
+            broker->clientAcks++;
+            broker->lastAckId = ((uint8_t) body[0] << 8) | (uint8_t) body[1];
+            break;
+        case 0x80:      // SUBSCRIBE; grant the QoS asked for
+            out += std::string("\x90\x03", 2) + body.substr(0, 2) +
+                   body[body.size() - 1];
+            break;
+        case 0xC0:      // PINGREQ
+            broker->pings++;
+            out += std::string("\xD0\x00", 2);
+            break;
+        }
+        broker->input.erase(0, pos + len);
+    }
+    if (!out.empty()) sim->pushRemoteData(connId, out.data(), out.size());
+}
+
+struct MQTTCheck {
+    int messages;
+    int acks;
+    std::string payload;
+};
+
+static void mqttMessage(const char* topic, const uint8_t* payload,
+                        uint32_t len, void* context) {
+    MQTTCheck* check = (MQTTCheck*) context;
+    if (strcmp(topic, "bench/echo") != 0) return;
+    check->messages++;
+    check->payload.assign((const char*) payload, len);
+}
+
+static void mqttAck(uint16_t packetId, void* context) {
+    ((MQTTCheck*) context)->acks++;
+}
+
+// Calls loop() until no QoS 1 message awaits PUBACK
+static bool mqttWaitAcks(LTE_MQTT* mqtt) {
+    uint32_t start = millis();
+    while (mqtt->pendingCount() > 0) {
+        if (!mqtt->loop() || (millis() - start > 1000)) return false;
+    }
+    return true;
+}
+
+// Publishes MQTT_BATCH QoS 1 messages and waits for their PUBACKs
+static bool mqttPublishBatch(LTE_MQTT* mqtt, bool flushEach) {
+    char payload[48];
+    for (int i = 0; i < MQTT_BATCH; i++) {
+        snprintf(payload, sizeof(payload),
+                 "{\"sensor\":\"motion\",\"seq\":%d,\"t\":21.5}", i);
+        if (mqtt->publish("bench/telemetry", payload, 1) <= 0) return false;
+        if (flushEach && !mqtt->flush()) return false;
+    }
+    return mqttWaitAcks(mqtt);
+}
+
+// MQTT against the broker stand-in: a persistent session, a QoS 1 round
+// trip through a subscription, batched and unbatched publishing, and the
+// keep-alive ping
+static void benchMQTT() {
+    static Broker broker;
+    broker.input.clear();
+    broker.publishes = 0;
+    broker.clientAcks = 0;
+    broker.lastAckId = 0;
+    broker.pings = 0;
+    bool hadSession = broker.session;
+    modem.setRemoteHandler(brokerPeer, &broker);
+
+    LTE_MQTT mqtt(&lte);
+    MQTTCheck check = { 0, 0, "" };
+    mqtt.onMessage(mqttMessage, &check);
+    mqtt.onAck(mqttAck, &check);
+
+    begin();
+    bool ok = mqtt.connect((char*) "10.0.0.1", 1883, "lte-bench") &&
+              (mqtt.sessionPresent() == hadSession);
+    end(STAT_MQTT_CONNECT, ok);
+    if (!mqtt.sessionPresent()) mqtt.subscribe("bench/echo", 1);
+    mqttWaitAcks(&mqtt);
+    mqtt.loop();
+
+    // The broker sends the message back with QoS 1, which is acknowledged
+    begin();
+    ok = (mqtt.publish("bench/echo", "ping", 1) > 0) && mqttWaitAcks(&mqtt);
+    for (uint32_t start = millis(); ok && (check.messages == 0) &&
+         (millis() - start < 1000); )
+        ok = mqtt.loop();
+    mqtt.flush();
+    end(STAT_MQTT_ECHO, ok && (check.messages == 1) &&
+        (check.payload == "ping") && (broker.clientAcks == 1));
+
+    // One AT#SSENDEXT for the batch and one AT#SRECV for its PUBACKs
+    int acks = check.acks;
+    uint32_t commands = modem.commandCount();
+    begin();
+    ok = mqttPublishBatch(&mqtt, false);
+    end(STAT_MQTT_BATCHED, ok && (check.acks == acks + MQTT_BATCH) &&
+        (modem.commandCount() == commands + 2));
+
+    begin();
+    end(STAT_MQTT_UNBATCHED, mqttPublishBatch(&mqtt, true) &&
+        (broker.publishes == 1 + 2 * MQTT_BATCH));
+
+    // With a 1 s keep-alive a ping is due after 750 ms of silence
+    ok = mqtt.connect((char*) "10.0.0.1", 1883, "lte-bench", NULL, NULL,
+                      false, 1);
+    delay(800);
+    begin();
+    ok = ok && mqtt.loop() && (broker.pings == 1);
+    uint32_t pingUs = micros() - startUs;
+
+    // PINGRESP arrives and no second ping is sent
+    for (uint32_t start = millis(); ok && (millis() - start < 100); )
+        ok = mqtt.loop();
+    startUs = micros() - pingUs;
+    end(STAT_MQTT_PING, ok && (broker.pings == 1));
+
+    // A message too long to deliver is still acknowledged, or the broker
+    // would send it again on every reconnect
+    std::string topic(MQTT_BUFFER_SIZE + 44, 't');
+    std::string publish = std::string("\x32") +
+        (char) (0x80 | ((topic.size() + 4) & 0x7F)) +
+        (char) ((topic.size() + 4) >> 7) +
+        (char) (topic.size() >> 8) + (char) topic.size() + topic + "\x12\x34";
+    int clientAcks = broker.clientAcks;
+    modem.pushRemoteData(DEFAULT_CONN_ID, publish.data(), publish.size());
+    begin();
+    ok = true;
+    for (uint32_t start = millis(); ok && (broker.clientAcks == clientAcks) &&
+         (millis() - start < 1000); )
+        ok = mqtt.loop();
+    end(STAT_MQTT_LONG_TOPIC, ok && (broker.clientAcks == clientAcks + 1) &&
+        (broker.lastAckId == 0x1234) && (check.messages == 1));
+
+    // A remaining length over 4 bytes loses the framing: the client drops
+    // the connection instead of misreading what follows
+    static const char malformed[] = "\x30\xFF\xFF\xFF\xFF\x01";
+    modem.pushRemoteData(DEFAULT_CONN_ID, malformed, sizeof(malformed) - 1);
+    delay(5);
+    begin();
+    end(STAT_MQTT_MALFORMED, !mqtt.loop() && !mqtt.connected());
+
+    mqtt.disconnect();
+    modem.setRemoteHandler(NULL);
+}
+
+// External memory for the queue's spill, kept in RAM
+class BenchStorage : public LTE_QueueStorage {
+public:
+    BenchStorage() : failing(false) {};
+    virtual uint32_t size() { return sizeof(mem); };
+    virtual bool read(uint32_t addr, uint8_t* buf, size_t len) {
+        if (failing) return false;
+        memcpy(buf, mem + addr, len);
+        return true;
+    };
+    virtual bool write(uint32_t addr, const uint8_t* buf, size_t len) {
+        memcpy(mem + addr, buf, len);
+        return true;
+    };
+    bool failing;               // Reads fail, as from a worn-out chip
+private:
+    uint8_t mem[2048];
+};
+
+// Queues readings numbered from first, appending each to expected
+static void queueReadings(LTE_Queue* queue, int first, int n,
+                          std::string* expected) {
+    char record[48];
+    for (int i = first; i < first + n; i++) {
+        snprintf(record, sizeof(record), "{\"seq\":%d,\"t\":21.5}\n", i);
+        queue->push(record);
+        if (expected != NULL) *expected += record;
+    }
+}
+
+// Store-and-forward: readings queued while offline go out in packet-sized
+// batches over one connection, spilling to storage when RAM is full
+static void benchStoreForward() {
+    static LTE_Queue queue;
+    static BenchStorage storage;
+    modem.setRemoteReply("", 0);
+    std::string expected;
+    queue.clear();
+    queue.setStorage(NULL);
+
+    // 32 readings of about 22 bytes: 3 packets of 300 bytes
+    queueReadings(&queue, 0, QUEUED, &expected);
+    uint32_t commands = modem.commandCount();
+    begin();
+    bool ok = (queue.upload(&lte, (char*) "10.0.0.1", 8080, 3) == QUEUED) &&
+              (queue.count() == 0) && (modem.remoteReceived(3) == expected);
+    uint32_t ssends = modem.commandCount() - commands;
+    end(STAT_QUEUE_UPLOAD, ok && (ssends < 8), expected.size());
+    lte.socketClose(3);
+
+    // More than the RAM ring holds; the oldest move to storage in order
+    queue.setStorage(&storage);
+    expected.clear();
+    uint32_t dropped = queue.dropped();
+    queueReadings(&queue, 0, SPILLED, &expected);
+    ok = (queue.count() == SPILLED) && (queue.spilled() > 0) &&
+         (queue.dropped() == dropped);
+    begin();
+    ok = (queue.upload(&lte, (char*) "10.0.0.1", 8080, 3) == SPILLED) &&
+         ok && (modem.remoteReceived(3) == expected);
+    end(STAT_QUEUE_SPILLED, ok, expected.size());
+    lte.socketClose(3);
+
+    // Without storage a full queue keeps the newest readings
+    queue.setStorage(NULL);
+    dropped = queue.dropped();
+    queueReadings(&queue, 0, SPILLED, NULL);
+    begin();
+    ok = queue.push("{\"seq\":80,\"t\":21.5}\n");
+    end(STAT_QUEUE_FULL, ok);
+
+    uint8_t oldest[QUEUE_RECORD_SIZE];
+    char record[48];
+    int first = SPILLED + 1 - queue.count();
+    int len = snprintf(record, sizeof(record), "{\"seq\":%d,\"t\":21.5}\n",
+                       first);
+    if ((queue.dropped() - dropped != (uint32_t) first) ||
+        (queue.peek(oldest) != len) || (memcmp(oldest, record, len) != 0))
+        stats[STAT_QUEUE_FULL].failures++;
+    queue.clear();
+
+    // Storage that cannot be read: push() gives up instead of spinning
+    queue.setStorage(&storage);
+    queueReadings(&queue, 0, OVERFILLED, NULL);
+    storage.failing = true;
+    dropped = queue.dropped();
+    begin();
+    ok = !queue.push("{\"seq\":200,\"t\":21.5}\n");
+    end(STAT_QUEUE_BAD_STORAGE, ok && (queue.dropped() == dropped + 1));
+    storage.failing = false;
+    queue.setStorage(NULL);
+    queue.clear();
+
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+}
+
+// Runs the slow commands through the queue, timing the longest poll() call
+static bool runQueued(uint8_t depth, double* longestPollMs) {
+    CommandFuture futures[4];
+    bool ok = true;
+    lte.setPipelineDepth(depth);
+    for (int i = 0; i < 4; i++)
+        ok = lte.queueCommand(slowCommands[i], &futures[i]) && ok;
+
+    *longestPollMs = 0;
+    uint32_t start = millis();
+    while (ok && !futures[3].done && (millis() - start < 2000)) {
+        uint32_t pollUs = micros();
+        lte.poll();
+        double ms = (micros() - pollUs) / 1000.0;
+        if (ms > *longestPollMs) *longestPollMs = ms;
+    }
+    for (int i = 0; i < 4; i++)
+        ok = ok && futures[i].done && (futures[i].result == RESULT_OK);
+    lte.setPipelineDepth(1);
+    return ok;
+}
+
+// Blocking, queued and pipelined execution of slow commands
+static void benchQueue() {
+    bool ok = true;
+    begin();
+    for (int i = 0; i < 4; i++)
+        ok = lte.getCommandOK(slowCommands[i]) && ok;
+    end(STAT_BLOCKING_CMDS, ok);
+
+    double longest;
+    begin();
+    ok = runQueued(1, &longest);
+    end(STAT_QUEUED_CMDS, ok);
+
+    startUs = micros() - (uint32_t) (longest * 1000);
+    end(STAT_LONGEST_POLL, ok);
+
+    begin();
+    end(STAT_PIPELINED_CMDS, runQueued(4, &longest));
+}
+
+// Learned response deadlines: a response that never comes costs the
+// deadline learned for quick commands, and a reply slower than that
+// succeeds once a timeout has backed the deadline off
+static void benchTimeouts() {
+    LTE_Timeouts* timeouts = lte.getTimeouts();
+    uint32_t learned = timeouts->getTimeout(TIMEOUT_LOCAL);
+
+    modem.setUnanswered("AT+CSQ");
+    begin();
+    bool ok = !lte.getCommandOK("AT+CSQ");
+    double ms = end(STAT_UNANSWERED, ok);
+    modem.setUnanswered(NULL);
+    ok = (ms >= learned) && (ms < learned + 50) &&
+         (timeouts->getTimeout(TIMEOUT_LOCAL) > learned) &&
+         lte.getCommandOK("AT") &&  // Answered in time: backoff taken back
+         (timeouts->getTimeout(TIMEOUT_LOCAL) == learned);
+    if (!ok) stats[STAT_UNANSWERED].failures++;
+
+    modem.setLatency("AT+CIMI", SLOW_REPLY);
+    ok = !lte.getCommandOK("AT+CIMI");
+    delay(SLOW_REPLY);          // The late response is discarded
+    lte.poll();
+    begin();
+    ok = lte.getCommandOK("AT+CIMI") && ok;
+    uint32_t len = 0;
+    char* imsi = lte.getLine(0, &len);
+    end(STAT_SLOW_RETRY, ok && (imsi != NULL) && (len == 15) &&
+        (memcmp(imsi, "311480000000000", len) == 0));
+    modem.setLatency("AT+CIMI", latency);
+
+    // Quick AT+CGATT? queries must not shorten the attach's deadline
+    for (int i = 0; i < TIMEOUT_MIN_SAMPLES; i++) lte.getCommandOK("AT+CGATT?");
+    lte.getCommandOK("AT+CGATT=0");
+    modem.setLatency("AT+CGATT=1", SLOW_ATTACH);
+    begin();
+    end(STAT_SLOW_ATTACH, lte.gprsAttach());
+    modem.setLatency("AT+CGATT=1", latency);
+}
+
+// Baud rate negotiation: the fastest rate on a clean line, a bulk receive
+// at it with RTS flow control, falling back from a rate the line cannot
+// carry, and init() finding a modem left at a negotiated rate
+static void benchBaud(uint32_t baud) {
+    begin();
+    end(STAT_NEGOTIATE, lte.negotiateBaudRate() == BAUD_MAX);
+
+    // A consumer slower than the line, so RTS has to pause the modem
+    lte.socketOpen((char*) "10.0.0.1", 80);
+    StreamCheck check = { bulk, bulkBytes, 0, true };
+    modem.pushRemoteData(DEFAULT_CONN_ID, bulk, bulkBytes);
+    waitAvailable(bulkBytes);
+    begin();
+    int n = lte.socketReceive(slowChunk, &check);
+    end(STAT_FAST_RECEIVE, (n == bulkBytes) && check.match &&
+        (check.received == bulkBytes), n);
+    lte.socketClose();
+
+    LTE_Base fresh(&modem);
+    fresh.setFlowControl(RTS_PIN);
+    begin();
+    end(STAT_INIT_FAST, fresh.init(4) &&
+        (fresh.getBaudRate() == BAUD_MAX) && fresh.getCommandOK("AT"));
+
+    lte.setBaudRate(baud);
+    modem.setLineErrors(NOISY_BAUD, NOISY_BYTES);
+    begin();
+    bool ok = lte.negotiateBaudRate() == NOISY_BAUD;
+    end(STAT_NEGOTIATE_NOISY, ok && lte.getCommandOK("AT"));
+    modem.setLineErrors(0, 0);
+    if (!lte.setBaudRate(baud)) stats[STAT_NEGOTIATE_NOISY].failures++;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 5;
+    uint32_t baud = 115200;
+
+    bool dumpMetrics = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:l:s:m")) != -1) {
+        switch (opt) {
+        case 'n': iterations = atoi(optarg); break;
+        case 'b': baud = strtoul(optarg, NULL, 10); break;
+        case 'l': latency = strtoul(optarg, NULL, 10); break;
+        case 's': bulkBytes = atoi(optarg); break;
+        case 'm': dumpMetrics = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-b baud] "
+                    "[-l latency_ms] [-s bulk_bytes] [-m]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    modem.setBaud(baud);
+    modem.setLatency(latency);
+    modem.setLatency("AT#SD=", DIAL_LATENCY);
+    modem.setDNSLatency(DNS_LATENCY);
+    modem.setHandshakeLatency(FULL_HANDSHAKE, RESUMED_HANDSHAKE);
+    modem.setLatency("AT+CGM", SLOW_LATENCY);
+    modem.setLatency("AT+CGSN", SLOW_LATENCY);
+    modem.setRemoteReply(reply, sizeof(reply) - 1);
+    modem.setRTSPin(RTS_PIN);
+    lte.setFlowControl(RTS_PIN);
+
+    bulk = (char*) malloc(bulkBytes);
+    for (int i = 0; i < bulkBytes; i++) bulk[i] = (char) (i % 256);
+
+    for (int i = 0; i < iterations; i++) {
+        lte.getTimeouts()->reset();     // Every iteration learns anew
+        benchCommandMode();
+        benchBulk();
+        benchMultiSocket();
+        benchOnline();
+        benchPool();
+        benchDNS();
+        benchUDP();
+        benchHTTP();
+        benchTLS();
+        benchMQTT();
+        benchStoreForward();
+        benchQueue();
+        benchTimeouts();
+        benchBaud(baud);
+    }
+
+    printf("LE910 simulator benchmark: %d iterations, %lu baud, "
+           "%lu ms command latency, %d byte bulk transfers\n\n", iterations,
+           (unsigned long) baud, (unsigned long) latency, bulkBytes);
+    printf("%-24s %6s %6s %10s %10s %10s %10s\n", "operation", "count",
+           "fail", "min ms", "avg ms", "max ms", "bytes/s");
+    for (int i = 0; i < NUM_STATS; i++) {
+        Stat* s = &stats[i];
+        printf("%-24s %6lu %6lu %10.2f %10.2f %10.2f", s->name,
+               (unsigned long) s->count, (unsigned long) s->failures,
+               s->minMs, (s->count == 0) ? 0 : s->sumMs / s->count, s->maxMs);
+        if ((s->bytes > 0) && (s->sumMs > 0))
+            printf(" %10.0f", s->bytes / (s->sumMs / 1000.0));
+        printf("\n");
+    }
+
+    if (dumpMetrics) {
+        printf("\nLibrary metrics:\n");
+        lte.getTimeouts()->dump(&Serial);
+        #ifdef LTE_METRICS
+        lte.dumpMetrics(&Serial);
+        #else
+        printf("not compiled in, build with -DLTE_METRICS\n");
+        #endif
+    }
+
+    free(bulk);
+    int failures = 0;
+    for (int i = 0; i < NUM_STATS; i++) failures += stats[i].failures;
+    return (failures == 0) ? 0 : 1;
+}
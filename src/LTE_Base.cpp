@@ -7,9 +7,13 @@
 #ifndef LTE_LTE_BASE_
 #define LTE_LTE_BASE_
 
-#include <math.h>
-#include <stdio.h>
 #include "LTE_Base.h"
+#include "LTE_Command.h"
+
+// AT+IPR rates setBaudRate() accepts, fastest first
+static const uint32_t baudRates[] = {
+    921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600
+};
 
 
 /** LTE Base class constructor.
@@ -27,9 +31,24 @@ LTE_Base::LTE_Base(HardwareSerial* tp, HardwareSerial* dp) {
     #ifndef DEBUG
     debugPort = NULL;
     #endif
-    memset(data, '\0', BASE_BUF_SIZE);
-    parsedData = NULL;
-    bufferFull = false;
+    resetParser();
+    baudRate = BAUD_DEFAULT;
+    rtsPin = -1;
+    ctsPin = -1;
+    rtsRaised = false;
+    commandPending = false;
+    pendingCommand[0] = '\0';
+    numURCHandlers = 0;
+    onlineMode = false;
+    queueHead = 0;
+    queueCount = 0;
+    queueSent = 0;
+    pipelineDepth = 1;
+    queueStarted = false;
+    queueActivity = 0;
+    commandClass = TIMEOUT_LOCAL;
+    commandStart = 0;
+    commandTimed = false;
 }
 
 /** Sets up initial settings, and selects frequency band that Telit
@@ -43,12 +62,17 @@ bool LTE_Base::init(uint32_t lte_band) {
     debugPort->write(">> Initializing LTE_Base ...\r\n");
     #endif
 
-    if (!getCommandOK("ATE0"))          // No command echo
+    // The modem may still be at a rate negotiated before a reset
+    telitPort->begin(baudRate);
+    if (!getCommandOK("ATE0") &&        // No command echo
+        !(findBaudRate() && getCommandOK("ATE0")))
         return false;
     if (!getCommandOK("ATV1"))          // Verbose response from modem
         return false;
-    if (!getCommandOK("AT+IPR=115200")) // Baud rate for Serial
+    if (!applyFlowControl())            // RTS/CTS as set up
         return false;
+    if (!LTE_Command(this, "AT+IPR").arg(baudRate).sendOK())
+        return false;                   // Fixed baud rate for Serial
 
     /* If you are using a 2G/3G capable device, you would change
      * The arguments here to include your GSM and UMTS bands. The Telit
@@ -60,11 +84,10 @@ bool LTE_Base::init(uint32_t lte_band) {
      * For LTE, given LTE Band n, the argument passed in is 2 exp(n - 1).
 	 * For example, LTE band 13 would need us to pass in 2^(13-1) = 4096.
      */
-    long double b = pow(2, lte_band-1);
-
-    char band[20];
-    sprintf(band, "AT#BND=0,0,%d", b);	// No GSM/UMTS, only LTE Band
-    if (!sendATCommand(band) || !receiveData(2000) || !parseFind("OK")) {
+    if ((lte_band < 1) || (lte_band > 32) ||
+        !LTE_Command(this, "AT#BND").arg(0).arg(0)   // No GSM/UMTS
+             .arg(LTE_BAND_MASK(lte_band)).send() ||
+        !receiveData() || !parseFind("OK")) {
         #ifdef DEBUG
         debugPort->write(">> Setting LTE Band failed\r\n");
         #endif
@@ -73,13 +96,32 @@ bool LTE_Base::init(uint32_t lte_band) {
     return true;
 }
 
-/** Sends an AT command to the Telit module.
+/** Sends an AT command to the Telit module. Fails while a socket is in
+ *  online data mode, since the modem would pass the command on to the
+ *  remote host. Commands queued with queueCommand() are completed first,
+ *  so their responses are not mistaken for this command's.
  *
  *  @param  cmd   String containing AT command to send.
  *  @return bool  True on success.
  */
 bool LTE_Base::sendATCommand(const char* cmd) {
-    if ((cmd == NULL) || (cmd[0] == '\0') || (bufferFull)) return false;
+    if (!startCommand(cmd)) return false;
+
+    // The command line ends at the S3 character (CR). A trailing LF would
+    // become the first data byte of AT#SSEND or an online mode socket.
+    writePort("\r");
+    return true;
+}
+
+/** Writes the start of a command line, without ending it, once the modem
+ *  is ready for a command. sendATCommand() and LTE_Command use this.
+ *
+ *  @param  cmd   Command, or its beginning such as "AT#SGACT".
+ *  @return bool  True on success.
+ */
+bool LTE_Base::startCommand(const char* cmd) {
+    if ((cmd == NULL) || (cmd[0] == '\0') || (bufferFull) || (onlineMode))
+        return false;
 
     #ifdef DEBUG
     debugPort->write(">> Sending AT Command: \"");
@@ -87,22 +129,446 @@ bool LTE_Base::sendATCommand(const char* cmd) {
     debugPort->write("\"\r\n");
     #endif
 
-    telitPort->write(cmd);
-    telitPort->write("\r\n");
+    while (queueCount > 0) serviceQueue();
+
+    // Dispatch unsolicited lines that arrived since the last command, so
+    // they are not mistaken for part of this command's response
+    poll();
+
+    setPendingCommand(cmd);
+    writePort(cmd);
+    return true;
+}
+
+/** Marks a command as the one whose response is being received.
+ *
+ *  @param  cmd   String containing the AT command.
+ *  @return void
+ */
+void LTE_Base::setPendingCommand(const char* cmd) {
+    // Remember the command name, e.g. "+CGATT" for "AT+CGATT?", to tell
+    // its information responses apart from unsolicited result codes
+    int n = 0;
+    bool query = false;     // "AT+CGATT?" or "AT+CGATT=?"
+    if ((cmd[0] == 'A') && (cmd[1] == 'T')) {
+        while ((n < (int) sizeof(pendingCommand) - 1) && (cmd[n + 2] != '\0') &&
+               (cmd[n + 2] != '=') && (cmd[n + 2] != '?'))
+            n++;
+        memcpy(pendingCommand, cmd + 2, n);
+        query = (cmd[n + 2] == '?') ||
+                ((cmd[n + 2] == '=') && (cmd[n + 3] == '?'));
+    }
+    pendingCommand[n] = '\0';
+    commandPending = true;
+    commandClass = LTE_Timeouts::classify(pendingCommand, query);
+    commandStart = micros();
+    commandTimed = true;
+}
+
+/** Makes receiveData() take the next final result code as the reply to
+ *  something written without startCommand(), such as the "+++" escape
+ *  sequence. Its latency is not recorded: it is set by the escape guard
+ *  time, not by the modem.
+ *
+ *  @param  name  Name of what was written, e.g. "+++".
+ *  @return void
+ */
+void LTE_Base::expectResponse(const char* name) {
+    strncpy(pendingCommand, name, sizeof(pendingCommand) - 1);
+    pendingCommand[sizeof(pendingCommand) - 1] = '\0';
+    commandPending = true;
+    commandClass = TIMEOUT_LOCAL;
+    commandStart = micros();
+    commandTimed = false;
+}
+
+/** Writes bytes to the modem's serial port. All writes go through here
+ *  (or the overload below), so they can be counted.
+ *
+ *  @param  buf         Bytes to write.
+ *  @param  len         Number of bytes.
+ *  @return size_t      Number of bytes written.
+ */
+size_t LTE_Base::writePort(const uint8_t* buf, size_t len) {
+    size_t n = 0;
+    if (ctsPin < 0) {
+        n = telitPort->write(buf, len);
+        LTE_METRIC(metrics.bytesTx += n);
+        return n;
+    }
+    while (n < len) {
+        // The modem raises CTS while it cannot take more bytes
+        uint32_t startTime = millis();
+        while (digitalRead(ctsPin) == HIGH) {
+            if ((millis() - startTime) > CTS_TIMEOUT) {
+                #ifdef DEBUG
+                debugPort->write(">> LTE_Base CTS timed out.\r\n");
+                #endif
+                LTE_METRIC(metrics.bytesTx += n);
+                return n;
+            }
+        }
+        size_t chunk = (len - n < CTS_CHUNK) ? len - n : CTS_CHUNK;
+        n += telitPort->write(buf + n, chunk);
+    }
+    LTE_METRIC(metrics.bytesTx += n);
+    return n;
+}
+
+/** Writes one byte to the modem's serial port.
+ *
+ *  @param  c           Byte to write.
+ *  @return size_t      Number of bytes written.
+ */
+size_t LTE_Base::writePort(uint8_t c) {
+    return writePort(&c, 1);
+}
+
+/** Writes a NUL terminated string to the modem's serial port.
+ *
+ *  @param  str         String to write.
+ *  @return size_t      Number of bytes written.
+ */
+size_t LTE_Base::writePort(const char* str) {
+    return writePort((const uint8_t*) str, strlen(str));
+}
+
+/** Registers a handler for an unsolicited result code (URC), i.e. a line
+ *  the modem sends on its own rather than in response to a command, such
+ *  as "SRING: 1" or "+CEREG: 1". Every received line that starts with
+ *  prefix, and is not an information response of the command in progress,
+ *  is passed to the handler and removed from the response data.
+ *
+ *  Handlers run from inside receiveData() or poll(), and must not send
+ *  AT commands themselves.
+ *
+ *  @param  prefix      Start of the URC line, e.g. "SRING: ". Must stay
+ *                      valid while registered (use a string literal).
+ *  @param  handler     Called with the line (without "\r\n"), its length
+ *                      and context.
+ *  @param  context     Passed to the handler unchanged.
+ *  @return bool        False if the handler table is full.
+ */
+bool LTE_Base::registerURC(const char* prefix, URCHandler handler,
+                           void* context) {
+    if ((prefix == NULL) || (prefix[0] == '\0') || (handler == NULL) ||
+        (numURCHandlers >= MAX_URC_HANDLERS))
+        return false;
+    urcHandlers[numURCHandlers].prefix = prefix;
+    urcHandlers[numURCHandlers].handler = handler;
+    urcHandlers[numURCHandlers].context = context;
+    numURCHandlers++;
+    return true;
+}
+
+/** Removes every handler registered for prefix.
+ *
+ *  @param  prefix  Prefix given to registerURC().
+ *  @return bool    True if a handler was removed.
+ */
+bool LTE_Base::unregisterURC(const char* prefix) {
+    bool removed = false;
+    for (int i = 0; i < numURCHandlers; ) {
+        if (strcmp(urcHandlers[i].prefix, prefix) == 0) {
+            numURCHandlers--;
+            urcHandlers[i] = urcHandlers[numURCHandlers];
+            removed = true;
+        }
+        else i++;
+    }
+    return removed;
+}
+
+/** Processes unsolicited result codes that arrived while no command was
+ *  running, and advances the queue of commands from queueCommand(). Call
+ *  this regularly (e.g. from loop()) so URC handlers and command callbacks
+ *  run. Only complete lines are consumed; it never blocks.
+ *
+ *  @return int     Number of URC lines dispatched.
+ */
+int LTE_Base::poll() {
+    if (onlineMode) return 0;   // Serial data belongs to the socket
+    pumpRx();
+    if (queueCount > 0) serviceQueue();
+    if (queueCount > 0) return 0;
+    return dispatchLines();
+}
+
+/** Dispatches the complete lines in the receive ring buffer to the URC
+ *  handlers, as long as no command is waiting for its response.
+ *
+ *  @return int     Number of URC lines dispatched.
+ */
+int LTE_Base::dispatchLines() {
+    int dispatched = 0;
+    while (!commandPending) {
+        // Find the end of the next complete line in the ring
+        uint32_t n = 0;
+        int c;
+        while (((c = rxRing.peek(n)) != -1) && (c != '\n')) n++;
+        if (c == -1) break;
+
+        // Copy it out without "\r\n", truncating overlong lines
+        uint32_t len = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            c = rxRing.get();
+            if ((c != '\r') && (len < URC_LINE_SIZE)) urcLine[len++] = c;
+        }
+        rxRing.get();   // '\n'
+        urcLine[len] = '\0';
+        if ((len > 0) && dispatchURC(urcLine, len)) dispatched++;
+    }
+    return dispatched;
+}
+
+/** Queues an AT command without waiting for its response. poll() sends it
+ *  once the commands queued before it are done, and calls callback with
+ *  the final result code when its response is complete. The response can
+ *  be read inside the callback with getLine(), findInfo() etc.
+ *
+ *  The command is copied, so it may be built in a temporary buffer, but it
+ *  must not be longer than QUEUED_CMD_SIZE. Commands that stop at the "> "
+ *  prompt (AT#SSEND) complete with RESULT_PROMPT and should be sent with
+ *  sendATCommand() instead.
+ *
+ *  @param  cmd         String containing AT command to send.
+ *  @param  callback    Called on completion, may be NULL.
+ *  @param  context     Passed to callback unchanged.
+ *  @param  timeout     Max wait (in millis) for the next response byte,
+ *                      TIMEOUT_AUTO for the command's learned deadline.
+ *  @return bool        False if the queue is full or cmd is too long.
+ */
+bool LTE_Base::queueCommand(const char* cmd, CommandCallback callback,
+                            void* context, uint32_t timeout) {
+    return enqueue(cmd, true, callback, context, NULL, timeout);
+}
+
+/** Queues an AT command like queueCommand() above, with completion
+ *  reported through future instead of a callback. future->done turns true
+ *  once poll() has received the response.
+ *
+ *  @param  cmd         String containing AT command to send.
+ *  @param  future      Completion state, must stay valid until done.
+ *  @param  timeout     Max wait (in millis) for the next response byte,
+ *                      TIMEOUT_AUTO for the command's learned deadline.
+ *  @return bool        False if the queue is full or cmd is too long.
+ */
+bool LTE_Base::queueCommand(const char* cmd, CommandFuture* future,
+                            uint32_t timeout) {
+    return enqueue(cmd, true, NULL, NULL, future, timeout);
+}
+
+/** Returns the number of queued commands that have not completed yet.
+ *
+ *  @return int
+ */
+int LTE_Base::queuedCommands() {
+    return queueCount;
+}
+
+/** Sets how many queued commands may be written to the modem before the
+ *  first of them has completed. The default of 1 sends each command after
+ *  the previous one's final result code; larger values overlap the modem's
+ *  processing time with the transfer of the next commands, for modems that
+ *  buffer command lines while busy.
+ *
+ *  @param  depth   Commands in flight, 1 to MAX_QUEUED_COMMANDS.
+ *  @return void
+ */
+void LTE_Base::setPipelineDepth(uint8_t depth) {
+    if (depth < 1) depth = 1;
+    if (depth > MAX_QUEUED_COMMANDS) depth = MAX_QUEUED_COMMANDS;
+    pipelineDepth = depth;
+}
+
+/** Appends a command to the queue and starts sending it if possible.
+ *
+ *  @param  cmd         String containing AT command to send.
+ *  @param  copy        Copy cmd into the queue. Otherwise cmd must stay
+ *                      valid until the command completes.
+ *  @param  callback    Called on completion, may be NULL.
+ *  @param  context     Passed to callback unchanged.
+ *  @param  future      Completion state, may be NULL.
+ *  @param  timeout     Max wait (in millis) for the next response byte,
+ *                      TIMEOUT_AUTO for the command's learned deadline.
+ *  @return bool        True if queued.
+ */
+bool LTE_Base::enqueue(const char* cmd, bool copy, CommandCallback callback,
+                       void* context, CommandFuture* future,
+                       uint32_t timeout) {
+    if ((cmd == NULL) || (cmd[0] == '\0') || (timeout == 0) || (onlineMode) ||
+        (queueCount >= MAX_QUEUED_COMMANDS))
+        return false;
+    if (copy && (strlen(cmd) > QUEUED_CMD_SIZE)) return false;
+
+    QueuedCommand* q = &cmdQueue[(queueHead + queueCount) % MAX_QUEUED_COMMANDS];
+    if (copy) {
+        strcpy(q->copy, cmd);
+        q->cmd = q->copy;
+    }
+    else q->cmd = cmd;
+    q->timeout = timeout;
+    q->callback = callback;
+    q->context = context;
+    q->future = future;
+    if (future != NULL) {
+        future->done = false;
+        future->result = RESULT_NONE;
+    }
+    queueCount++;
+
+    #ifdef DEBUG
+    debugPort->write(">> Queued AT Command: \"");
+    debugPort->write(cmd);
+    debugPort->write("\"\r\n");
+    #endif
 
+    serviceQueue();
     return true;
 }
 
+/** Advances the command queue without blocking: writes queued commands up
+ *  to the pipeline depth, feeds received bytes to the parser for the oldest
+ *  command, and completes it on its final result code or timeout.
+ *
+ *  @return void
+ */
+void LTE_Base::serviceQueue() {
+    if ((queueCount == 0) || (onlineMode)) return;
+
+    // Nothing in flight yet: unsolicited lines that arrived since the last
+    // command are dispatched, so they are not mistaken for its response
+    if (queueSent == 0) {
+        pumpRx();
+        dispatchLines();
+    }
+
+    while ((queueSent < queueCount) && (queueSent < pipelineDepth)) {
+        QueuedCommand* q = &cmdQueue[(queueHead + queueSent) % MAX_QUEUED_COMMANDS];
+        writePort(q->cmd);
+        writePort("\r");
+        queueSent++;
+    }
+
+    QueuedCommand* head = &cmdQueue[queueHead];
+    if (!queueStarted) {
+        // The response parser follows the oldest command in flight
+        resetParser();
+        setPendingCommand(head->cmd);
+        queueStarted = true;
+        queueActivity = millis();
+    }
+
+    pumpRx();
+    uint32_t before = rxRing.available();
+    bool done = parseRx(RECV_FINAL);
+    if (rxRing.available() != before) queueActivity = millis();
+
+    if (done) completeCommand(resultCode);
+    else if ((millis() - queueActivity) >
+             ((head->timeout == TIMEOUT_AUTO) ? getTimeout() : head->timeout)) {
+        #ifdef DEBUG
+        debugPort->write(">> LTE_Base queued command timed out.\r\n");
+        #endif
+        completeCommand(RESULT_NONE);
+    }
+}
+
+/** Removes the oldest command from the queue and reports its result. The
+ *  parser is reset for the next command only on the next serviceQueue(),
+ *  so the callback can still read the response.
+ *
+ *  @param  result  RESULT_* code of the command.
+ *  @return void
+ */
+void LTE_Base::completeCommand(uint8_t result) {
+    QueuedCommand* head = &cmdQueue[queueHead];
+    CommandCallback callback = head->callback;
+    void* context = head->context;
+    CommandFuture* future = head->future;
+
+    queueHead = (queueHead + 1) % MAX_QUEUED_COMMANDS;
+    queueCount--;
+    queueSent--;
+    queueStarted = false;
+    data[recDataSize] = '\0';
+    resultCode = result;
+    if (result == RESULT_NONE) commandFinished(RESULT_NONE);
+    commandPending = false;
+
+    #ifdef DEBUG
+    debugPort->write(">> LTE_Base --- Queued Command Response ---\r\n");
+    debugPort->write((uint8_t*) data, recDataSize);
+    debugPort->write(">> LTE_Base --- End Queued Command Response ---\r\n");
+    #endif
+
+    if (future != NULL) {
+        future->result = result;
+        future->done = true;
+    }
+    if (callback != NULL) callback(result, context);
+}
+
+/** Returns true if a line is an information response of the command in
+ *  progress, i.e. "<command name>:" as in "+CGATT: 1" for "AT+CGATT?".
+ *
+ *  @param  line    Start of the line.
+ *  @param  len     Length of the line.
+ *  @return bool
+ */
+bool LTE_Base::isSolicited(const char* line, uint32_t len) {
+    if (!commandPending) return false;
+    uint32_t n = strlen(pendingCommand);
+    return (n > 0) && (len > n) && (memcmp(line, pendingCommand, n) == 0) &&
+           (line[n] == ':');
+}
+
+/** Passes a line to the URC handlers registered for it.
+ *
+ *  @param  line    Start of the line, without "\r\n".
+ *  @param  len     Length of the line.
+ *  @return bool    True if at least one handler matched.
+ */
+bool LTE_Base::dispatchURC(const char* line, uint32_t len) {
+    bool matched = false;
+    for (int i = 0; i < numURCHandlers; i++) {
+        uint32_t n = strlen(urcHandlers[i].prefix);
+        if ((len >= n) && (memcmp(line, urcHandlers[i].prefix, n) == 0)) {
+            #ifdef DEBUG
+            debugPort->write(">> URC: ");
+            debugPort->write((uint8_t*) line, len);
+            debugPort->write("\r\n");
+            #endif
+            urcHandlers[i].handler(line, len, urcHandlers[i].context);
+            matched = true;
+        }
+    }
+    return matched;
+}
+
 /** Listens on the serial port for data from the Telit module and captures
  *  it in the data[] buffer. Returns false if no data is received before
  *  function times out.
  *
+ *  Bytes are tokenized by parseByte() as they arrive, so once this returns
+ *  the response's result code, info lines and payload span are available
+ *  through getResultCode(), findInfo() and getPayload() without searching
+ *  the buffer again.
+ *
+ *  In RECV_FINAL mode the function returns as soon as a complete final
+ *  result code line or the "> " prompt is received. The baudDelay idle gap
+ *  still ends reception if no final result arrives.
+ *
  *  @param  timeout     Max wait time (in millis) for modem to initiate
- *                      communication.
+ *                      communication. TIMEOUT_AUTO (the default) uses the
+ *                      pending command's deadline, see getTimeout().
  *  @param  baudDelay   Max wait time between bytes received.
+ *  @param  mode        RECV_FINAL or RECV_IDLE.
  *  @return bool
  */
-bool LTE_Base::receiveData(uint32_t timeout, uint32_t baudDelay) {
+bool LTE_Base::receiveData(uint32_t timeout, uint32_t baudDelay,
+                           uint8_t mode) {
+    if (timeout == TIMEOUT_AUTO) timeout = getTimeout();
     if ((timeout == 0) || (baudDelay == 0)) {
 		#ifdef DEBUG
 		debugPort->write(">> LTE_Base receiveData failed.\r\n");
@@ -112,65 +578,245 @@ bool LTE_Base::receiveData(uint32_t timeout, uint32_t baudDelay) {
 
     // Block while waiting for the start of the message
     uint32_t startTime = millis();
-    while (!telitPort->available()) {
+    while ((rxRing.available() == 0) && !telitPort->available()) {
         if ((millis() - startTime) > timeout) {
 			#ifdef DEBUG
 			debugPort->write(">> LTE_Base receiveData timed out.\r\n");
 			#endif
+            commandFinished(RESULT_NONE);
             return false;  // Timeout
         }
     }
 
-    memset(data, '\0', BASE_BUF_SIZE);
-    bufferFull = false;
-
-    uint32_t receivedSize = 0;
-    parsedData = NULL;
+    resetParser();
 
     // Receive data from serial port
-    startTime = millis();
-    bool timedOut = false;
-    while (!timedOut) {
-        if (receivedSize >= BASE_BUF_SIZE) {
-            bufferFull = true;
-			#ifdef DEBUG
-			debugPort->write(">> LTE_Base receiveData buffer full.\r\n");
-			#endif
-            break;
-        }
-
-        // Store next byte
-        // Ignore initial whitespace
-        char c = (char) telitPort->read();
-        if ((receivedSize != 0) || (c != '\0') &&
-		    (c != '\r') && (c != '\n')) {
-            data[receivedSize] = c;
-            receivedSize++;
-        }
+    bool done = false;
+    while (!done) {
+        pumpRx();
+        done = parseRx(mode);
+        if (done) break;
         startTime = millis();
         
         // Wait for more data
         while (telitPort->available() < 1) {
             if ((millis() - startTime) > baudDelay) {
-                timedOut = true;
-                bufferFull = false;
+                done = true;
                 break;
             }
         }
     }
-
-    if (receivedSize < BASE_BUF_SIZE) data[receivedSize] = '\0';
-    recDataSize = receivedSize;
+    data[recDataSize] = '\0';
+    if (resultCode == RESULT_NONE) commandFinished(RESULT_NONE);
+    if (resultCode != RESULT_PROMPT) commandPending = false;
 
     #ifdef DEBUG
     debugPort->write(">> LTE_Base --- Received Data ---\r\n");
-    debugPort->write(data);
+    debugPort->write((uint8_t*) data, recDataSize);
     debugPort->write(">> LTE_Base --- End Received Data ---\r\n");
     #endif
 
     return true;
 }
 
+/** Feeds the bytes in the receive ring buffer to the response parser,
+ *  without waiting for more.
+ *
+ *  @param  mode    RECV_FINAL to stop at a final result code or "> "
+ *                  prompt, RECV_IDLE to parse everything received.
+ *  @return bool    True if the response is complete or data[] is full.
+ */
+bool LTE_Base::parseRx(uint8_t mode) {
+    while (rxRing.available() > 0) {
+        if (payloadLeft > 0) {
+            // Hand payload over in place, straight out of the ring
+            const char* span;
+            uint32_t n = rxRing.readSpan(&span);
+            if (n > payloadLeft) n = payloadLeft;
+            handlePayload(span, n);
+            rxRing.consume(n);
+            payloadLeft -= n;
+            if (payloadLeft == 0) lineStart = recDataSize;
+        }
+        else if (recDataSize >= BASE_BUF_SIZE) {
+            bufferFull = true;
+            LTE_METRIC(metrics.bufferFull++);
+            #ifdef DEBUG
+            debugPort->write(">> LTE_Base receiveData buffer full.\r\n");
+            #endif
+            return true;
+        }
+        else if (parseByte((char) rxRing.get()) && (mode == RECV_FINAL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Moves all bytes waiting in the serial port into the receive ring buffer,
+ *  as far as it has room.
+ *
+ *  @return uint32_t    Number of bytes moved.
+ */
+uint32_t LTE_Base::pumpRx() {
+    uint32_t n = 0;
+    while ((rxRing.space() > 0) && (telitPort->available() > 0)) {
+        rxRing.put((char) telitPort->read());
+        n++;
+    }
+    LTE_METRIC(metrics.bytesRx += n);
+
+    // Ask the modem to pause while the ring is nearly full; what is still
+    // on the way fits in the rest of it and the serial driver's buffer
+    bool raise = rxRing.space() < RTS_RESERVE;
+    if ((rtsPin >= 0) && (raise != rtsRaised)) {
+        digitalWrite(rtsPin, raise ? HIGH : LOW);
+        rtsRaised = raise;
+    }
+    return n;
+}
+
+/** Resets the response parser before a new response is received. Only the
+ *  first byte of data[] is cleared; recDataSize marks the end of valid data.
+ *
+ *  @return void
+ */
+void LTE_Base::resetParser() {
+    data[0] = '\0';
+    recDataSize = 0;
+    parsedData = NULL;
+    bufferFull = false;
+    lineStart = 0;
+    lineCount = 0;
+    payloadLeft = 0;
+    payloadStart = 0;
+    payloadSize = 0;
+    resultCode = RESULT_NONE;
+}
+
+/** Stores one received byte in data[] and advances the response parser.
+ *  Lines are indexed as they complete, and final result codes and the "> "
+ *  prompt end the response. When a line announces payload (see
+ *  payloadLength()), receiveData() passes the payload bytes to
+ *  handlePayload() instead of this function, so payload is never tokenized
+ *  and may contain any byte value.
+ *
+ *  @param  c       Received byte.
+ *  @return bool    True if the byte completed the response.
+ */
+bool LTE_Base::parseByte(char c) {
+    // Ignore initial whitespace
+    if ((recDataSize == 0) &&
+        ((c == '\0') || (c == '\r') || (c == '\n')))
+        return false;
+
+    data[recDataSize] = c;
+    recDataSize++;
+
+    if (c == '\n') {
+        uint32_t start = lineStart;
+        uint32_t len = recDataSize - 1 - start;
+        lineStart = recDataSize;
+        while ((len > 0) && (data[start + len - 1] == '\r')) len--;
+        if (len == 0) return false;
+
+        // Unsolicited lines are dispatched and removed from the response
+        uint8_t result = finalResult(data + start, len);
+        if (((result == RESULT_NONE) || !commandPending) &&
+            !isSolicited(data + start, len) &&
+            dispatchURC(data + start, len)) {
+            recDataSize = start;
+            lineStart = start;
+            return false;
+        }
+
+        resultCode = result;
+        if (resultCode != RESULT_NONE) {
+            commandFinished(resultCode);
+            commandPending = false;
+            return true;
+        }
+
+        if (lineCount < MAX_RESPONSE_LINES) {
+            lineOffset[lineCount] = start;
+            lineLength[lineCount] = len;
+            lineCount++;
+        }
+        payloadLeft = payloadLength(data + start, len);
+        if (payloadLeft > 0) {
+            payloadStart = recDataSize;
+            payloadSize = payloadLeft;
+        }
+    }
+    else if ((c == ' ') && (recDataSize - lineStart == 2) &&
+             (data[lineStart] == '>')) {
+        resultCode = RESULT_PROMPT;   // Data prompt, e.g. from AT#SSEND
+        return true;
+    }
+    return false;
+}
+
+/** Classifies a response line (without its "\r\n") as one of the final
+ *  result codes, i.e. the last line the modem sends in response to a
+ *  command.
+ *
+ *  @param  line    Start of the line.
+ *  @param  len     Length of the line.
+ *  @return uint8_t RESULT_* code, RESULT_NONE if not a final result code.
+ */
+uint8_t LTE_Base::finalResult(const char* line, uint32_t len) {
+    static const char* const codes[] = {
+        "OK", "ERROR", "NO CARRIER", "BUSY", "NO ANSWER", "NO DIALTONE"
+    };
+    static const uint8_t results[] = {
+        RESULT_OK, RESULT_ERROR, RESULT_NO_CARRIER, RESULT_NO_CARRIER,
+        RESULT_NO_CARRIER, RESULT_NO_CARRIER
+    };
+    for (uint32_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+        if ((len == strlen(codes[i])) && (memcmp(line, codes[i], len) == 0))
+            return results[i];
+    }
+    // Result codes that carry a parameter
+    if ((len >= 7) && (memcmp(line, "CONNECT", 7) == 0))
+        return RESULT_CONNECT;
+    if ((len >= 11) && ((memcmp(line, "+CME ERROR:", 11) == 0) ||
+                        (memcmp(line, "+CMS ERROR:", 11) == 0)))
+        return RESULT_ERROR;
+    return RESULT_NONE;
+}
+
+/** Returns the number of raw payload bytes that follow a response line,
+ *  e.g. the data announced by "#SRECV: <connId>,<len>". The base class has
+ *  no commands with payload; subclasses override this for theirs.
+ *
+ *  @param  line    Start of the line.
+ *  @param  len     Length of the line.
+ *  @return uint32_t    Payload bytes following the line.
+ */
+uint32_t LTE_Base::payloadLength(const char* line, uint32_t len) {
+    return 0;
+}
+
+/** Receives payload bytes announced by a response line, as views into the
+ *  receive ring buffer. The base class appends them to data[], where
+ *  getPayload() finds them; subclasses override this to move payload
+ *  directly to its destination. Bytes that don't fit in data[] are dropped
+ *  and bufferFull is set.
+ *
+ *  @param  buf     Payload bytes. Only valid during the call.
+ *  @param  len     Number of bytes.
+ *  @return void
+ */
+void LTE_Base::handlePayload(const char* buf, uint32_t len) {
+    if (len > BASE_BUF_SIZE - recDataSize) {
+        len = BASE_BUF_SIZE - recDataSize;
+        bufferFull = true;
+        LTE_METRIC(metrics.bufferFull++);
+    }
+    memcpy(data + recDataSize, buf, len);
+    recDataSize += len;
+}
+
 /** Retrieves stored data we received previously. If no data exists, return
  *  empty string.
  *
@@ -189,31 +835,132 @@ char* LTE_Base::getParsedData() {
     return parsedData;
 }
 
+/** Returns the final result code of the last response: RESULT_OK,
+ *  RESULT_ERROR, RESULT_CONNECT, RESULT_NO_CARRIER, RESULT_PROMPT, or
+ *  RESULT_NONE if the response ended without one.
+ *
+ *  @return uint8_t
+ */
+uint8_t LTE_Base::getResultCode() {
+    return resultCode;
+}
+
+/** Returns the number of non-empty lines in the last response, excluding
+ *  the final result code and payload.
+ *
+ *  @return int
+ */
+int LTE_Base::getLineCount() {
+    return lineCount;
+}
+
+/** Returns a line of the last response. The line is not NUL terminated;
+ *  it ends at "\r\n" and its length is stored in len.
+ *
+ *  @param  index   Line index, 0 to getLineCount() - 1.
+ *  @param  len     Optional, receives the line length.
+ *  @return char*   Start of the line, NULL if index is out of range.
+ */
+char* LTE_Base::getLine(int index, uint32_t* len) {
+    if ((index < 0) || (index >= lineCount)) return NULL;
+    if (len != NULL) *len = lineLength[index];
+    return data + lineOffset[index];
+}
+
+/** Finds the information response line starting with prefix, for example
+ *  "+CGATT: " or "#SS: ". If key is not negative, only a line whose first
+ *  field equals key matches, which selects e.g. one socket's "#SS: " line.
+ *
+ *  @param  prefix  Line prefix, e.g. "#SS: ".
+ *  @param  key     Value of the first field to match, or -1.
+ *  @return char*   Line contents after the prefix, NULL if not found.
+ */
+char* LTE_Base::findInfo(const char* prefix, long key) {
+    if (prefix == NULL) return NULL;
+    uint32_t prefixLen = strlen(prefix);
+    for (int i = 0; i < lineCount; i++) {
+        char* line = data + lineOffset[i];
+        if ((lineLength[i] < prefixLen) ||
+            (memcmp(line, prefix, prefixLen) != 0))
+            continue;
+        if ((key < 0) || (getInfoField(line + prefixLen, 0) == key))
+            return line + prefixLen;
+    }
+    return NULL;
+}
+
+/** Parses one integer field of a comma separated information response,
+ *  as returned by findInfo(). Parsing stops at the end of the line.
+ *
+ *  @param  info    Start of the fields.
+ *  @param  field   Field index, starting at 0.
+ *  @return long    Field value, -1 if missing or not a number.
+ */
+long LTE_Base::getInfoField(const char* info, int field) {
+    if (info == NULL) return -1;
+    for (; field > 0; info++) {
+        if ((*info == '\r') || (*info == '\n') || (*info == '\0')) return -1;
+        if (*info == ',') field--;
+    }
+    if ((*info < '0') || (*info > '9')) return -1;
+    long value = 0;
+    while ((*info >= '0') && (*info <= '9')) {
+        value = (value * 10) + (*info - '0');
+        info++;
+    }
+    return value;
+}
+
+/** Returns the payload span of the last response, e.g. the socket data of
+ *  an AT#SRECV response. The payload may contain any byte value.
+ *
+ *  @param  len     Receives the number of payload bytes stored in data[].
+ *  @return char*   Start of the payload, NULL if there is none.
+ */
+char* LTE_Base::getPayload(uint32_t* len) {
+    if (payloadSize == 0) {
+        if (len != NULL) *len = 0;
+        return NULL;
+    }
+    uint32_t stored = recDataSize - payloadStart;
+    if (len != NULL) *len = (stored < payloadSize) ? stored : payloadSize;
+    return data + payloadStart;
+}
+
 /** Deletes all stored received data from the internal buffer.
  *
  *  @return void
  */
 void LTE_Base::clearData() {
-    memset(data, '\0', BASE_BUF_SIZE);
-    parsedData = NULL;
-    recDataSize = 0;
+    resetParser();
 }
 
 /** Finds first instance of substring "stringToFind" in the response data from
  *  the modem, and stores the the rest of the response data starting from
  *  AFTER "stringToFind" in the parsedData field. If no matching substring is
  *  found, empty string is stored instead. If "stringToFind" is empty string,
- *  function returns false.
+ *  function returns false. The search covers all recDataSize bytes, so NUL
+ *  bytes in received payload do not hide the data after them.
  *
  *  @param  stringToFind    String of interest.
  *  @return bool            True if substring is found.
  */
 bool LTE_Base::parseFind(const char* stringToFind) {
     if ((stringToFind == NULL) || (stringToFind[0] == '\0') ||
-        (data[0] == '\0'))
+        (recDataSize == 0))
         return false;
-	
-    char* beginning = strstr(data, stringToFind);
+
+    uint32_t len = strlen(stringToFind);
+    char* beginning = NULL;
+    char* end = data + recDataSize;
+    for (char* p = data; (end - p) >= (long) len; p++) {
+        p = (char*) memchr(p, stringToFind[0], (end - p) - len + 1);
+        if (p == NULL) break;
+        if (memcmp(p, stringToFind, len) == 0) {
+            beginning = p;
+            break;
+        }
+    }
     if (beginning == NULL) {
 		#ifdef DEBUG
 		debugPort->write(">> LTE_Base parseFind failed for string \"");
@@ -222,19 +969,28 @@ bool LTE_Base::parseFind(const char* stringToFind) {
 		#endif
 		return false;
     }
-	parsedData = beginning + strlen(stringToFind);
+	parsedData = beginning + len;
     return true;
 }
 
-/** Sends an AT Command, listens for a response, and looks for an "OK" code
- *  in the response data. If a "OK" is received, this function returns true.
+/** Sends an AT Command, listens for a response, and checks that its final
+ *  result code is "OK". If a "OK" is received, this function returns true.
+ *  The command goes through the same queue as queueCommand(), behind any
+ *  commands already queued, and this function waits until it completes.
  *
  *  @param  command     String containing AT Command.
  *  @return bool        True if OK is received.
  */
 bool LTE_Base::getCommandOK(const char* command) {
-    if (!sendATCommand(command) || !receiveData(500, 100)) return false;
-    if (parseFind("OK\r\n")) {
+    CommandFuture future;
+
+    // Wait for room in the queue, then for the command itself
+    while (queueCount >= MAX_QUEUED_COMMANDS) serviceQueue();
+    if (!enqueue(command, false, NULL, NULL, &future, TIMEOUT_AUTO))
+        return false;
+    while (!future.done) serviceQueue();
+
+    if (future.result == RESULT_OK) {
 		#ifdef DEBUG
 		debugPort->write(">> OK found for command \"");
 		debugPort->write(command);
@@ -261,30 +1017,24 @@ void LTE_Base::printRegistration() {
     debugPort->write(">> Printing registration information ...\r\n");
     #endif
 
-    if (sendATCommand("AT+CGMI") && receiveData() && parseFind("\r\nOK\r\n")) {
-        debugPort->write("Manufacturer Identification: ");
-        parseFind("\r\n");
-        debugPort->write((uint8_t*) data, recDataSize - strlen(parsedData));
-    }
-    if (sendATCommand("AT+CGMM") && receiveData() && parseFind("\r\nOK\r\n")) {
-        debugPort->write("Model Identification: ");
-        parseFind("\r\n");
-        debugPort->write((uint8_t*) data, recDataSize - strlen(parsedData));
-    }
-    if (sendATCommand("AT+CGMR") && receiveData() && parseFind("\r\nOK\r\n")) {
-        debugPort->write("Revision Identification: ");
-        parseFind("\r\n");
-        debugPort->write((uint8_t*) data, recDataSize - strlen(parsedData));
-    }
-    if (sendATCommand("AT+CGSN") && receiveData() && parseFind("\r\nOK\r\n")) {
-        debugPort->write("Product Serial Number Identification: ");
-        parseFind("\r\n");
-        debugPort->write((uint8_t*) data, recDataSize - strlen(parsedData));
-    }
-    if (sendATCommand("AT+CIMI") && receiveData() && parseFind("\r\nOK\r\n")) {
-        debugPort->write("International Mobile Subscriber Number: ");
-        parseFind("\r\n");
-        debugPort->write((uint8_t*) data, recDataSize - strlen(parsedData));
+    static const char* const commands[] = {
+        "AT+CGMI", "AT+CGMM", "AT+CGMR", "AT+CGSN", "AT+CIMI"
+    };
+    static const char* const labels[] = {
+        "Manufacturer Identification: ",
+        "Model Identification: ",
+        "Revision Identification: ",
+        "Product Serial Number Identification: ",
+        "International Mobile Subscriber Number: "
+    };
+    for (int i = 0; i < 5; i++) {
+        uint32_t len;
+        char* line;
+        if (getCommandOK(commands[i]) && ((line = getLine(0, &len)) != NULL)) {
+            debugPort->write(labels[i]);
+            debugPort->write((uint8_t*) line, len);
+            debugPort->write("\r\n");
+        }
     }
 }
 
@@ -293,7 +1043,8 @@ void LTE_Base::printRegistration() {
  *  @return bool    True if modem is connected.
  */
 bool LTE_Base::isConnected() {
-    if (getCommandOK("AT+CGATT?") && parseFind("+CGATT: 1")) {
+    if (getCommandOK("AT+CGATT?") &&
+        (getInfoField(findInfo("+CGATT: "), 0) == 1)) {
 		#ifdef DEBUG
 		debugPort->write(">> GPRS is attached.");
 		#endif
@@ -305,5 +1056,204 @@ bool LTE_Base::isConnected() {
 	return false;
 }
 
+/** Hands the UART's flow control pins to the library. RTS is driven low
+ *  (modem may send) and raised while the receive ring buffer is nearly
+ *  full; writes wait while the modem raises CTS. Call before init(),
+ *  which enables the matching AT+IFC flow control in the modem.
+ *
+ *  @param  rtsPin  LaunchPad pin wired to the modem's RTS input, -1 for
+ *                  none.
+ *  @param  ctsPin  LaunchPad pin wired to the modem's CTS output, -1 to
+ *                  ignore CTS.
+ *  @return void
+ */
+void LTE_Base::setFlowControl(int rtsPin, int ctsPin) {
+    this->rtsPin = rtsPin;
+    this->ctsPin = ctsPin;
+    rtsRaised = false;
+    if (rtsPin >= 0) {
+        pinMode(rtsPin, OUTPUT);
+        digitalWrite(rtsPin, LOW);
+    }
+    if (ctsPin >= 0) pinMode(ctsPin, INPUT);
+}
+
+/** Switches the serial link to another baud rate. The modem is told with
+ *  AT+IPR, the port follows, and the link is checked with BAUD_VERIFY "AT"
+ *  commands. If any of them fails, the modem is asked to go back over the
+ *  new rate until the link works at the old rate again.
+ *
+ *  @param  baud    One of 9600, 19200, 38400, 57600, 115200, 230400, 460800
+ *                  or 921600. Above BAUD_NO_FLOW_MAX, setFlowControl() must
+ *                  have been given an RTS pin.
+ *  @return bool    True if the link runs at baud.
+ */
+bool LTE_Base::setBaudRate(uint32_t baud) {
+    bool valid = false;
+    for (size_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
+        if (baudRates[i] == baud) valid = true;
+    if (!valid || onlineMode || ((baud > BAUD_NO_FLOW_MAX) && (rtsPin < 0)))
+        return false;
+    if (baud == baudRate) return true;
+
+    // The modem answers at the old rate, then switches
+    uint32_t oldBaud = baudRate;
+    if (!applyFlowControl() ||
+        !LTE_Command(this, "AT+IPR").arg(baud).sendOK())
+        return false;
+    switchPort(baud);
+    if (verifyLink()) return true;
+
+    #ifdef DEBUG
+    debugPort->write(">> LTE_Base baud rate failed, going back\r\n");
+    #endif
+    for (int i = 0; i < BAUD_REVERT_TRIES; i++) {
+        // The command or its OK may be garbled, so only the link tells
+        if (LTE_Command(this, "AT+IPR").arg(oldBaud).send()) {
+            commandTimed = false;
+            receiveData(BAUD_VERIFY_TIMEOUT, 20);
+        }
+        switchPort(oldBaud);
+        if (verifyLink()) return false;
+        switchPort(baud);       // Missed it, still at the new rate
+    }
+    switchPort(oldBaud);
+    return false;
+}
+
+/** Moves the serial link to the fastest baud rate up to maxBaud that
+ *  works, trying each rate from the fastest down until one passes
+ *  setBaudRate()'s check. Rates below the current one are not tried.
+ *
+ *  @param  maxBaud     Fastest rate to try.
+ *  @return uint32_t    Baud rate in use afterwards.
+ */
+uint32_t LTE_Base::negotiateBaudRate(uint32_t maxBaud) {
+    for (size_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++) {
+        if (baudRates[i] <= baudRate) break;
+        if ((baudRates[i] <= maxBaud) && setBaudRate(baudRates[i])) break;
+    }
+    return baudRate;
+}
+
+/** Returns the baud rate of the serial link.
+ *
+ *  @return uint32_t
+ */
+uint32_t LTE_Base::getBaudRate() {
+    return baudRate;
+}
+
+/** Sets the modem's AT+IFC flow control to match setFlowControl(): RTS
+ *  and CTS if their pins are known, none otherwise.
+ *
+ *  @return bool    True if the modem accepted it.
+ */
+bool LTE_Base::applyFlowControl() {
+    return LTE_Command(this, "AT+IFC").arg((rtsPin >= 0) ? 2 : 0)
+               .arg((ctsPin >= 0) ? 2 : 0).sendOK();
+}
+
+/** Checks that the serial link works at its current rate.
+ *
+ *  @return bool    True if BAUD_VERIFY "AT" commands in a row were
+ *                  answered with OK.
+ */
+bool LTE_Base::verifyLink() {
+    for (int i = 0; i < BAUD_VERIFY; i++) {
+        if (!sendATCommand("AT")) return false;
+        // A garbled link says nothing about the modem's response times
+        commandTimed = false;
+        if (!receiveData(BAUD_VERIFY_TIMEOUT, 20) ||
+            (getResultCode() != RESULT_OK))
+            return false;
+    }
+    return true;
+}
+
+/** Looks for the modem at each supported baud rate, fastest first, and
+ *  leaves the port at the one it answers at.
+ *
+ *  @return bool    False if it answered at none; the port is then back at
+ *                  the rate it had.
+ */
+bool LTE_Base::findBaudRate() {
+    uint32_t oldBaud = baudRate;
+    for (size_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++) {
+        if (baudRates[i] == oldBaud) continue;
+        switchPort(baudRates[i]);
+        if (verifyLink()) return true;
+    }
+    switchPort(oldBaud);
+    return false;
+}
+
+/** Reopens the serial port at another baud rate, dropping whatever was
+ *  received at the old one.
+ *
+ *  @param  baud    New rate.
+ *  @return void
+ */
+void LTE_Base::switchPort(uint32_t baud) {
+    telitPort->flush();
+    delay(BAUD_SETTLE_TIME);
+    telitPort->begin(baud);
+    baudRate = baud;
+    while (telitPort->available() > 0) telitPort->read();
+    rxRing.clear();
+    resetParser();
+}
+
+/** Returns the timeout policy, to read its latency estimates or change
+ *  its limits.
+ *
+ *  @return LTE_Timeouts*
+ */
+LTE_Timeouts* LTE_Base::getTimeouts() {
+    return &timeouts;
+}
+
+/** Returns the deadline of the pending command (or of the last command
+ *  sent), from the timeout policy.
+ *
+ *  @return uint32_t    Max wait (in millis) for its response.
+ */
+uint32_t LTE_Base::getTimeout() {
+    return timeouts.getTimeout(commandClass);
+}
+
+/** Records the latency and result of the pending command, once, in the
+ *  timeout policy and, with LTE_METRICS, in the metrics.
+ *
+ *  @param  result  RESULT_* code, RESULT_NONE if it timed out.
+ *  @return void
+ */
+void LTE_Base::commandFinished(uint8_t result) {
+    if (!commandPending || !commandTimed) return;
+    commandTimed = false;
+    uint32_t us = micros() - commandStart;
+    timeouts.record(commandClass, (us + 999) / 1000, result == RESULT_NONE);
+    LTE_METRIC(metrics.recordCommand(pendingCommand, us, result));
+}
+
+#ifdef LTE_METRICS
+/** Returns the metrics collected since construction or the last
+ *  getMetrics()->reset().
+ *
+ *  @return LTE_Metrics*
+ */
+LTE_Metrics* LTE_Base::getMetrics() {
+    return &metrics;
+}
+
+/** Prints the collected metrics, see LTE_Metrics::dump().
+ *
+ *  @param  out     Where to print, e.g. &Serial.
+ *  @return void
+ */
+void LTE_Base::dumpMetrics(Print* out) {
+    metrics.dump(out);
+}
 #endif
 
+#endif
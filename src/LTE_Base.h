@@ -34,6 +34,56 @@
  * function, or can be directly accessed with parseData() if you want to apply
  * your own processing.
  *
+ * Bytes from the modem are moved into a ring buffer (rxRing) and tokenized
+ * from there. Payload that a response line announces, such as AT#SRECV
+ * socket data, is not copied into data[] by subclasses that consume it:
+ * they receive it through handlePayload() as views into the ring buffer.
+ *
+ * Responses are tokenized as they arrive. After receiveData(), the final
+ * result code is available from getResultCode(), information response lines
+ * such as "+CGATT: 1" from findInfo() and getInfoField(), and raw payload
+ * (e.g. AT#SRECV socket data) from getPayload(), without searching data[]
+ * again. parseFind() still works on the whole response and is binary-safe.
+ *
+ * By default receiveData() returns as soon as the modem sends a final result
+ * code ("OK", "ERROR", "+CME ERROR: ...", "NO CARRIER", ...) or the "> "
+ * data prompt, and only falls back to waiting out the idle gap between bytes
+ * when no final result code arrives. Pass RECV_IDLE to always wait for the
+ * idle gap, for example when several commands were sent back to back.
+ *
+ * Unsolicited result codes (URCs) such as "SRING: 1" or "+CEREG: 1" can
+ * arrive at any time. Handlers registered with registerURC() receive them,
+ * whether they arrive in the middle of a command's response (they are then
+ * removed from the response data) or between commands (call poll() from
+ * loop() to process those).
+ *
+ * Commands can also be queued with queueCommand() instead of waiting for
+ * them. The queue is advanced by poll(), so a sketch that calls poll() from
+ * loop() keeps running while the modem works on a slow command such as
+ * AT#SGACT. Each queued command completes through a callback, or through a
+ * CommandFuture that loop() can check. With setPipelineDepth() above 1, the
+ * next commands are written while the modem is still answering the first
+ * one. getCommandOK() is a blocking wrapper around the same queue, and
+ * sendATCommand() waits for queued commands to finish before it sends.
+ *
+ * init() opens the serial port at BAUD_DEFAULT, or at the rate negotiated
+ * since the constructor. setFlowControl() hands the UART's RTS (and optionally CTS) pin
+ * to the library, which then enables AT+IFC hardware flow control in
+ * init(): RTS is raised while the receive ring buffer is nearly full, so
+ * the modem pauses instead of overrunning it. negotiateBaudRate() then
+ * moves the link to the fastest rate, up to 921600, that passes a check
+ * after switching; a rate that fails is given up and the link goes back
+ * to the rate before. Rates above BAUD_NO_FLOW_MAX need RTS flow control.
+ * init() finds the modem at any supported rate, e.g. after the LaunchPad
+ * was reset while the modem kept a negotiated rate.
+ *
+ * How long receiveData() and the command queue wait for a response is
+ * learned from the modem's response times to each class of command, see
+ * LTE_Timeouts.h and getTimeouts(). An explicit timeout overrides it.
+ *
+ * With LTE_METRICS defined, command latencies, errors, timeouts and byte
+ * counts are collected in an LTE_Metrics object, see getMetrics().
+ *
  * The very basic commands printRegistration() and isConnected() provided allow
  * you to verify the connection between both the EVK4 and the LaunchPad, as
  * well as with the network.
@@ -47,15 +97,76 @@
 // Uncomment this to enable debugging messages
 //#define DEBUG
 
+// Uncomment this to collect metrics, see LTE_Metrics.h
+//#define LTE_METRICS
+
 #include <Energia.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+#include "LTE_RingBuffer.h"
+#include "LTE_Timeouts.h"
+
+#ifdef LTE_METRICS
+#include "LTE_Metrics.h"
+#define LTE_METRIC(x)   x       // Statement kept only with metrics enabled
+#else
+#define LTE_METRIC(x)
+#endif
+
 #define BASE_BUF_SIZE 2000
 
+// receiveData() completion modes
+#define RECV_IDLE   0   // Return once the line is idle for baudDelay ms
+#define RECV_FINAL  1   // Also return on a final result code or "> " prompt
+
+// Final result codes of a response, see getResultCode()
+#define RESULT_NONE         0   // Response ended without a final result
+#define RESULT_OK           1
+#define RESULT_ERROR        2   // ERROR, +CME ERROR or +CMS ERROR
+#define RESULT_CONNECT      3
+#define RESULT_NO_CARRIER   4   // NO CARRIER, BUSY, NO ANSWER, NO DIALTONE
+#define RESULT_PROMPT       5   // "> " data prompt
+
+#define MAX_RESPONSE_LINES  16  // Lines indexed per response
+#define MAX_URC_HANDLERS    8
+#define URC_LINE_SIZE       128 // Longest URC line poll() keeps
+#define MAX_QUEUED_COMMANDS 4   // Commands waiting in queueCommand()
+#define QUEUED_CMD_SIZE     64  // Longest command queueCommand() copies
+
+// Serial link, see setBaudRate()
+#define BAUD_DEFAULT        115200  // Rate init() opens the port at
+#define BAUD_MAX            921600  // Fastest AT+IPR rate
+#define BAUD_NO_FLOW_MAX    115200  // Fastest rate without RTS flow control
+#define BAUD_VERIFY         3       // "AT" answered in a row to accept a rate
+#define BAUD_VERIFY_TIMEOUT 200     // Max wait (ms) for each of them
+#define BAUD_REVERT_TRIES   3       // Attempts to take back a failed rate
+#define BAUD_SETTLE_TIME    20      // Pause (ms) around a rate switch
+#define RTS_RESERVE         128     // Free ring bytes below which RTS rises
+#define CTS_TIMEOUT         1000    // Max wait (ms) for CTS before a write
+#define CTS_CHUNK           16      // Bytes written per CTS check
+
+// AT#BND bit mask of LTE band n (1-32). A constant when n is one.
+#define LTE_BAND_MASK(n)    (1UL << ((n) - 1))
+
+// Called with an unsolicited line (without "\r\n") and its length
+typedef void (*URCHandler)(const char* line, uint32_t len, void* context);
+
+// Called when a queued command completes, with its RESULT_* code
+// (RESULT_NONE on timeout). The response is still in data[].
+typedef void (*CommandCallback)(uint8_t result, void* context);
+
+// Completion state of a queued command, owned by the caller
+struct CommandFuture {
+    volatile bool done;     // Set once the command completed
+    uint8_t result;         // RESULT_* code, RESULT_NONE on timeout
+};
+
 
 class LTE_Base {
+    friend class LTE_Command;   // Writes commands field by field
+
 public:
     // Basic setup
     LTE_Base(HardwareSerial* telitPort, HardwareSerial* debugPort = NULL);
@@ -68,8 +179,32 @@ public:
     virtual char* getParsedData();
     virtual void clearData();
     virtual bool sendATCommand(const char*);
-    virtual bool receiveData(uint32_t timeout = 2000,
-                             uint32_t baudDelay = 60);
+    virtual bool receiveData(uint32_t timeout = TIMEOUT_AUTO,
+                             uint32_t baudDelay = 60,
+                             uint8_t mode = RECV_FINAL);
+
+    // Parsed response
+    virtual uint8_t getResultCode();
+    virtual int getLineCount();
+    virtual char* getLine(int index, uint32_t* len = NULL);
+    virtual char* findInfo(const char* prefix, long key = -1);
+    virtual long getInfoField(const char* info, int field);
+    virtual char* getPayload(uint32_t* len);
+
+    // Unsolicited result codes
+    virtual bool registerURC(const char* prefix, URCHandler handler,
+                             void* context = NULL);
+    virtual bool unregisterURC(const char* prefix);
+    virtual int poll();
+
+    // Non-blocking commands
+    virtual bool queueCommand(const char* cmd, CommandCallback callback = NULL,
+                              void* context = NULL,
+                              uint32_t timeout = TIMEOUT_AUTO);
+    virtual bool queueCommand(const char* cmd, CommandFuture* future,
+                              uint32_t timeout = TIMEOUT_AUTO);
+    virtual int queuedCommands();
+    virtual void setPipelineDepth(uint8_t depth);
 
     // More abstracted functions
     virtual bool parseFind(const char*);    // Search for substring in data
@@ -79,13 +214,114 @@ public:
     virtual void printRegistration();   // Prints serial numbers
     virtual bool isConnected();         // Connection status
 
+    // Serial link
+    virtual void setFlowControl(int rtsPin, int ctsPin = -1);
+    virtual bool setBaudRate(uint32_t baud);
+    virtual uint32_t negotiateBaudRate(uint32_t maxBaud = BAUD_MAX);
+    virtual uint32_t getBaudRate();
+
+    // Response deadlines
+    virtual LTE_Timeouts* getTimeouts();
+    virtual uint32_t getTimeout();
+
+    #ifdef LTE_METRICS
+    // Instrumentation
+    virtual LTE_Metrics* getMetrics();
+    virtual void dumpMetrics(Print* out);
+    #endif
+
 protected:
+    // Response parser
+    virtual uint32_t pumpRx();
+    virtual void resetParser();
+    virtual bool parseByte(char c);
+    virtual uint8_t finalResult(const char* line, uint32_t len);
+    virtual uint32_t payloadLength(const char* line, uint32_t len);
+    virtual void handlePayload(const char* buf, uint32_t len);
+    virtual bool isSolicited(const char* line, uint32_t len);
+    virtual bool dispatchURC(const char* line, uint32_t len);
+    virtual bool parseRx(uint8_t mode);
+    virtual size_t writePort(const uint8_t* buf, size_t len);
+    virtual size_t writePort(const char* str);
+    virtual size_t writePort(uint8_t c);
+    virtual void commandFinished(uint8_t result);
+
+    // Serial link
+    virtual bool applyFlowControl();
+    virtual bool verifyLink();
+    virtual bool findBaudRate();
+    virtual void switchPort(uint32_t baud);
+
+    // Command queue
+    virtual bool startCommand(const char* cmd);
+    virtual void setPendingCommand(const char* cmd);
+    virtual void expectResponse(const char* name);
+    virtual int dispatchLines();
+    virtual bool enqueue(const char* cmd, bool copy, CommandCallback callback,
+                         void* context, CommandFuture* future,
+                         uint32_t timeout);
+    virtual void serviceQueue();
+    virtual void completeCommand(uint8_t result);
+
     HardwareSerial* telitPort;  // Telit serial interface
     HardwareSerial* debugPort;  // Pointer so it can default to null
-    char data[BASE_BUF_SIZE];   // Response data from Telit
+    LTE_RingBuffer rxRing;      // Bytes received but not yet parsed
+    char data[BASE_BUF_SIZE + 1];   // Response data from Telit
     uint32_t recDataSize;       // Size of response data from Telit
     char* parsedData;           // Parsed response data
     bool bufferFull;            // Internal data[] buffer full
+    uint32_t baudRate;          // Rate of the serial link
+    int rtsPin;                 // UART RTS, -1 without flow control
+    int ctsPin;                 // UART CTS, -1 if not watched
+    bool rtsRaised;             // RTS asks the modem to pause
+
+    // Response parser state
+    uint32_t lineStart;         // Offset of the line being received
+    int lineCount;              // Number of indexed lines
+    uint16_t lineOffset[MAX_RESPONSE_LINES];
+    uint16_t lineLength[MAX_RESPONSE_LINES];
+    uint32_t payloadLeft;       // Payload bytes still to be received
+    uint32_t payloadStart;      // Offset of the payload in data[]
+    uint32_t payloadSize;       // Announced payload size
+    uint8_t resultCode;         // RESULT_* of the response
+
+    // Unsolicited result codes
+    struct URCEntry {
+        const char* prefix;
+        URCHandler handler;
+        void* context;
+    };
+    URCEntry urcHandlers[MAX_URC_HANDLERS];
+    int numURCHandlers;
+    bool commandPending;        // Sent a command, no final result yet
+    char pendingCommand[16];    // Name of that command, e.g. "#SGACT"
+    uint8_t commandClass;       // Its TIMEOUT_* class
+    uint32_t commandStart;      // micros() when it started
+    bool commandTimed;          // Its latency is not recorded yet
+    LTE_Timeouts timeouts;
+    char urcLine[URC_LINE_SIZE + 1];    // Line being dispatched by poll()
+    bool onlineMode;            // Serial port carries socket data, not AT
+
+    // Command queue
+    struct QueuedCommand {
+        const char* cmd;        // Points to copy, or to the caller's string
+        char copy[QUEUED_CMD_SIZE + 1];
+        uint32_t timeout;       // Max silence (millis) before giving up
+        CommandCallback callback;
+        void* context;
+        CommandFuture* future;
+    };
+    QueuedCommand cmdQueue[MAX_QUEUED_COMMANDS];
+    uint8_t queueHead;          // Oldest queued command
+    uint8_t queueCount;         // Commands queued, including those sent
+    uint8_t queueSent;          // Commands at the head already written
+    uint8_t pipelineDepth;      // Max commands written ahead of responses
+    bool queueStarted;          // Parser is collecting the head's response
+    uint32_t queueActivity;     // millis() of the head's last progress
+
+    #ifdef LTE_METRICS
+    LTE_Metrics metrics;
+    #endif
 };
 
 #endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * An LTE_Command writes an AT command with parameters straight to the
+ * modem's serial port, field by field, instead of formatting it with
+ * sprintf() into a scratch buffer first. The command name is written when
+ * the object is created, and each arg() call adds one parameter:
+ *
+ *     LTE_Command(this, "AT#SGACT").arg(cid).arg(1).send();
+ *
+ * writes "AT#SGACT=3,1\r". Integer parameters of any type are written by a
+ * template, so no format string is parsed at run time; strings are
+ * written as they are, or in double quotes with quoted(). send() ends the
+ * command line, and sendOK() also waits for an "OK" like getCommandOK().
+ *
+ * Creating an LTE_Command has the same effect as sendATCommand() on the
+ * command queue and URC handling. Nothing else may be written to the
+ * modem until the command is sent.
+ */
+
+
+#ifndef LTE_LTE_COMMAND_H_
+#define LTE_LTE_COMMAND_H_
+
+#include "LTE_Base.h"
+
+
+class LTE_Command {
+public:
+    LTE_Command(LTE_Base* base, const char* name) : base(base), fields(0) {
+        started = base->startCommand(name);
+    };
+
+    // Integer parameter, written in decimal
+    template <typename T>
+    LTE_Command& arg(T value) {
+        if (!started) return *this;
+        separator();
+        if (value < 0) {
+            base->writePort((uint8_t) '-');
+            digits(0UL - (unsigned long) value);
+        }
+        else digits((unsigned long) value);
+        return *this;
+    };
+
+    // String parameter, written unchanged
+    LTE_Command& arg(const char* value) {
+        if (!started) return *this;
+        separator();
+        base->writePort(value);
+        return *this;
+    };
+    LTE_Command& arg(char* value) { return arg((const char*) value); };
+
+    // String parameter in double quotes
+    LTE_Command& quoted(const char* value) {
+        if (!started) return *this;
+        separator();
+        base->writePort((uint8_t) '"');
+        base->writePort(value);
+        base->writePort((uint8_t) '"');
+        return *this;
+    };
+
+    // Read command, e.g. "AT+CGATT?"
+    LTE_Command& query() {
+        if (started) base->writePort((uint8_t) '?');
+        return *this;
+    };
+
+    // Ends the command line. The response is read with receiveData().
+    bool send() {
+        if (!started) return false;
+        base->writePort((uint8_t) '\r');
+        started = false;
+        return true;
+    };
+
+    // Ends the command line and checks for an "OK" final result code
+    bool sendOK(uint32_t timeout = TIMEOUT_AUTO) {
+        return send() && base->receiveData(timeout, 100) &&
+               (base->getResultCode() == RESULT_OK);
+    };
+
+private:
+    void separator() {
+        base->writePort((uint8_t) ((fields == 0) ? '=' : ','));
+        fields++;
+    };
+    void digits(unsigned long n) {
+        char buf[3 * sizeof(unsigned long)];    // Enough for any value
+        int i = sizeof(buf);
+        do {
+            buf[--i] = '0' + (n % 10);
+            n /= 10;
+        } while (n > 0);
+        base->writePort((const uint8_t*) buf + i, sizeof(buf) - i);
+    };
+
+    LTE_Base* base;
+    bool started;       // Name written, command line not yet ended
+    int fields;         // Parameters written so far
+};
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_HTTP_
+#define LTE_LTE_HTTP_
+
+#include "LTE_HTTP.h"
+
+
+/** Returns true if a header line starts with the given name and a colon,
+ *  ignoring case.
+ *
+ *  @param  line    Header line, NUL terminated.
+ *  @param  name    Header name in lower case, e.g. "content-length".
+ *  @return bool
+ */
+static bool headerIs(const char* line, const char* name) {
+    while (*name != '\0') {
+        char c = *line++;
+        if ((c >= 'A') && (c <= 'Z')) c += 'a' - 'A';
+        if (c != *name++) return false;
+    }
+    return *line == ':';
+}
+
+/** Returns true if a header value contains the given token, ignoring case.
+ *
+ *  @param  value   Header value, NUL terminated.
+ *  @param  token   Token in lower case, e.g. "chunked".
+ *  @return bool
+ */
+static bool valueHas(const char* value, const char* token) {
+    for (; *value != '\0'; value++) {
+        const char* v = value;
+        const char* t = token;
+        while (*t != '\0') {
+            char c = *v++;
+            if ((c >= 'A') && (c <= 'Z')) c += 'a' - 'A';
+            if (c != *t) break;
+            t++;
+        }
+        if (*t == '\0') return true;
+    }
+    return false;
+}
+
+
+/** HTTP client constructor.
+ *
+ *  @param  tcp         LTE_TCP object the socket belongs to.
+ *  @param  conn_id     Connection ID (1-6) of the socket to use, or
+ *                      SSL_CONN_ID for HTTPS.
+ */
+LTE_HTTP::LTE_HTTP(LTE_TCP* tcp, int conn_id)
+              : tcp(tcp), connId(conn_id), headRequest(false),
+                requestKeepAlive(true), timeout(HTTP_TIMEOUT),
+                bodyHandler(NULL), bodyContext(NULL),
+                headerHandler(NULL), headerContext(NULL),
+                state(HTTP_IDLE), lineLen(0), status(-1), contentLength(-1),
+                chunked(false), keepAlive(false), remaining(0), bodyLength(0) {
+}
+
+/** Sets the function the response body is passed to, in the pieces it is
+ *  received in. Without one the body is read and discarded.
+ *
+ *  @param  handler     Called with each piece of the body.
+ *  @param  context     Passed to handler unchanged.
+ *  @return void
+ */
+void LTE_HTTP::onBody(HTTPBodyHandler handler, void* context) {
+    bodyHandler = handler;
+    bodyContext = context;
+}
+
+/** Sets a function called with each response header. Headers longer than
+ *  HTTP_LINE_SIZE are cut off.
+ *
+ *  @param  handler     Called with the header name and value.
+ *  @param  context     Passed to handler unchanged.
+ *  @return void
+ */
+void LTE_HTTP::onHeader(HTTPHeaderHandler handler, void* context) {
+    headerHandler = handler;
+    headerContext = context;
+}
+
+/** Sets whether requests ask the server to keep the connection open.
+ *  Default is true.
+ *
+ *  @param  keepAlive   False to send "Connection: close".
+ *  @return void
+ */
+void LTE_HTTP::setKeepAlive(bool keepAlive) {
+    requestKeepAlive = keepAlive;
+}
+
+/** Sets how long a request waits for more of the response before failing.
+ *
+ *  @param  ms      Timeout in ms. Default is HTTP_TIMEOUT.
+ *  @return void
+ */
+void LTE_HTTP::setTimeout(uint32_t ms) {
+    timeout = ms;
+}
+
+/** Sends a GET request and reads the response.
+ *
+ *  @param  host        Server IP or host name.
+ *  @param  path        Absolute path, e.g. "/index.html".
+ *  @param  port        Server port. Default is 80.
+ *  @param  headers     Extra request headers, each ending in "\r\n", or NULL.
+ *  @return int         HTTP status code, -1 on failure.
+ */
+int LTE_HTTP::get(char* host, const char* path, int port,
+                  const char* headers) {
+    return request("GET", host, path, port, headers, NULL, NULL, 0);
+}
+
+/** Sends a POST request and reads the response.
+ *
+ *  @param  host        Server IP or host name.
+ *  @param  path        Absolute path.
+ *  @param  contentType Content-Type of the body, or NULL.
+ *  @param  body        Request body.
+ *  @param  len         Number of body bytes.
+ *  @param  port        Server port. Default is 80.
+ *  @param  headers     Extra request headers, each ending in "\r\n", or NULL.
+ *  @return int         HTTP status code, -1 on failure.
+ */
+int LTE_HTTP::post(char* host, const char* path, const char* contentType,
+                   const uint8_t* body, size_t len, int port,
+                   const char* headers) {
+    return request("POST", host, path, port, headers, contentType, body, len);
+}
+
+/** Sends a request and reads the response. The request goes out in as few
+ *  AT#SSENDEXT commands as the socket's packet size allows, and the
+ *  response body is passed to the onBody() handler as it arrives. Returns
+ *  when the last byte of the response has been received.
+ *
+ *  @param  method      Request method, e.g. "PUT".
+ *  @param  host        Server IP or host name.
+ *  @param  path        Absolute path.
+ *  @param  port        Server port.
+ *  @param  headers     Extra request headers, each ending in "\r\n", or NULL.
+ *  @param  contentType Content-Type of the body, or NULL.
+ *  @param  body        Request body, or NULL for none.
+ *  @param  len         Number of body bytes.
+ *  @return int         HTTP status code, -1 on failure.
+ */
+int LTE_HTTP::request(const char* method, char* host, const char* path,
+                      int port, const char* headers, const char* contentType,
+                      const uint8_t* body, size_t len) {
+    status = -1;
+    if ((method == NULL) || (host == NULL) || (path == NULL)) return -1;
+    if (!connect(host, port)) return -1;
+
+    bool sent = writeString(method) && writeString(" ") &&
+                writeString(path) && writeString(" HTTP/1.1\r\nHost: ") &&
+                writeString(host);
+    if (sent && (port != ((connId == SSL_CONN_ID) ? 443 : 80)))
+        sent = writeString(":") && writeNumber(port);
+    sent = sent && writeString(requestKeepAlive ?
+                               "\r\nConnection: keep-alive\r\n" :
+                               "\r\nConnection: close\r\n");
+    if (sent && (contentType != NULL))
+        sent = writeString("Content-Type: ") && writeString(contentType) &&
+               writeString("\r\n");
+    if (sent && (body != NULL))
+        sent = writeString("Content-Length: ") && writeNumber(len) &&
+               writeString("\r\n");
+    if (sent && (headers != NULL))
+        sent = writeString(headers);
+    sent = sent && writeString("\r\n");
+    if (sent && (body != NULL) && (len > 0))
+        sent = tcp->socketBufferWrite(connId, body, len) == (int) len;
+    if (!sent || !tcp->socketFlush(connId)) {
+        close();
+        return -1;
+    }
+
+    headRequest = (strcmp(method, "HEAD") == 0);
+    state = HTTP_STATUS;
+    lineLen = 0;
+    contentLength = -1;
+    chunked = false;
+    keepAlive = false;
+    remaining = 0;
+    bodyLength = 0;
+    if (!receiveResponse()) {
+        state = HTTP_IDLE;
+        close();
+        return -1;
+    }
+    state = HTTP_IDLE;
+    if (!keepAlive) close();
+    return status;
+}
+
+/** Closes the connection to the server.
+ *
+ *  @return void
+ */
+void LTE_HTTP::close() {
+    keepAlive = false;
+    if (tcp->socketReady(connId)) tcp->socketClose(connId);
+}
+
+/** Makes sure the socket is connected to host:port, keeping the connection
+ *  of the last response if it was kept alive.
+ *
+ *  @param  host    Server IP or host name.
+ *  @param  port    Server port.
+ *  @return bool    True if connected.
+ */
+bool LTE_HTTP::connect(char* host, int port) {
+    tcp->poll();    // A NO CARRIER URC means the server closed the socket
+    if (keepAlive && tcp->socketReady(connId) &&
+        (tcp->getRemotePort(connId) == port) &&
+        (strcmp(tcp->getRemoteHost(connId), host) == 0))
+        return true;
+    close();
+    return tcp->socketOpen(host, port, connId);
+}
+
+/** Adds a string to the request in the socket's packet buffer.
+ *
+ *  @param  str     String to write.
+ *  @return bool    True on success.
+ */
+bool LTE_HTTP::writeString(const char* str) {
+    int len = strlen(str);
+    return tcp->socketBufferWrite(connId, (const uint8_t*) str, len) == len;
+}
+
+/** Adds a number in decimal to the request in the socket's packet buffer.
+ *
+ *  @param  n       Number to write.
+ *  @return bool    True on success.
+ */
+bool LTE_HTTP::writeNumber(unsigned long n) {
+    char buf[3 * sizeof(unsigned long) + 1];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    return writeString(buf + i);
+}
+
+/** Reads the response until it is complete. Data is read as soon as the
+ *  modem reports it, and each piece is parsed before the next is read.
+ *
+ *  @return bool    True if a complete response was received.
+ */
+bool LTE_HTTP::receiveResponse() {
+    uint32_t lastData = millis();
+    while (state != HTTP_DONE) {
+        // -1 means no SRING, so the modem has to be asked with AT#SRECV
+        if (tcp->socketAvailable(connId) != 0) {
+            int n = tcp->socketReceive(connId, onData, this);
+            if (n > 0) {
+                lastData = millis();
+                continue;
+            }
+        }
+        if (!tcp->socketReady(connId)) {
+            // Server closed the connection: the end of a body without a
+            // length, an error anywhere else
+            if (state == HTTP_BODY_TO_CLOSE) state = HTTP_DONE;
+            break;
+        }
+        if ((millis() - lastData) > timeout) break;
+    }
+    return state == HTTP_DONE;
+}
+
+/** Socket data handler passed to LTE_TCP::socketReceive().
+ *
+ *  @param  buf         Received data.
+ *  @param  len         Number of bytes.
+ *  @param  context     The LTE_HTTP object.
+ *  @return void
+ */
+void LTE_HTTP::onData(const char* buf, uint32_t len, void* context) {
+    ((LTE_HTTP*) context)->parse(buf, len);
+}
+
+/** Parses the next piece of the response. Lines are collected in line[]
+ *  and body data is passed to the body handler as it is.
+ *
+ *  @param  buf     Response data.
+ *  @param  len     Number of bytes.
+ *  @return void
+ */
+void LTE_HTTP::parse(const char* buf, uint32_t len) {
+    uint32_t i = 0;
+    while (i < len) {
+        switch (state) {
+        case HTTP_BODY:
+        case HTTP_CHUNK_DATA:
+        case HTTP_BODY_TO_CLOSE: {
+            uint32_t n = len - i;
+            if ((state != HTTP_BODY_TO_CLOSE) && (n > remaining))
+                n = remaining;
+            if (bodyHandler != NULL) bodyHandler(buf + i, n, bodyContext);
+            bodyLength += n;
+            i += n;
+            if (state == HTTP_BODY_TO_CLOSE) break;
+            remaining -= n;
+            if (remaining == 0)
+                state = (state == HTTP_BODY) ? HTTP_DONE : HTTP_CHUNK_END;
+            break;
+        }
+        case HTTP_IDLE:
+        case HTTP_DONE:
+            return;     // Nothing more belongs to this response
+        default: {
+            char c = buf[i++];
+            if (c == '\n') {
+                while ((lineLen > 0) && (line[lineLen - 1] == '\r')) lineLen--;
+                line[lineLen] = '\0';
+                parseLine();
+                lineLen = 0;
+            }
+            else if (lineLen < HTTP_LINE_SIZE) line[lineLen++] = c;
+            break;
+        }
+        }
+    }
+}
+
+/** Handles a complete line of the status line, headers, chunk sizes or
+ *  trailers.
+ *
+ *  @return void
+ */
+void LTE_HTTP::parseLine() {
+    switch (state) {
+    case HTTP_STATUS:
+        // "HTTP/1.1 200 OK"; HTTP/1.1 keeps the connection by default
+        if ((strncmp(line, "HTTP/", 5) != 0) || (strchr(line, ' ') == NULL)) {
+            if (lineLen == 0) return;   // Blank line before the status line
+            state = HTTP_DONE;
+            status = -1;
+            return;
+        }
+        status = atoi(strchr(line, ' ') + 1);
+        keepAlive = requestKeepAlive && (strncmp(line, "HTTP/1.0", 8) != 0);
+        state = HTTP_HEADERS;
+        break;
+    case HTTP_HEADERS:
+        if (lineLen == 0) headersDone();
+        else parseHeader();
+        break;
+    case HTTP_CHUNK_SIZE:
+        // Hex size, optionally followed by ";extensions"
+        if (lineLen == 0) return;
+        remaining = strtoul(line, NULL, 16);
+        state = (remaining == 0) ? HTTP_TRAILERS : HTTP_CHUNK_DATA;
+        break;
+    case HTTP_CHUNK_END:
+        state = HTTP_CHUNK_SIZE;
+        break;
+    case HTTP_TRAILERS:
+        if (lineLen == 0) state = HTTP_DONE;
+        break;
+    default:
+        break;
+    }
+}
+
+/** Handles a header line: the headers that decide where the body ends and
+ *  whether the connection stays open, and the onHeader() handler.
+ *
+ *  @return void
+ */
+void LTE_HTTP::parseHeader() {
+    char* colon = strchr(line, ':');
+    if (colon == NULL) return;
+    char* value = colon + 1;
+    while ((*value == ' ') || (*value == '\t')) value++;
+
+    if (headerIs(line, "content-length"))
+        contentLength = strtol(value, NULL, 10);
+    else if (headerIs(line, "transfer-encoding"))
+        chunked = valueHas(value, "chunked");
+    else if (headerIs(line, "connection")) {
+        if (valueHas(value, "close")) keepAlive = false;
+        else if (valueHas(value, "keep-alive"))
+            keepAlive = requestKeepAlive;
+    }
+
+    if (headerHandler != NULL) {
+        *colon = '\0';
+        headerHandler(line, value, headerContext);
+    }
+}
+
+/** Decides how the body is read after the blank line ending the headers.
+ *
+ *  @return void
+ */
+void LTE_HTTP::headersDone() {
+    if ((status >= 100) && (status < 200)) {
+        // Interim response, e.g. 100 Continue: the real one follows
+        state = HTTP_STATUS;
+        contentLength = -1;
+        chunked = false;
+        return;
+    }
+    if (headRequest || (status == 204) || (status == 304))
+        state = HTTP_DONE;
+    else if (chunked)
+        state = HTTP_CHUNK_SIZE;
+    else if (contentLength >= 0) {
+        remaining = contentLength;
+        state = (remaining == 0) ? HTTP_DONE : HTTP_BODY;
+    }
+    else {
+        keepAlive = false;  // Only the server closing ends the body
+        state = HTTP_BODY_TO_CLOSE;
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_HTTP class is an HTTP/1.1 client on top of one LTE_TCP socket.
+ * get() and post() write the request through LTE_TCP's packet buffer and
+ * parse the response as it arrives: the status line and headers are read
+ * one line at a time, and the body is passed to the handler set with
+ * onBody() in the chunks the modem delivers, without being stored. For
+ * example:
+ *
+ *     LTE_HTTP http(&lte);
+ *     http.onBody(printBody);
+ *     int status = http.get("www.energia.nu", "/hello");
+ *
+ * The end of the response is found from Content-Length or the chunked
+ * transfer coding, so get() returns as soon as the last body byte has
+ * been received. Only a response with neither ends when the server closes
+ * the connection.
+ *
+ * Connections are kept alive by default: the socket stays open after a
+ * response that allows it, and the next request to the same host and port
+ * is sent on it without opening a new one. setKeepAlive(false) asks the
+ * server to close the connection after each response instead.
+ */
+
+
+#ifndef LTE_LTE_HTTP_H_
+#define LTE_LTE_HTTP_H_
+
+#include "LTE_TCP.h"
+
+#define HTTP_LINE_SIZE      128     // Longest status/header line kept
+#define HTTP_TIMEOUT        10000   // Max wait (ms) for more response data
+
+// Called with each piece of the response body
+typedef void (*HTTPBodyHandler)(const char* buf, uint32_t len, void* context);
+
+// Called with each response header, name and value NUL terminated
+typedef void (*HTTPHeaderHandler)(const char* name, const char* value,
+                                  void* context);
+
+
+class LTE_HTTP {
+public:
+    LTE_HTTP(LTE_TCP* tcp, int conn_id = DEFAULT_CONN_ID);
+
+    void onBody(HTTPBodyHandler handler, void* context = NULL);
+    void onHeader(HTTPHeaderHandler handler, void* context = NULL);
+    void setKeepAlive(bool keepAlive);
+    void setTimeout(uint32_t ms);
+
+    // Requests, returning the HTTP status code or -1
+    int get(char* host, const char* path, int port = 80,
+            const char* headers = NULL);
+    int post(char* host, const char* path, const char* contentType,
+             const uint8_t* body, size_t len, int port = 80,
+             const char* headers = NULL);
+    int request(const char* method, char* host, const char* path, int port,
+                const char* headers, const char* contentType,
+                const uint8_t* body, size_t len);
+    void close();
+
+    // Last response
+    int getStatus() { return status; };
+    long getContentLength() { return contentLength; };
+    uint32_t getBodyLength() { return bodyLength; };
+    bool isKeepAlive() { return keepAlive; };
+
+private:
+    enum State {
+        HTTP_IDLE,              // No response expected
+        HTTP_STATUS,            // Reading the status line
+        HTTP_HEADERS,           // Reading header lines
+        HTTP_BODY,              // Reading Content-Length bytes
+        HTTP_BODY_TO_CLOSE,     // Reading until the server closes
+        HTTP_CHUNK_SIZE,        // Reading a chunk size line
+        HTTP_CHUNK_DATA,        // Reading chunk data
+        HTTP_CHUNK_END,         // Reading the CRLF after chunk data
+        HTTP_TRAILERS,          // Reading trailer lines after the last chunk
+        HTTP_DONE               // Response complete
+    };
+
+    static void onData(const char* buf, uint32_t len, void* context);
+    void parse(const char* buf, uint32_t len);
+    void parseLine();
+    void parseHeader();
+    void headersDone();
+    bool connect(char* host, int port);
+    bool writeString(const char* str);
+    bool writeNumber(unsigned long n);
+    bool receiveResponse();
+
+    LTE_TCP* tcp;
+    int connId;                 // Connection ID of the socket used
+    bool headRequest;           // Response has no body
+    bool requestKeepAlive;      // Ask the server to keep the connection
+    uint32_t timeout;
+
+    HTTPBodyHandler bodyHandler;
+    void* bodyContext;
+    HTTPHeaderHandler headerHandler;
+    void* headerContext;
+
+    // Response parser
+    State state;
+    char line[HTTP_LINE_SIZE + 1];  // Status, header or chunk size line
+    uint32_t lineLen;
+    int status;                 // Status code of the last response
+    long contentLength;         // -1 if not given
+    bool chunked;               // Transfer-Encoding: chunked
+    bool keepAlive;             // Connection stays open after the response
+    uint32_t remaining;         // Body or chunk bytes still to come
+    uint32_t bodyLength;        // Body bytes passed to bodyHandler
+};
+
+#endif
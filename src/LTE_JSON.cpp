@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_JSON_
+#define LTE_LTE_JSON_
+
+#include "LTE_JSON.h"
+
+
+/** JSON tokenizer constructor. No paths are registered.
+ */
+LTE_JSON::LTE_JSON() : handler(NULL), handlerContext(NULL), numPaths(0) {
+    reset();
+}
+
+/** Starts a new document. Registered paths are kept, but forget their
+ *  values.
+ *
+ *  @return void
+ */
+void LTE_JSON::reset() {
+    input = NULL;
+    inputLen = 0;
+    expect = EXPECT_VALUE;
+    lex = LEX_NONE;
+    stringIsKey = false;
+    depth = 0;
+    path[0] = '\0';
+    pathLen = 0;
+    pathOverflow = 0;
+    value[0] = '\0';
+    valueLen = 0;
+    truncated = false;
+    for (int i = 0; i < numPaths; i++) {
+        paths[i].type = JSON_NONE;
+        paths[i].value[0] = '\0';
+    }
+}
+
+/** Sets the next piece of the document for next() to read. The buffer
+ *  must stay valid until next() returns JSON_NONE.
+ *
+ *  @param  buf     Document data.
+ *  @param  len     Number of bytes.
+ *  @return void
+ */
+void LTE_JSON::setInput(const char* buf, uint32_t len) {
+    input = buf;
+    inputLen = (buf == NULL) ? 0 : len;
+}
+
+/** Reads the input up to the end of the next token.
+ *
+ *  @return uint8_t     JSON_* token, JSON_NONE when the input is used up.
+ */
+uint8_t LTE_JSON::next() {
+    if (expect == EXPECT_ERROR) return JSON_ERROR;
+    while (inputLen > 0) {
+        char c = *input;
+        if (lex == LEX_NUMBER) {
+            // A number ends at the first byte that is not part of it,
+            // which is left for the next token
+            if (((c >= '0') && (c <= '9')) || (c == '.') || (c == '-') ||
+                (c == '+') || (c == 'e') || (c == 'E')) {
+                addChar(c);
+                input++;
+                inputLen--;
+                continue;
+            }
+            lex = LEX_NONE;
+            valueDone();
+            return JSON_NUMBER;
+        }
+        input++;
+        inputLen--;
+        uint8_t token = (lex == LEX_NONE) ? structural(c) : lexByte(c);
+        if (token != JSON_NONE) return token;
+    }
+    return JSON_NONE;
+}
+
+/** Returns the path of the last token, e.g. "weather[0].description".
+ *  Keys are joined with '.', and array elements have their index in
+ *  brackets. The top-level value has the path "".
+ *
+ *  @return const char*     NULL if the path is longer than JSON_PATH_SIZE.
+ */
+const char* LTE_JSON::getPath() {
+    return (pathOverflow > 0) ? NULL : path;
+}
+
+/** Returns true if the last token is at the given path.
+ *
+ *  @param  path    Path, e.g. "main.temp".
+ *  @return bool
+ */
+bool LTE_JSON::pathIs(const char* path) {
+    return (pathOverflow == 0) && (strcmp(this->path, path) == 0);
+}
+
+/** Returns true once the top-level object or array has been read.
+ *
+ *  @return bool
+ */
+bool LTE_JSON::isDone() {
+    return expect == EXPECT_DONE;
+}
+
+/** Reads a piece of the document: calls the handler set with setHandler()
+ *  with each token and stores the values of registered paths.
+ *
+ *  @param  buf     Document data.
+ *  @param  len     Number of bytes.
+ *  @return bool    False if the document is not valid JSON.
+ */
+bool LTE_JSON::parse(const char* buf, uint32_t len) {
+    setInput(buf, len);
+    uint8_t token;
+    while ((token = next()) != JSON_NONE) {
+        if (token == JSON_ERROR) return false;
+        if (handler != NULL) handler(token, this, handlerContext);
+        if (token >= JSON_STRING) extract(token);
+    }
+    return true;
+}
+
+/** Calls parse() on the LTE_JSON object given as context. Matches
+ *  SocketDataHandler and HTTPBodyHandler, so a socket or an HTTP response
+ *  body can be parsed as it is received.
+ *
+ *  @param  buf         Document data.
+ *  @param  len         Number of bytes.
+ *  @param  context     The LTE_JSON object.
+ *  @return void
+ */
+void LTE_JSON::onData(const char* buf, uint32_t len, void* context) {
+    ((LTE_JSON*) context)->parse(buf, len);
+}
+
+/** Sets a function parse() calls with each token.
+ *
+ *  @param  handler     Called with the token; getValue() and getPath()
+ *                      describe it. NULL for none.
+ *  @param  context     Passed to handler unchanged.
+ *  @return void
+ */
+void LTE_JSON::setHandler(JSONHandler handler, void* context) {
+    this->handler = handler;
+    handlerContext = context;
+}
+
+/** Registers a path whose value parse() stores, e.g. "main.temp". Paths
+ *  of objects and arrays are not stored.
+ *
+ *  @param  path    Path as returned by getPath(). Not copied, so it must
+ *                  stay valid, e.g. a string constant.
+ *  @return int     Index for found() and the get functions, -1 if
+ *                  JSON_MAX_PATHS are registered already.
+ */
+int LTE_JSON::addPath(const char* path) {
+    if ((path == NULL) || (numPaths >= JSON_MAX_PATHS)) return -1;
+    paths[numPaths].path = path;
+    paths[numPaths].type = JSON_NONE;
+    paths[numPaths].value[0] = '\0';
+    return numPaths++;
+}
+
+/** Removes all registered paths.
+ *
+ *  @return void
+ */
+void LTE_JSON::clearPaths() {
+    numPaths = 0;
+}
+
+/** Returns true if the value of a registered path has been read.
+ *
+ *  @param  index   Index returned by addPath().
+ *  @return bool
+ */
+bool LTE_JSON::found(int index) {
+    return getType(index) != JSON_NONE;
+}
+
+/** Returns true if the values of all registered paths have been read.
+ *
+ *  @return bool
+ */
+bool LTE_JSON::foundAll() {
+    for (int i = 0; i < numPaths; i++)
+        if (paths[i].type == JSON_NONE) return false;
+    return true;
+}
+
+/** Returns the token type of a registered path's value.
+ *
+ *  @param  index   Index returned by addPath().
+ *  @return uint8_t JSON_STRING, JSON_NUMBER, JSON_TRUE, JSON_FALSE,
+ *                  JSON_NULL, or JSON_NONE if not found.
+ */
+uint8_t LTE_JSON::getType(int index) {
+    if ((index < 0) || (index >= numPaths)) return JSON_NONE;
+    return paths[index].type;
+}
+
+/** Returns the text of a registered path's value, e.g. "Dallas" or
+ *  "301.5".
+ *
+ *  @param  index   Index returned by addPath().
+ *  @return const char*     "" if not found.
+ */
+const char* LTE_JSON::getString(int index) {
+    if ((index < 0) || (index >= numPaths)) return "";
+    return paths[index].value;
+}
+
+/** Returns a registered path's value as an integer.
+ *
+ *  @param  index   Index returned by addPath().
+ *  @return long    0 if not found or not a number.
+ */
+long LTE_JSON::getInt(int index) {
+    return strtol(getString(index), NULL, 10);
+}
+
+/** Returns a registered path's value as a floating point number.
+ *
+ *  @param  index   Index returned by addPath().
+ *  @return double  0 if not found or not a number.
+ */
+double LTE_JSON::getFloat(int index) {
+    return atof(getString(index));
+}
+
+/** Handles a byte inside a string or literal.
+ *
+ *  @param  c           Byte.
+ *  @return uint8_t     Token completed by c, or JSON_NONE.
+ */
+uint8_t LTE_JSON::lexByte(char c) {
+    switch (lex) {
+    case LEX_STRING:
+        if (c == '"') {
+            lex = LEX_NONE;
+            if (stringIsKey) {
+                appendPath((stack[depth - 1].base > 0) ? '.' : 0,
+                           value, valueLen);
+                expect = EXPECT_COLON;
+                return JSON_KEY;
+            }
+            valueDone();
+            return JSON_STRING;
+        }
+        if (c == '\\') lex = LEX_ESCAPE;
+        else addChar(c);
+        return JSON_NONE;
+    case LEX_ESCAPE:
+        lex = LEX_STRING;
+        switch (c) {
+        case 'b': addChar('\b'); break;
+        case 'f': addChar('\f'); break;
+        case 'n': addChar('\n'); break;
+        case 'r': addChar('\r'); break;
+        case 't': addChar('\t'); break;
+        case 'u':
+            lex = LEX_UNICODE;
+            unicode = 0;
+            unicodeDigits = 0;
+            break;
+        default: addChar(c); break;     // '"', '\\', '/'
+        }
+        return JSON_NONE;
+    case LEX_UNICODE: {
+        int digit;
+        if ((c >= '0') && (c <= '9')) digit = c - '0';
+        else if ((c >= 'a') && (c <= 'f')) digit = c - 'a' + 10;
+        else if ((c >= 'A') && (c <= 'F')) digit = c - 'A' + 10;
+        else return fail();
+        unicode = (unicode << 4) | digit;
+        if (++unicodeDigits < 4) return JSON_NONE;
+        // UTF-8; each half of a surrogate pair is encoded on its own
+        if (unicode < 0x80) addChar(unicode);
+        else if (unicode < 0x800) {
+            addChar(0xC0 | (unicode >> 6));
+            addChar(0x80 | (unicode & 0x3F));
+        }
+        else {
+            addChar(0xE0 | (unicode >> 12));
+            addChar(0x80 | ((unicode >> 6) & 0x3F));
+            addChar(0x80 | (unicode & 0x3F));
+        }
+        lex = LEX_STRING;
+        return JSON_NONE;
+    }
+    case LEX_LITERAL:
+        if (c != literal[literalPos]) return fail();
+        addChar(c);
+        if (literal[++literalPos] != '\0') return JSON_NONE;
+        lex = LEX_NONE;
+        valueDone();
+        return literalToken;
+    default:
+        return fail();
+    }
+}
+
+/** Handles a byte between tokens.
+ *
+ *  @param  c           Byte.
+ *  @return uint8_t     Token started or completed by c, or JSON_NONE.
+ */
+uint8_t LTE_JSON::structural(char c) {
+    if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))
+        return JSON_NONE;
+
+    switch (expect) {
+    case EXPECT_VALUE_OR_END:
+        if (c == ']') return close();
+        // fall through
+    case EXPECT_VALUE:
+        startValue();
+        switch (c) {
+        case '{': return open(false);
+        case '[': return open(true);
+        case '"':
+            startToken(LEX_STRING);
+            stringIsKey = false;
+            return JSON_NONE;
+        case 't':
+            literal = "true";
+            literalToken = JSON_TRUE;
+            break;
+        case 'f':
+            literal = "false";
+            literalToken = JSON_FALSE;
+            break;
+        case 'n':
+            literal = "null";
+            literalToken = JSON_NULL;
+            break;
+        default:
+            if ((c != '-') && ((c < '0') || (c > '9'))) return fail();
+            startToken(LEX_NUMBER);
+            addChar(c);
+            return JSON_NONE;
+        }
+        startToken(LEX_LITERAL);
+        addChar(c);
+        literalPos = 1;
+        return JSON_NONE;
+    case EXPECT_KEY_OR_END:
+        if (c == '}') return close();
+        // fall through
+    case EXPECT_KEY:
+        if (c != '"') return fail();
+        startToken(LEX_STRING);
+        stringIsKey = true;
+        return JSON_NONE;
+    case EXPECT_COLON:
+        if (c != ':') return fail();
+        expect = EXPECT_VALUE;
+        return JSON_NONE;
+    case EXPECT_COMMA_OR_END: {
+        Level* level = &stack[depth - 1];
+        if (c == ',') {
+            endSlot();
+            if (level->array) level->index++;
+            expect = level->array ? EXPECT_VALUE : EXPECT_KEY;
+            return JSON_NONE;
+        }
+        if (c != (level->array ? ']' : '}')) return fail();
+        endSlot();
+        return close();
+    }
+    default:
+        return fail();      // Data after the top-level value
+    }
+}
+
+/** Enters an object or array.
+ *
+ *  @param  array       True for an array.
+ *  @return uint8_t     JSON_OBJECT_START or JSON_ARRAY_START.
+ */
+uint8_t LTE_JSON::open(bool array) {
+    if (depth >= JSON_MAX_DEPTH) return fail();
+    stack[depth].array = array;
+    stack[depth].index = 0;
+    stack[depth].base = pathLen;
+    depth++;
+    value[0] = '\0';
+    valueLen = 0;
+    truncated = false;
+    expect = array ? EXPECT_VALUE_OR_END : EXPECT_KEY_OR_END;
+    return array ? JSON_ARRAY_START : JSON_OBJECT_START;
+}
+
+/** Leaves the current object or array. Its path stays current for the
+ *  end token.
+ *
+ *  @return uint8_t     JSON_OBJECT_END or JSON_ARRAY_END.
+ */
+uint8_t LTE_JSON::close() {
+    bool array = stack[--depth].array;
+    value[0] = '\0';
+    valueLen = 0;
+    truncated = false;
+    valueDone();
+    return array ? JSON_ARRAY_END : JSON_OBJECT_END;
+}
+
+/** Stops at invalid JSON. next() returns JSON_ERROR until reset().
+ *
+ *  @return uint8_t     JSON_ERROR.
+ */
+uint8_t LTE_JSON::fail() {
+    expect = EXPECT_ERROR;
+    lex = LEX_NONE;
+    return JSON_ERROR;
+}
+
+/** Moves on after a complete value.
+ *
+ *  @return void
+ */
+void LTE_JSON::valueDone() {
+    expect = (depth == 0) ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+}
+
+/** Adds the index of an array element to the path when it starts.
+ *
+ *  @return void
+ */
+void LTE_JSON::startValue() {
+    if ((depth == 0) || !stack[depth - 1].array) return;
+    char buf[8];
+    int i = sizeof(buf);
+    unsigned int n = stack[depth - 1].index;
+    buf[--i] = ']';
+    do {
+        buf[--i] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    buf[--i] = '[';
+    appendPath(0, buf + i, sizeof(buf) - i);
+}
+
+/** Starts reading a string, number or literal into value[].
+ *
+ *  @param  lex     Token kind.
+ *  @return void
+ */
+void LTE_JSON::startToken(Lex lex) {
+    this->lex = lex;
+    value[0] = '\0';
+    valueLen = 0;
+    truncated = false;
+}
+
+/** Adds a byte to value[], or marks it truncated if full.
+ *
+ *  @param  c       Byte.
+ *  @return void
+ */
+void LTE_JSON::addChar(char c) {
+    if (valueLen >= JSON_VALUE_SIZE) {
+        truncated = true;
+        return;
+    }
+    value[valueLen++] = c;
+    value[valueLen] = '\0';
+}
+
+/** Adds a key or array index to the path. Once a segment does not fit,
+ *  the path stays invalid until that segment ends.
+ *
+ *  @param  sep     '.' before a key, 0 for none.
+ *  @param  str     Key, or array index in brackets.
+ *  @param  len     Number of bytes in str.
+ *  @return void
+ */
+void LTE_JSON::appendPath(char sep, const char* str, uint8_t len) {
+    int need = len + ((sep != 0) ? 1 : 0);
+    if ((pathOverflow > 0) || (pathLen + need > JSON_PATH_SIZE)) {
+        pathOverflow++;
+        return;
+    }
+    if (sep != 0) path[pathLen++] = sep;
+    memcpy(path + pathLen, str, len);
+    pathLen += len;
+    path[pathLen] = '\0';
+}
+
+/** Removes the current key or array index from the path after its value.
+ *
+ *  @return void
+ */
+void LTE_JSON::endSlot() {
+    if (pathOverflow > 0) {
+        pathOverflow--;
+        return;
+    }
+    pathLen = stack[depth - 1].base;
+    path[pathLen] = '\0';
+}
+
+/** Stores a value token whose path was registered with addPath().
+ *
+ *  @param  token   JSON_STRING, JSON_NUMBER, JSON_TRUE, JSON_FALSE or
+ *                  JSON_NULL.
+ *  @return void
+ */
+void LTE_JSON::extract(uint8_t token) {
+    if (pathOverflow > 0) return;
+    for (int i = 0; i < numPaths; i++) {
+        if (strcmp(paths[i].path, path) != 0) continue;
+        paths[i].type = token;
+        strcpy(paths[i].value, value);
+    }
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_JSON class is a JSON tokenizer that reads a document in pieces,
+ * as they come out of LTE_TCP::socketReceive() or LTE_HTTP, without
+ * storing it. Its memory use is fixed: a stack of JSON_MAX_DEPTH nesting
+ * levels, the path of the current value, and one value buffer.
+ *
+ * setInput() hands over the next piece and next() returns one token at a
+ * time (JSON_KEY, JSON_NUMBER, ...) until the piece is used up. A token
+ * split between pieces is returned once the rest arrives. getValue() is
+ * the text of the last key or value and getPath() its position in the
+ * document, e.g. "main.temp" or "weather[0].description".
+ *
+ * For the common case of reading a few fields, register their paths with
+ * addPath() and pass the data to parse(), which can be used directly as a
+ * body handler:
+ *
+ *     LTE_JSON json;
+ *     int temp = json.addPath("main.temp");
+ *     http.onBody(LTE_JSON::onData, &json);
+ *     http.get(host, path);
+ *     if (json.found(temp)) Serial.println(json.getFloat(temp));
+ *
+ * Strings and numbers longer than JSON_VALUE_SIZE are cut off, and paths
+ * longer than JSON_PATH_SIZE never match. A document nested deeper than
+ * JSON_MAX_DEPTH is reported as JSON_ERROR. A bare number as the whole
+ * document has no end, so it is not returned.
+ */
+
+
+#ifndef LTE_LTE_JSON_H_
+#define LTE_LTE_JSON_H_
+
+#include <Energia.h>
+
+#define JSON_MAX_DEPTH      8       // Nested objects and arrays
+#define JSON_PATH_SIZE      64      // Longest path kept, e.g. "main.temp"
+#define JSON_VALUE_SIZE     32      // Longest key or value kept
+#define JSON_MAX_PATHS      4       // Paths registered with addPath()
+
+// Tokens returned by next()
+#define JSON_NONE           0       // Need more input
+#define JSON_OBJECT_START   1
+#define JSON_OBJECT_END     2
+#define JSON_ARRAY_START    3
+#define JSON_ARRAY_END      4
+#define JSON_KEY            5
+#define JSON_STRING         6
+#define JSON_NUMBER         7
+#define JSON_TRUE           8
+#define JSON_FALSE          9
+#define JSON_NULL           10
+#define JSON_ERROR          11      // Not valid JSON; reset() to start over
+
+class LTE_JSON;
+
+// Called by parse() with each token
+typedef void (*JSONHandler)(uint8_t token, LTE_JSON* json, void* context);
+
+
+class LTE_JSON {
+public:
+    LTE_JSON();
+    void reset();
+
+    // Pull tokens
+    void setInput(const char* buf, uint32_t len);
+    uint8_t next();
+    const char* getValue() { return value; };
+    const char* getPath();
+    bool pathIs(const char* path);
+    int getDepth() { return depth; };
+    bool isTruncated() { return truncated; };
+    bool isDone();
+
+    // Push a whole piece, extracting registered paths
+    bool parse(const char* buf, uint32_t len);
+    static void onData(const char* buf, uint32_t len, void* context);
+    void setHandler(JSONHandler handler, void* context = NULL);
+    int addPath(const char* path);
+    void clearPaths();
+    bool found(int index);
+    bool foundAll();
+    uint8_t getType(int index);
+    const char* getString(int index);
+    long getInt(int index);
+    double getFloat(int index);
+
+private:
+    enum Expect {
+        EXPECT_VALUE,
+        EXPECT_VALUE_OR_END,    // After '['
+        EXPECT_KEY,
+        EXPECT_KEY_OR_END,      // After '{'
+        EXPECT_COLON,
+        EXPECT_COMMA_OR_END,
+        EXPECT_DONE,            // Top-level value complete
+        EXPECT_ERROR
+    };
+    enum Lex {
+        LEX_NONE,
+        LEX_STRING,
+        LEX_ESCAPE,             // After '\' in a string
+        LEX_UNICODE,            // In the 4 hex digits of "\u"
+        LEX_NUMBER,
+        LEX_LITERAL             // true, false or null
+    };
+    struct Level {
+        bool array;
+        uint16_t index;         // Element index in an array
+        uint8_t base;           // Path length of the container itself
+    };
+    struct Extract {
+        const char* path;       // Caller's string, not copied
+        uint8_t type;           // Token of the value, JSON_NONE until found
+        char value[JSON_VALUE_SIZE + 1];
+    };
+
+    uint8_t lexByte(char c);
+    uint8_t structural(char c);
+    uint8_t open(bool array);
+    uint8_t close();
+    uint8_t fail();
+    void valueDone();
+    void startValue();
+    void startToken(Lex lex);
+    void addChar(char c);
+    void appendPath(char sep, const char* str, uint8_t len);
+    void endSlot();
+    void extract(uint8_t token);
+
+    const char* input;
+    uint32_t inputLen;
+
+    Expect expect;
+    Lex lex;
+    bool stringIsKey;
+    const char* literal;        // "true", "false" or "null" being matched
+    uint8_t literalPos;
+    uint8_t literalToken;
+    uint16_t unicode;           // Code point of a "\u" escape
+    uint8_t unicodeDigits;
+
+    Level stack[JSON_MAX_DEPTH];
+    uint8_t depth;
+    char path[JSON_PATH_SIZE + 1];
+    uint8_t pathLen;
+    uint8_t pathOverflow;       // Path segments that did not fit
+
+    char value[JSON_VALUE_SIZE + 1];
+    uint8_t valueLen;
+    bool truncated;             // value was cut off
+
+    JSONHandler handler;
+    void* handlerContext;
+    Extract paths[JSON_MAX_PATHS];
+    uint8_t numPaths;
+};
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_MQTT_
+#define LTE_LTE_MQTT_
+
+#include "LTE_MQTT.h"
+
+// Control packet types, in the high nibble of the fixed header
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_SUBSCRIBE      0x82    // Flags 0010 are required
+#define MQTT_SUBACK         0x90
+#define MQTT_UNSUBSCRIBE    0xA2
+#define MQTT_UNSUBACK       0xB0
+#define MQTT_PINGREQ        0xC0
+#define MQTT_PINGRESP       0xD0
+#define MQTT_DISCONNECT     0xE0
+
+
+/** MQTT client constructor.
+ *
+ *  @param  tcp         LTE_TCP object the socket belongs to.
+ *  @param  conn_id     Connection ID (1-6) of the socket to use, or
+ *                      SSL_CONN_ID for MQTT over TLS.
+ */
+LTE_MQTT::LTE_MQTT(LTE_TCP* tcp, int conn_id)
+              : tcp(tcp), connId(conn_id), isConnected(false),
+                sessionFlag(false), connackReceived(false), connackCode(0),
+                keepAliveMs(0), lastSent(0), pingOutstanding(false),
+                pingSent(0), lastPacketId(0),
+                messageHandler(NULL), messageContext(NULL),
+                ackHandler(NULL), ackContext(NULL), numAcks(0),
+                rxState(RX_HEADER), rxHeader(0), rxLength(0), rxCount(0),
+                rxShift(0) {
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) inflight[i] = 0;
+}
+
+/** Opens the socket, sends CONNECT and waits for the broker's CONNACK.
+ *  Packet IDs still pending from an earlier connection are forgotten: the
+ *  broker only acknowledges messages sent on this one.
+ *
+ *  @param  host            Broker IP or host name.
+ *  @param  port            Broker port, usually 1883, or 8883 over TLS.
+ *  @param  clientId        Client identifier, unique per device. It names
+ *                          the session the broker keeps.
+ *  @param  user            User name, or NULL.
+ *  @param  password        Password, or NULL. Only sent with a user name.
+ *  @param  cleanSession    True to start a new session, discarding the one
+ *                          the broker kept. Default is false.
+ *  @param  keepAlive       Keep-alive interval in s, 0 to disable.
+ *  @return bool            True if the broker accepted the connection.
+ */
+bool LTE_MQTT::connect(char* host, int port, const char* clientId,
+                       const char* user, const char* password,
+                       bool cleanSession, uint16_t keepAlive) {
+    if ((host == NULL) || (clientId == NULL)) return false;
+    if (tcp->socketReady(connId)) tcp->socketClose(connId);
+    isConnected = false;
+    sessionFlag = false;
+    pingOutstanding = false;
+    numAcks = 0;
+    rxState = RX_HEADER;
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) inflight[i] = 0;
+    if (!tcp->socketOpen(host, port, connId, MQTT_PACKET_SIZE)) return false;
+
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    uint32_t remaining = 10 + 2 + strlen(clientId);
+    if (user != NULL) {
+        flags |= 0x80;
+        remaining += 2 + strlen(user);
+        if (password != NULL) {
+            flags |= 0x40;
+            remaining += 2 + strlen(password);
+        }
+    }
+    const uint8_t level[2] = { 4, flags };  // Protocol level 4 is 3.1.1
+    bool sent = writeHeader(MQTT_CONNECT, remaining) &&
+                writeString("MQTT") && writeBytes(level, 2) &&
+                writeWord(keepAlive) && writeString(clientId);
+    if (sent && (flags & 0x80)) sent = writeString(user);
+    if (sent && (flags & 0x40)) sent = writeString(password);
+    connackReceived = false;
+    if (!sent || !tcp->socketFlush(connId)) {
+        tcp->socketClose(connId);
+        return false;
+    }
+
+    uint32_t start = millis();
+    while (!connackReceived) {
+        if (!receive() || ((millis() - start) > MQTT_TIMEOUT)) {
+            if (tcp->socketReady(connId)) tcp->socketClose(connId);
+            return false;
+        }
+    }
+    if (connackCode != 0) {
+        // 1-5: protocol, client ID, server, credentials, not authorized
+        tcp->socketClose(connId);
+        return false;
+    }
+    isConnected = true;
+    keepAliveMs = (uint32_t) keepAlive * 1000;
+    lastSent = millis();
+    return true;
+}
+
+/** Sends what has been published, then DISCONNECT, and closes the socket.
+ *  The broker keeps a persistent session for the next connect().
+ *
+ *  @return void
+ */
+void LTE_MQTT::disconnect() {
+    if (isConnected) {
+        writeHeader(MQTT_DISCONNECT, 0);
+        tcp->socketFlush(connId);
+    }
+    isConnected = false;
+    if (tcp->socketReady(connId)) tcp->socketClose(connId);
+}
+
+/** Keeps the connection going; call it regularly. Sends the packets
+ *  published since the last call in as few AT#SSENDEXT as possible, passes
+ *  incoming messages to the onMessage() handler, acknowledges them, and
+ *  sends PINGREQ when nothing has been sent for 3/4 of the keep-alive
+ *  interval.
+ *
+ *  @return bool    False if not connected, e.g. after the broker closed
+ *                  the connection or stopped answering PINGREQ.
+ */
+bool LTE_MQTT::loop() {
+    if (!isConnected) return false;
+    if (!flush() || !receive()) {
+        lost();
+        return false;
+    }
+    if (keepAliveMs == 0) return true;
+
+    uint32_t now = millis();
+    if (pingOutstanding) {
+        if ((now - pingSent) > MQTT_TIMEOUT) {
+            lost();
+            return false;
+        }
+    }
+    else if ((now - lastSent) >= keepAliveMs - keepAliveMs / 4) {
+        if (!writeHeader(MQTT_PINGREQ, 0) || !tcp->socketFlush(connId)) {
+            lost();
+            return false;
+        }
+        pingOutstanding = true;
+        pingSent = now;
+        lastSent = now;
+    }
+    return true;
+}
+
+/** Sends the packets published so far without waiting for loop().
+ *
+ *  @return bool    True if they were sent.
+ */
+bool LTE_MQTT::flush() {
+    if (!isConnected) return false;
+    if (!tcp->socketFlush(connId)) {
+        lost();
+        return false;
+    }
+    return true;
+}
+
+/** Publishes a message. The packet is added to the socket's send buffer
+ *  and goes out with others on the next loop() or flush(), or as soon as
+ *  MQTT_PACKET_SIZE bytes have been collected.
+ *
+ *  @param  topic   Topic name, without wildcards.
+ *  @param  payload Message payload.
+ *  @param  len     Number of payload bytes.
+ *  @param  qos     0 (at most once) or 1 (at least once).
+ *  @param  retain  True to have the broker keep the message for new
+ *                  subscribers.
+ *  @return long    Packet ID of a QoS 1 message, 0 for QoS 0, -1 on
+ *                  failure or if MQTT_MAX_INFLIGHT messages are already
+ *                  awaiting PUBACK.
+ */
+long LTE_MQTT::publish(const char* topic, const uint8_t* payload, size_t len,
+                       uint8_t qos, bool retain) {
+    if (!isConnected || (topic == NULL) || (qos > 1) ||
+        ((payload == NULL) && (len > 0)))
+        return -1;
+
+    int slot = -1;
+    uint16_t id = 0;
+    if (qos == 1) {
+        for (int i = 0; (i < MQTT_MAX_INFLIGHT) && (slot < 0); i++)
+            if (inflight[i] == 0) slot = i;
+        if (slot < 0) return -1;
+        id = nextPacketId();
+    }
+
+    uint32_t remaining = 2 + strlen(topic) + ((qos == 1) ? 2 : 0) + len;
+    bool sent = writeHeader(MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0),
+                            remaining) && writeString(topic);
+    if (sent && (qos == 1)) sent = writeWord(id);
+    if (sent && (len > 0)) sent = writeBytes(payload, len);
+    if (!sent) {
+        lost();
+        return -1;
+    }
+    if (qos == 1) inflight[slot] = id;
+    lastSent = millis();
+    return id;
+}
+
+/** Publishes a string message.
+ *
+ *  @param  topic   Topic name, without wildcards.
+ *  @param  payload Message, NUL terminated.
+ *  @param  qos     0 (at most once) or 1 (at least once).
+ *  @param  retain  True to have the broker keep the message.
+ *  @return long    Packet ID of a QoS 1 message, 0 for QoS 0, -1 on failure.
+ */
+long LTE_MQTT::publish(const char* topic, const char* payload, uint8_t qos,
+                       bool retain) {
+    if (payload == NULL) return -1;
+    return publish(topic, (const uint8_t*) payload, strlen(payload), qos,
+                   retain);
+}
+
+/** Subscribes to a topic. SUBSCRIBE is sent with the next loop(); with a
+ *  persistent session the subscription outlives the connection, so it is
+ *  only needed when sessionPresent() is false.
+ *
+ *  @param  topic   Topic filter, may contain the wildcards '+' and '#'.
+ *  @param  qos     Max QoS of the messages delivered, 0 or 1.
+ *  @return bool    True if SUBSCRIBE was queued.
+ */
+bool LTE_MQTT::subscribe(const char* topic, uint8_t qos) {
+    if (!isConnected || (topic == NULL) || (qos > 1)) return false;
+    uint8_t requested = qos;
+    bool sent = writeHeader(MQTT_SUBSCRIBE, 2 + 2 + strlen(topic) + 1) &&
+                writeWord(nextPacketId()) && writeString(topic) &&
+                writeBytes(&requested, 1);
+    if (!sent) lost();
+    else lastSent = millis();
+    return sent;
+}
+
+/** Ends a subscription. UNSUBSCRIBE is sent with the next loop().
+ *
+ *  @param  topic   Topic filter as given to subscribe().
+ *  @return bool    True if UNSUBSCRIBE was queued.
+ */
+bool LTE_MQTT::unsubscribe(const char* topic) {
+    if (!isConnected || (topic == NULL)) return false;
+    bool sent = writeHeader(MQTT_UNSUBSCRIBE, 2 + 2 + strlen(topic)) &&
+                writeWord(nextPacketId()) && writeString(topic);
+    if (!sent) lost();
+    else lastSent = millis();
+    return sent;
+}
+
+/** Sets the function incoming messages are passed to. It is called while
+ *  the modem's data is being read, so it must not publish or use the
+ *  socket; set a flag and act on it after loop() instead. Messages longer
+ *  than MQTT_BUFFER_SIZE are acknowledged but not delivered.
+ *
+ *  @param  handler     Called with the topic and payload of each message.
+ *  @param  context     Passed to handler unchanged.
+ *  @return void
+ */
+void LTE_MQTT::onMessage(MQTTMessageHandler handler, void* context) {
+    messageHandler = handler;
+    messageContext = context;
+}
+
+/** Sets a function called when the broker acknowledges a QoS 1 message.
+ *  The same rules as for onMessage() apply.
+ *
+ *  @param  handler     Called with the packet ID publish() returned.
+ *  @param  context     Passed to handler unchanged.
+ *  @return void
+ */
+void LTE_MQTT::onAck(MQTTAckHandler handler, void* context) {
+    ackHandler = handler;
+    ackContext = context;
+}
+
+/** Returns true if a QoS 1 message has not been acknowledged yet.
+ *
+ *  @param  packetId    Packet ID publish() returned.
+ *  @return bool
+ */
+bool LTE_MQTT::isPending(uint16_t packetId) {
+    if (packetId == 0) return false;
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++)
+        if (inflight[i] == packetId) return true;
+    return false;
+}
+
+/** Returns the number of QoS 1 messages awaiting PUBACK.
+ *
+ *  @return int
+ */
+int LTE_MQTT::pendingCount() {
+    int n = 0;
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++)
+        if (inflight[i] != 0) n++;
+    return n;
+}
+
+/** Reads the data the modem holds for the socket, if any, and then sends
+ *  the PUBACKs for the QoS 1 messages in it.
+ *
+ *  @return bool    False if the socket is no longer connected, or the
+ *                  broker sent a malformed packet.
+ */
+bool LTE_MQTT::receive() {
+    // -1 means no SRING, so the modem has to be asked with AT#SRECV
+    if (tcp->socketAvailable(connId) != 0)
+        tcp->socketReceive(connId, onData, this);
+    if (numAcks > 0) {
+        bool sent = true;
+        for (int i = 0; (i < numAcks) && sent; i++)
+            sent = writeHeader(MQTT_PUBACK, 2) && writeWord(acks[i]);
+        numAcks = 0;
+        if (!sent || !tcp->socketFlush(connId)) return false;
+        lastSent = millis();
+    }
+    return (rxState != RX_ERROR) && tcp->socketReady(connId);
+}
+
+/** Marks the connection as lost and closes the socket.
+ *
+ *  @return void
+ */
+void LTE_MQTT::lost() {
+    isConnected = false;
+    if (tcp->socketReady(connId)) tcp->socketClose(connId);
+}
+
+/** Returns the next packet ID, skipping 0 and IDs still awaiting PUBACK.
+ *
+ *  @return uint16_t
+ */
+uint16_t LTE_MQTT::nextPacketId() {
+    do {
+        lastPacketId++;
+    } while ((lastPacketId == 0) || isPending(lastPacketId));
+    return lastPacketId;
+}
+
+/** Socket data handler passed to LTE_TCP::socketReceive().
+ *
+ *  @param  buf         Received data.
+ *  @param  len         Number of bytes.
+ *  @param  context     The LTE_MQTT object.
+ *  @return void
+ */
+void LTE_MQTT::onData(const char* buf, uint32_t len, void* context) {
+    ((LTE_MQTT*) context)->parse(buf, len);
+}
+
+/** Splits the received data into control packets, which may span pieces.
+ *  The first MQTT_BUFFER_SIZE bytes of each packet body are kept in rxBuf.
+ *  The topic length and packet ID of a PUBLISH are picked out as they
+ *  pass, so that a message too long for rxBuf can still be acknowledged.
+ *  A remaining length of more than 4 bytes stops parsing for good, since
+ *  the packets that follow can no longer be told apart.
+ *
+ *  @param  buf     Received data.
+ *  @param  len     Number of bytes.
+ *  @return void
+ */
+void LTE_MQTT::parse(const char* buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t c = buf[i];
+        switch (rxState) {
+        case RX_HEADER:
+            rxHeader = c;
+            rxLength = 0;
+            rxShift = 0;
+            rxTopicLen = 0;
+            rxPacketId = 0;
+            rxState = RX_LENGTH;
+            break;
+        case RX_LENGTH:
+            // 7 bits per byte, least significant first; bit 7 continues
+            rxLength |= (uint32_t) (c & 0x7F) << rxShift;
+            rxShift += 7;
+            if (c & 0x80) {
+                if (rxShift >= 28) rxState = RX_ERROR;  // At most 4 bytes
+                break;
+            }
+            rxCount = 0;
+            if (rxLength > 0) rxState = RX_BODY;
+            else {
+                handlePacket();
+                rxState = RX_HEADER;
+            }
+            break;
+        case RX_BODY:
+            if (rxCount < MQTT_BUFFER_SIZE) rxBuf[rxCount] = c;
+            if (rxCount < 2) rxTopicLen = (uint16_t) ((rxTopicLen << 8) | c);
+            else if (rxCount - 2 - rxTopicLen < 2)
+                rxPacketId = (uint16_t) ((rxPacketId << 8) | c);
+            if (++rxCount == rxLength) {
+                handlePacket();
+                rxState = RX_HEADER;
+            }
+            break;
+        case RX_ERROR:
+            return;
+        }
+    }
+}
+
+/** Handles a complete control packet from the broker.
+ *
+ *  @return void
+ */
+void LTE_MQTT::handlePacket() {
+    uint32_t kept = (rxLength < MQTT_BUFFER_SIZE) ? rxLength : MQTT_BUFFER_SIZE;
+    switch (rxHeader & 0xF0) {
+    case MQTT_CONNACK:
+        if (kept < 2) return;
+        sessionFlag = rxBuf[0] & 0x01;
+        connackCode = rxBuf[1];
+        connackReceived = true;
+        break;
+    case MQTT_PUBACK: {
+        if (kept < 2) return;
+        uint16_t id = (rxBuf[0] << 8) | rxBuf[1];
+        for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+            if (inflight[i] != id) continue;
+            inflight[i] = 0;
+            if (ackHandler != NULL) ackHandler(id, ackContext);
+            break;
+        }
+        break;
+    }
+    case MQTT_PUBLISH: {
+        uint8_t qos = (rxHeader >> 1) & 0x03;
+        uint32_t topicLen = rxTopicLen;
+        uint32_t start = 2 + topicLen + ((qos > 0) ? 2 : 0);
+        if (start > rxLength) return;   // Malformed
+        if (qos == 1) {
+            // Acknowledged after the read, even if too long to deliver; if
+            // too many arrive at once the rest is delivered again
+            if (numAcks < MQTT_MAX_INFLIGHT) acks[numAcks++] = rxPacketId;
+        }
+        if ((messageHandler == NULL) || (rxLength > MQTT_BUFFER_SIZE)) return;
+        // Move the topic over its length to make room for the NUL
+        memmove(rxBuf, rxBuf + 2, topicLen);
+        rxBuf[topicLen] = '\0';
+        messageHandler((const char*) rxBuf, rxBuf + start, rxLength - start,
+                       messageContext);
+        break;
+    }
+    case MQTT_PINGRESP:
+        pingOutstanding = false;
+        break;
+    default:
+        break;  // SUBACK, UNSUBACK
+    }
+}
+
+/** Adds a fixed header to the socket's send buffer.
+ *
+ *  @param  type        Packet type and flags.
+ *  @param  remaining   Length of the rest of the packet.
+ *  @return bool        True on success.
+ */
+bool LTE_MQTT::writeHeader(uint8_t type, uint32_t remaining) {
+    uint8_t buf[5];
+    int n = 0;
+    buf[n++] = type;
+    do {
+        uint8_t c = remaining & 0x7F;
+        remaining >>= 7;
+        if (remaining > 0) c |= 0x80;
+        buf[n++] = c;
+    } while ((remaining > 0) && (n < 5));
+    return writeBytes(buf, n);
+}
+
+/** Adds bytes to the socket's send buffer.
+ *
+ *  @param  buf     Bytes to write.
+ *  @param  len     Number of bytes.
+ *  @return bool    True on success.
+ */
+bool LTE_MQTT::writeBytes(const uint8_t* buf, size_t len) {
+    return tcp->socketBufferWrite(connId, buf, len) == (int) len;
+}
+
+/** Adds a 16 bit number, most significant byte first, to the socket's send
+ *  buffer.
+ *
+ *  @param  n       Number to write.
+ *  @return bool    True on success.
+ */
+bool LTE_MQTT::writeWord(uint16_t n) {
+    const uint8_t buf[2] = { (uint8_t) (n >> 8), (uint8_t) n };
+    return writeBytes(buf, 2);
+}
+
+/** Adds a string, preceded by its 16 bit length, to the socket's send
+ *  buffer.
+ *
+ *  @param  str     String to write.
+ *  @return bool    True on success.
+ */
+bool LTE_MQTT::writeString(const char* str) {
+    size_t len = strlen(str);
+    return writeWord(len) && writeBytes((const uint8_t*) str, len);
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_MQTT class is an MQTT 3.1.1 client on one LTE_TCP socket (or
+ * the SSL socket, SSL_CONN_ID, for MQTT over TLS). connect() opens the
+ * socket and waits for the broker's CONNACK; after that loop() must be
+ * called regularly, e.g. from the sketch's loop(): it sends what has been
+ * published, reads incoming packets and sends PINGREQ when the connection
+ * has been idle for most of the keep-alive interval.
+ *
+ * publish() does not send right away. Packets are collected in LTE_TCP's
+ * socket buffer, and several of them go out in one AT#SSENDEXT when the
+ * buffer fills up or on the next loop() or flush(). QoS 1 messages get a
+ * packet ID, which is tracked until the broker's PUBACK arrives; the
+ * handler set with onAck() is told when it does. The client keeps no copy
+ * of the payload, so a message still pending when the connection is lost
+ * has to be published again by the caller (see isPending()).
+ *
+ * By default the session is persistent (clean session off): the broker
+ * keeps subscriptions and QoS 1 messages for the client ID while the
+ * client is offline, and sessionPresent() tells after connect() whether
+ * the subscriptions still exist. QoS 2 is not supported.
+ *
+ *     LTE_MQTT mqtt(&lte);
+ *     mqtt.onMessage(handleMessage);
+ *     if (mqtt.connect("broker.example.com", 1883, "evk4-0001") &&
+ *         !mqtt.sessionPresent())
+ *         mqtt.subscribe("evk4/cmd", 1);
+ *     mqtt.publish("evk4/temp", "21.5");
+ */
+
+
+#ifndef LTE_LTE_MQTT_H_
+#define LTE_LTE_MQTT_H_
+
+#include "LTE_TCP.h"
+
+#define MQTT_KEEP_ALIVE     60      // Keep-alive interval (s)
+#define MQTT_TIMEOUT        10000   // Max wait (ms) for CONNACK
+#define MQTT_PACKET_SIZE    1000    // Bytes sent per AT#SSENDEXT, at most
+#define MQTT_BUFFER_SIZE    256     // Longest incoming packet kept
+#define MQTT_MAX_INFLIGHT   8       // QoS 1 messages awaiting PUBACK
+
+// Called with each message received on a subscribed topic
+typedef void (*MQTTMessageHandler)(const char* topic, const uint8_t* payload,
+                                   uint32_t len, void* context);
+
+// Called when the broker acknowledges a QoS 1 message
+typedef void (*MQTTAckHandler)(uint16_t packetId, void* context);
+
+
+class LTE_MQTT {
+public:
+    LTE_MQTT(LTE_TCP* tcp, int conn_id = DEFAULT_CONN_ID);
+
+    bool connect(char* host, int port, const char* clientId,
+                 const char* user = NULL, const char* password = NULL,
+                 bool cleanSession = false,
+                 uint16_t keepAlive = MQTT_KEEP_ALIVE);
+    void disconnect();
+    bool connected() { return isConnected; };
+    bool sessionPresent() { return sessionFlag; };
+    bool loop();
+    bool flush();
+
+    // Returns the packet ID of a QoS 1 message, 0 for QoS 0, -1 on failure
+    long publish(const char* topic, const uint8_t* payload, size_t len,
+                 uint8_t qos = 0, bool retain = false);
+    long publish(const char* topic, const char* payload, uint8_t qos = 0,
+                 bool retain = false);
+    bool subscribe(const char* topic, uint8_t qos = 0);
+    bool unsubscribe(const char* topic);
+
+    void onMessage(MQTTMessageHandler handler, void* context = NULL);
+    void onAck(MQTTAckHandler handler, void* context = NULL);
+    bool isPending(uint16_t packetId);
+    int pendingCount();
+
+private:
+    enum RxState {
+        RX_HEADER,              // Fixed header byte
+        RX_LENGTH,              // Remaining length bytes
+        RX_BODY,                // Variable header and payload
+        RX_ERROR                // Malformed length, framing lost
+    };
+
+    static void onData(const char* buf, uint32_t len, void* context);
+    void parse(const char* buf, uint32_t len);
+    void handlePacket();
+    bool receive();
+    void lost();
+    uint16_t nextPacketId();
+    bool writeHeader(uint8_t type, uint32_t remaining);
+    bool writeBytes(const uint8_t* buf, size_t len);
+    bool writeWord(uint16_t n);
+    bool writeString(const char* str);
+
+    LTE_TCP* tcp;
+    int connId;                 // Connection ID of the socket used
+    bool isConnected;
+    bool sessionFlag;           // CONNACK session present
+    bool connackReceived;
+    uint8_t connackCode;
+    uint32_t keepAliveMs;
+    uint32_t lastSent;          // millis() when a packet was last sent
+    bool pingOutstanding;       // PINGREQ sent, no PINGRESP yet
+    uint32_t pingSent;
+    uint16_t lastPacketId;
+
+    MQTTMessageHandler messageHandler;
+    void* messageContext;
+    MQTTAckHandler ackHandler;
+    void* ackContext;
+    uint16_t inflight[MQTT_MAX_INFLIGHT];   // QoS 1 packet IDs, 0 if free
+    uint16_t acks[MQTT_MAX_INFLIGHT];       // PUBACKs to send after a read
+    uint8_t numAcks;
+
+    // Incoming packet
+    RxState rxState;
+    uint8_t rxHeader;
+    uint32_t rxLength;          // Remaining length
+    uint32_t rxCount;           // Bytes of the body received
+    uint8_t rxShift;            // Remaining length bits decoded
+    uint16_t rxTopicLen;        // PUBLISH topic length, from the body
+    uint16_t rxPacketId;        // PUBLISH packet ID, after the topic
+    uint8_t rxBuf[MQTT_BUFFER_SIZE + 1];
+};
+
+#endif
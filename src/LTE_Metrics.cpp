@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_METRICS_
+#define LTE_LTE_METRICS_
+
+#include "LTE_Base.h"
+
+#ifdef LTE_METRICS
+
+#include "LTE_Metrics.h"
+
+
+/** Metrics constructor. All counters start at zero.
+ */
+LTE_Metrics::LTE_Metrics() {
+    reset();
+}
+
+/** Sets all counters back to zero and forgets the command names.
+ *
+ *  @return void
+ */
+void LTE_Metrics::reset() {
+    bytesTx = 0;
+    bytesRx = 0;
+    commands = 0;
+    errors = 0;
+    timeouts = 0;
+    bufferFull = 0;
+    receives = 0;
+    srecvCommands = 0;
+    srecvMax = 0;
+    numCommands = 0;
+    untracked = 0;
+}
+
+/** Adds one completed command to its statistics and the totals.
+ *
+ *  @param  name    Command name, e.g. "#SGACT" for "AT#SGACT=3,1".
+ *  @param  us      Time from sending the command to its final result.
+ *  @param  result  RESULT_* code, RESULT_NONE if it timed out.
+ *  @return void
+ */
+void LTE_Metrics::recordCommand(const char* name, uint32_t us,
+                                uint8_t result) {
+    commands++;
+    if (result == RESULT_ERROR) errors++;
+    if (result == RESULT_NONE) timeouts++;
+
+    LTE_CommandStats* s = getCommand(name);
+    if (s == NULL) {
+        if (numCommands >= METRIC_COMMANDS) {
+            untracked++;
+            return;
+        }
+        s = &stats[numCommands++];
+        memset(s, 0, sizeof(LTE_CommandStats));
+        strncpy(s->name, name, METRIC_NAME_SIZE - 1);
+    }
+    s->count++;
+    if (result == RESULT_ERROR) s->errors++;
+    if (result == RESULT_NONE) s->timeouts++;
+    s->totalUs += us;
+    if (us > s->maxUs) s->maxUs = us;
+
+    // Bucket 0 is below 1 ms, bucket n below 2^n ms
+    uint32_t ms = us / 1000;
+    int bucket = 0;
+    while ((ms > 0) && (bucket < METRIC_BUCKETS - 1)) {
+        ms >>= 1;
+        bucket++;
+    }
+    s->buckets[bucket]++;
+}
+
+/** Returns the statistics of a command.
+ *
+ *  @param  name                Command name, e.g. "#SGACT".
+ *  @return LTE_CommandStats*   NULL if the command was not recorded.
+ */
+LTE_CommandStats* LTE_Metrics::getCommand(const char* name) {
+    for (int i = 0; i < numCommands; i++)
+        if (strncmp(stats[i].name, name, METRIC_NAME_SIZE - 1) == 0)
+            return &stats[i];
+    return NULL;
+}
+
+/** Returns the number of commands with statistics.
+ *
+ *  @return int
+ */
+int LTE_Metrics::getCommandCount() {
+    return numCommands;
+}
+
+/** Returns the statistics of a command by position, in order of first use.
+ *
+ *  @param  index               0 to getCommandCount() - 1.
+ *  @return LTE_CommandStats*   NULL if index is out of range.
+ */
+LTE_CommandStats* LTE_Metrics::getCommandAt(int index) {
+    if ((index < 0) || (index >= numCommands)) return NULL;
+    return &stats[index];
+}
+
+/** Prints the totals and one line per command: count, errors, timeouts,
+ *  average and max latency in ms, and the latency histogram.
+ *
+ *  @param  out     Where to print, e.g. &Serial.
+ *  @return void
+ */
+void LTE_Metrics::dump(Print* out) {
+    if (out == NULL) return;
+    out->print("bytes tx "); out->print((long) bytesTx);
+    out->print(", rx "); out->print((long) bytesRx);
+    out->print("\r\ncommands "); out->print((long) commands);
+    out->print(", errors "); out->print((long) errors);
+    out->print(", timeouts "); out->print((long) timeouts);
+    out->print(", buffer full "); out->print((long) bufferFull);
+    out->print("\r\nsocket receives "); out->print((long) receives);
+    out->print(", AT#SRECV "); out->print((long) srecvCommands);
+    out->print(", most in one receive "); out->print((long) srecvMax);
+    if (untracked > 0) {
+        out->print("\r\ncommands not itemized "); out->print((long) untracked);
+    }
+    out->print("\r\ncommand count err t/o avg_ms max_ms | "
+               "<1 <2 <4 <8 <16 <32 <64 <128 <256 <512 <1024 more\r\n");
+    for (int i = 0; i < numCommands; i++) {
+        LTE_CommandStats* s = &stats[i];
+        out->print("AT");
+        out->print(s->name);
+        out->print(' '); out->print((long) s->count);
+        out->print(' '); out->print((long) s->errors);
+        out->print(' '); out->print((long) s->timeouts);
+        out->print(' '); out->print((long) (s->totalUs / s->count / 1000));
+        out->print(' '); out->print((long) (s->maxUs / 1000));
+        out->print(" |");
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            out->print(' ');
+            out->print((long) s->buckets[b]);
+        }
+        out->print("\r\n");
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_Metrics class collects counters about the library's traffic with
+ * the modem: a latency histogram, ERROR and timeout counts per AT command,
+ * bytes sent and received on the serial port, AT#SRECV commands per socket
+ * receive, and data[] buffer-full events. Only counters are updated while
+ * commands run; nothing is printed until dump() is called.
+ *
+ * Metrics are off by default and then compile out completely: uncomment
+ * LTE_METRICS in LTE_Base.h (or define it for the whole build) to enable
+ * them. LTE_Base::getMetrics() returns the counters, and
+ * LTE_Base::dumpMetrics() prints them, e.g. to Serial.
+ */
+
+
+#ifndef LTE_LTE_METRICS_H_
+#define LTE_LTE_METRICS_H_
+
+#include <Energia.h>
+
+#define METRIC_COMMANDS     24  // Command names with their own statistics
+#define METRIC_BUCKETS      12  // Latency buckets: < 1, 2, 4 ... 1024 ms, more
+#define METRIC_NAME_SIZE    16  // Same as LTE_Base::pendingCommand
+
+// Statistics of one AT command, e.g. "#SGACT"
+struct LTE_CommandStats {
+    char name[METRIC_NAME_SIZE];
+    uint32_t count;             // Responses received, or timed out
+    uint32_t errors;            // ERROR, +CME ERROR, +CMS ERROR
+    uint32_t timeouts;          // No final result code
+    uint64_t totalUs;           // Sum of latencies, 32 bits wrap in 71 min
+    uint32_t maxUs;
+    uint32_t buckets[METRIC_BUCKETS];   // Latency histogram
+};
+
+
+class LTE_Metrics {
+public:
+    LTE_Metrics();
+    void reset();
+    void recordCommand(const char* name, uint32_t us, uint8_t result);
+    LTE_CommandStats* getCommand(const char* name);
+    int getCommandCount();
+    LTE_CommandStats* getCommandAt(int index);
+    void dump(Print* out);
+
+    // Totals, updated directly by LTE_Base and LTE_TCP
+    uint32_t bytesTx;           // Bytes written to the serial port
+    uint32_t bytesRx;           // Bytes read from the serial port
+    uint32_t commands;          // Commands completed
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t bufferFull;        // Responses cut off by a full data[]
+    uint32_t receives;          // socketReceive() calls that sent AT#SRECV
+    uint32_t srecvCommands;     // AT#SRECV commands sent by them
+    uint32_t srecvMax;          // Most AT#SRECV commands in one receive
+
+private:
+    LTE_CommandStats stats[METRIC_COMMANDS];
+    int numCommands;
+    uint32_t untracked;         // Commands beyond METRIC_COMMANDS names
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_QUEUE_
+#define LTE_LTE_QUEUE_
+
+#include "LTE_Queue.h"
+
+
+/** Store-and-forward queue constructor.
+ *
+ *  @param  policy  QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST, what push() does
+ *                  when the queue is full.
+ */
+LTE_Queue::LTE_Queue(uint8_t policy)
+              : policy(policy), droppedCount(0), storage(NULL) {
+    ram.size = QUEUE_SIZE;
+    ram.external = false;
+    spill.size = 0;
+    spill.external = true;
+    clear();
+}
+
+/** Sets what push() does when the queue is full.
+ *
+ *  @param  policy  QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+ *  @return void
+ */
+void LTE_Queue::setPolicy(uint8_t policy) {
+    this->policy = policy;
+}
+
+/** Sets external memory the oldest records are moved to when the RAM ring
+ *  is full. Records already spilled to a previous storage are dropped.
+ *
+ *  @param  storage     External memory, NULL for none.
+ *  @return void
+ */
+void LTE_Queue::setStorage(LTE_QueueStorage* storage) {
+    this->storage = storage;
+    spill.head = 0;
+    spill.used = 0;
+    spill.count = 0;
+    spill.size = (storage == NULL) ? 0 : storage->size();
+}
+
+/** Adds a record at the end of the queue.
+ *
+ *  @param  record  Record bytes.
+ *  @param  len     Record length, 1 to QUEUE_RECORD_SIZE.
+ *  @return bool    False if the record is too long, the queue is full with
+ *                  QUEUE_DROP_NEWEST, or storage failed while making room.
+ */
+bool LTE_Queue::push(const uint8_t* record, size_t len) {
+    if ((record == NULL) || (len == 0) || (len > QUEUE_RECORD_SIZE))
+        return false;
+    while (ram.size - ram.used < len + 1) {
+        if (spillOldest()) continue;
+        if ((policy == QUEUE_DROP_NEWEST) || !dropOldest()) {
+            droppedCount++;
+            return false;
+        }
+    }
+    return append(&ram, record, len);
+}
+
+/** Adds a string record, without its NUL, at the end of the queue.
+ *
+ *  @param  record  Record, NUL terminated.
+ *  @return bool    False if the record is too long, or the queue is full
+ *                  with QUEUE_DROP_NEWEST.
+ */
+bool LTE_Queue::push(const char* record) {
+    if (record == NULL) return false;
+    return push((const uint8_t*) record, strlen(record));
+}
+
+/** Copies the oldest record without removing it.
+ *
+ *  @param  buf     Buffer of at least QUEUE_RECORD_SIZE bytes.
+ *  @return int     Record length, -1 if the queue is empty.
+ */
+int LTE_Queue::peek(uint8_t* buf) {
+    int len = readRecord((spill.count > 0) ? &spill : &ram, 0);
+    if (len > 0) memcpy(buf, record, len);
+    return len;
+}
+
+/** Removes the oldest record.
+ *
+ *  @return bool    False if the queue is empty or storage failed.
+ */
+bool LTE_Queue::pop() {
+    return remove((spill.count > 0) ? &spill : &ram);
+}
+
+/** Removes every record.
+ *
+ *  @return void
+ */
+void LTE_Queue::clear() {
+    ram.head = 0;
+    ram.used = 0;
+    ram.count = 0;
+    spill.head = 0;
+    spill.used = 0;
+    spill.count = 0;
+}
+
+/** Sends the queued records over a socket, opening it if it is not open,
+ *  and removes them as they are sent. Each AT#SSENDEXT carries as many
+ *  whole records as the socket's packet size allows. The socket is left
+ *  open for the next upload; it is closed if sending fails.
+ *
+ *  @param  tcp         LTE_TCP object the socket belongs to.
+ *  @param  host        Server IP or host name.
+ *  @param  port        Server port.
+ *  @param  conn_id     Connection ID (1-6) of the socket to use, or
+ *                      SSL_CONN_ID.
+ *  @return int         Number of records sent, -1 if none could be.
+ */
+int LTE_Queue::upload(LTE_TCP* tcp, char* host, int port, int conn_id) {
+    if (count() == 0) return 0;
+    if (!tcp->socketReady(conn_id) && !tcp->socketOpen(host, port, conn_id))
+        return -1;
+    uint32_t packetSize = tcp->getPacketSize(conn_id);
+
+    int sent = 0;
+    while (count() > 0) {
+        Cursor c;
+        first(&c);
+        uint32_t batchLen = 0;
+        uint32_t n = 0;
+        bool ok = true;
+        int len;
+        while ((len = next(&c)) > 0) {
+            if ((n > 0) && (batchLen + len > packetSize)) break;
+            ok = tcp->socketBufferWrite(conn_id, record, len) == len;
+            if (!ok) break;
+            batchLen += len;
+            n++;
+        }
+        if (!ok || (len < 0) || !tcp->socketFlush(conn_id)) {
+            if (tcp->socketReady(conn_id)) tcp->socketClose(conn_id);
+            return (sent > 0) ? sent : -1;
+        }
+        for (uint32_t i = 0; i < n; i++) pop();
+        sent += n;
+    }
+    return sent;
+}
+
+/** Passes the queued records, oldest first, to a handler, removing each
+ *  one the handler reports as sent. Stops at the first it does not.
+ *
+ *  @param  handler     Called with each record.
+ *  @param  context     Passed to handler unchanged.
+ *  @param  maxRecords  Most records to pass, 0 for all.
+ *  @return int         Number of records sent, -1 if none could be.
+ */
+int LTE_Queue::upload(QueueRecordHandler handler, void* context,
+                      int maxRecords) {
+    if (count() == 0) return 0;
+    int sent = 0;
+    while ((count() > 0) && ((maxRecords == 0) || (sent < maxRecords))) {
+        int len = readRecord((spill.count > 0) ? &spill : &ram, 0);
+        if ((len < 0) || !handler(record, len, context)) break;
+        pop();
+        sent++;
+    }
+    return (sent > 0) ? sent : -1;
+}
+
+/** Reads or writes ring bytes, wrapping around the end of the ring.
+ *
+ *  @param  r       Ring.
+ *  @param  offset  Offset from the ring's head.
+ *  @param  buf     Bytes to write, or buffer to read into.
+ *  @param  len     Number of bytes.
+ *  @param  write   True to write, false to read.
+ *  @return bool    False if the storage failed.
+ */
+bool LTE_Queue::access(Ring* r, uint32_t offset, uint8_t* buf, size_t len,
+                       bool write) {
+    uint32_t pos = (r->head + offset) % r->size;
+    while (len > 0) {
+        size_t n = r->size - pos;
+        if (n > len) n = len;
+        if (!r->external) {
+            if (write) memcpy(arena + pos, buf, n);
+            else memcpy(buf, arena + pos, n);
+        }
+        else if (!(write ? storage->write(pos, buf, n) :
+                           storage->read(pos, buf, n)))
+            return false;
+        buf += n;
+        len -= n;
+        pos = 0;
+    }
+    return true;
+}
+
+/** Reads a record into record[].
+ *
+ *  @param  r       Ring.
+ *  @param  offset  Offset of the record's length byte from the ring's head.
+ *  @return int     Record length, -1 if there is none or storage failed.
+ */
+int LTE_Queue::readRecord(Ring* r, uint32_t offset) {
+    uint8_t len;
+    if (offset >= r->used) return -1;
+    if (!access(r, offset, &len, 1, false) ||
+        !access(r, offset + 1, record, len, false))
+        return -1;
+    return len;
+}
+
+/** Adds a record at the end of a ring that has room for it.
+ *
+ *  @param  r       Ring.
+ *  @param  buf     Record bytes.
+ *  @param  len     Record length.
+ *  @return bool    False if storage failed.
+ */
+bool LTE_Queue::append(Ring* r, const uint8_t* buf, uint8_t len) {
+    uint8_t frame[QUEUE_RECORD_SIZE + 1];   // Length byte, then the record
+    frame[0] = len;
+    memcpy(frame + 1, buf, len);
+    if (!access(r, r->used, frame, len + 1, true)) return false;
+    r->used += len + 1;
+    r->count++;
+    return true;
+}
+
+/** Removes the oldest record of a ring.
+ *
+ *  @param  r       Ring.
+ *  @return bool    False if the ring is empty or storage failed.
+ */
+bool LTE_Queue::remove(Ring* r) {
+    uint8_t len;
+    if ((r->count == 0) || !access(r, 0, &len, 1, false)) return false;
+    r->head = (r->head + len + 1) % r->size;
+    r->used -= len + 1;
+    r->count--;
+    if (r->count == 0) {
+        r->head = 0;
+        r->used = 0;
+    }
+    return true;
+}
+
+/** Moves the oldest record in RAM to the end of the storage ring. With
+ *  QUEUE_DROP_OLDEST, the oldest stored records are dropped to make room.
+ *
+ *  @return bool    True if a record was moved.
+ */
+bool LTE_Queue::spillOldest() {
+    if ((storage == NULL) || (ram.count == 0)) return false;
+    int len = readRecord(&ram, 0);
+    if ((len < 0) || ((uint32_t) len + 1 > spill.size)) return false;
+    while (spill.size - spill.used < (uint32_t) len + 1) {
+        if ((policy == QUEUE_DROP_NEWEST) || !remove(&spill)) return false;
+        droppedCount++;
+    }
+    if (!append(&spill, record, len)) return false;
+    remove(&ram);
+    return true;
+}
+
+/** Drops the oldest record in the queue.
+ *
+ *  @return bool    False if the queue is empty or storage failed.
+ */
+bool LTE_Queue::dropOldest() {
+    if (!pop()) return false;
+    droppedCount++;
+    return true;
+}
+
+/** Points a cursor at the oldest record.
+ *
+ *  @param  c       Cursor.
+ *  @return void
+ */
+void LTE_Queue::first(Cursor* c) {
+    c->ring = (spill.count > 0) ? &spill : &ram;
+    c->offset = 0;
+    c->index = 0;
+}
+
+/** Reads the record at a cursor into record[] and moves the cursor to the
+ *  next one, from the storage ring on to the RAM ring.
+ *
+ *  @param  c       Cursor.
+ *  @return int     Record length, 0 after the newest record, -1 if storage
+ *                  failed.
+ */
+int LTE_Queue::next(Cursor* c) {
+    if ((c->ring == &spill) && (c->index == spill.count)) {
+        c->ring = &ram;
+        c->offset = 0;
+        c->index = 0;
+    }
+    if (c->index == c->ring->count) return 0;
+    int len = readRecord(c->ring, c->offset);
+    if (len < 0) return -1;
+    c->offset += len + 1;
+    c->index++;
+    return len;
+}
+
+#endif
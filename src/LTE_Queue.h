@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_Queue class stores records, e.g. sensor readings, until they can
+ * be uploaded, so that a reading taken while the network is down is not
+ * lost, and so that many readings share one connection. Records are kept
+ * oldest first in a ring of QUEUE_SIZE bytes; each costs its length plus
+ * one byte.
+ *
+ * upload() opens a socket if needed and sends the records in batches of
+ * whole records, each batch as large as the socket's packet size allows,
+ * so that one AT#SSENDEXT carries many records. A record is removed only
+ * after the batch it is in has been sent, so a failed upload loses
+ * nothing; records of a batch that failed part way may arrive twice.
+ * Records are sent as they are: add a separator such as "\n" to each if
+ * the server needs one. The other upload() passes records one at a time
+ * to a handler instead, e.g. to publish them over LTE_MQTT.
+ *
+ * When the ring is full, push() either rejects the new record
+ * (QUEUE_DROP_NEWEST) or drops the oldest ones to make room
+ * (QUEUE_DROP_OLDEST, the default). With setStorage(), the oldest records
+ * are moved to a second, larger ring in external memory such as flash or
+ * FRAM first, and records are only dropped once that is full too:
+ *
+ *     LTE_Queue queue;
+ *     queue.push("{\"t\":21.5}\n");
+ *     if (lte.isConnected()) queue.upload(&lte, "example.com", 8080);
+ *
+ * The queue's position in external memory is kept in RAM, so records
+ * spilled there do not survive a reset.
+ */
+
+
+#ifndef LTE_LTE_QUEUE_H_
+#define LTE_LTE_QUEUE_H_
+
+#include "LTE_TCP.h"
+
+#define QUEUE_SIZE          1024    // RAM ring, bytes
+#define QUEUE_RECORD_SIZE   128     // Longest record, at most 255
+
+// What push() does when the queue is full
+#define QUEUE_DROP_NEWEST   0       // Reject the new record
+#define QUEUE_DROP_OLDEST   1       // Drop the oldest records
+
+// Called by upload() with each record; returns true if it was sent
+typedef bool (*QueueRecordHandler)(const uint8_t* record, size_t len,
+                                   void* context);
+
+
+// External memory records are spilled to. Addresses run from 0 to size()-1.
+// write() must leave every byte outside the range it writes unchanged, so a
+// flash implementation reads, erases and rewrites the pages it touches.
+// Each record is one write(), split in two only where it wraps around.
+class LTE_QueueStorage {
+public:
+    virtual ~LTE_QueueStorage() {};
+    virtual uint32_t size() = 0;
+    virtual bool read(uint32_t addr, uint8_t* buf, size_t len) = 0;
+    virtual bool write(uint32_t addr, const uint8_t* buf, size_t len) = 0;
+};
+
+
+class LTE_Queue {
+public:
+    LTE_Queue(uint8_t policy = QUEUE_DROP_OLDEST);
+    void setPolicy(uint8_t policy);
+    void setStorage(LTE_QueueStorage* storage);
+
+    bool push(const uint8_t* record, size_t len);
+    bool push(const char* record);
+    int peek(uint8_t* buf);
+    bool pop();
+    void clear();
+    uint32_t count() { return ram.count + spill.count; };
+    uint32_t spilled() { return spill.count; };
+    uint32_t dropped() { return droppedCount; };
+
+    // Returns the number of records sent, -1 if none could be
+    int upload(LTE_TCP* tcp, char* host, int port,
+               int conn_id = DEFAULT_CONN_ID);
+    int upload(QueueRecordHandler handler, void* context = NULL,
+               int maxRecords = 0);
+
+private:
+    struct Ring {
+        uint32_t head;          // Offset of the oldest record
+        uint32_t used;          // Bytes in use
+        uint32_t count;         // Records
+        uint32_t size;          // Capacity, bytes
+        bool external;          // In storage instead of arena[]
+    };
+    struct Cursor {
+        Ring* ring;             // Ring being read
+        uint32_t offset;        // From the ring's head
+        uint32_t index;         // Records read from the ring
+    };
+
+    bool access(Ring* r, uint32_t offset, uint8_t* buf, size_t len,
+                bool write);
+    int readRecord(Ring* r, uint32_t offset);
+    bool append(Ring* r, const uint8_t* buf, uint8_t len);
+    bool remove(Ring* r);
+    bool spillOldest();
+    bool dropOldest();
+    void first(Cursor* c);
+    int next(Cursor* c);
+
+    uint8_t policy;
+    uint32_t droppedCount;
+    LTE_QueueStorage* storage;
+    Ring ram;
+    Ring spill;                 // Older records than ram, in storage
+    uint8_t arena[QUEUE_SIZE];
+    uint8_t record[QUEUE_RECORD_SIZE];  // Record read by readRecord()
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_RINGBUFFER_
+#define LTE_LTE_RINGBUFFER_
+
+#include <string.h>
+#include "LTE_RingBuffer.h"
+
+
+/** Ring buffer constructor. The buffer starts empty.
+ */
+LTE_RingBuffer::LTE_RingBuffer() {
+    clear();
+}
+
+/** Returns the number of bytes stored in the buffer.
+ *
+ *  @return uint32_t
+ */
+uint32_t LTE_RingBuffer::available() {
+    return count;
+}
+
+/** Returns the number of bytes that can be written before the buffer is
+ *  full.
+ *
+ *  @return uint32_t
+ */
+uint32_t LTE_RingBuffer::space() {
+    return RX_RING_SIZE - count;
+}
+
+/** Discards all stored bytes.
+ *
+ *  @return void
+ */
+void LTE_RingBuffer::clear() {
+    head = 0;
+    count = 0;
+}
+
+/** Appends one byte at the tail.
+ *
+ *  @param  c       Byte to store.
+ *  @return bool    False if the buffer is full.
+ */
+bool LTE_RingBuffer::put(char c) {
+    if (count >= RX_RING_SIZE) return false;
+    buf[(head + count) % RX_RING_SIZE] = c;
+    count++;
+    return true;
+}
+
+/** Appends up to len bytes at the tail.
+ *
+ *  @param  src         Bytes to store.
+ *  @param  len         Number of bytes.
+ *  @return uint32_t    Number of bytes stored.
+ */
+uint32_t LTE_RingBuffer::write(const char* src, uint32_t len) {
+    uint32_t written = 0;
+    while ((written < len) && (count < RX_RING_SIZE)) {
+        uint32_t tail = (head + count) % RX_RING_SIZE;
+        uint32_t n = ((tail >= head) ? RX_RING_SIZE : head) - tail;
+        if (n > len - written) n = len - written;
+        memcpy(buf + tail, src + written, n);
+        count += n;
+        written += n;
+    }
+    return written;
+}
+
+/** Removes and returns the byte at the head.
+ *
+ *  @return int     Byte value, -1 if the buffer is empty.
+ */
+int LTE_RingBuffer::get() {
+    if (count == 0) return -1;
+    uint8_t c = (uint8_t) buf[head];
+    head = (head + 1) % RX_RING_SIZE;
+    count--;
+    return c;
+}
+
+/** Returns a byte without removing it.
+ *
+ *  @param  offset  Position relative to the head.
+ *  @return int     Byte value, -1 if fewer than offset + 1 bytes are stored.
+ */
+int LTE_RingBuffer::peek(uint32_t offset) {
+    if (offset >= count) return -1;
+    return (uint8_t) buf[(head + offset) % RX_RING_SIZE];
+}
+
+/** Removes up to len bytes from the head and copies them to dst.
+ *
+ *  @param  dst         Destination buffer.
+ *  @param  len         Max bytes to copy.
+ *  @return uint32_t    Number of bytes copied.
+ */
+uint32_t LTE_RingBuffer::read(char* dst, uint32_t len) {
+    uint32_t copied = 0;
+    const char* span;
+    uint32_t n;
+    while ((copied < len) && ((n = readSpan(&span)) > 0)) {
+        if (n > len - copied) n = len - copied;
+        memcpy(dst + copied, span, n);
+        consume(n);
+        copied += n;
+    }
+    return copied;
+}
+
+/** Returns a view of the bytes at the head that are contiguous in memory.
+ *  When the stored data wraps around the end of the buffer, the view stops
+ *  at the end, and a second readSpan() after consume() returns the rest.
+ *  The view stays valid until those bytes are consumed.
+ *
+ *  @param  span        Receives a pointer to the head byte.
+ *  @return uint32_t    Number of bytes in the view, 0 if empty.
+ */
+uint32_t LTE_RingBuffer::readSpan(const char** span) {
+    *span = buf + head;
+    if (head + count > RX_RING_SIZE) return RX_RING_SIZE - head;
+    return count;
+}
+
+/** Removes bytes from the head, typically after reading them through
+ *  readSpan().
+ *
+ *  @param  len     Number of bytes to remove.
+ *  @return void
+ */
+void LTE_RingBuffer::consume(uint32_t len) {
+    if (len > count) len = count;
+    head = (head + len) % RX_RING_SIZE;
+    count -= len;
+}
+
+#endif
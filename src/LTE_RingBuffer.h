@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_RingBuffer class is a fixed-size byte FIFO that sits between the
+ * Telit serial port and the response parser in LTE_Base. Bytes are written
+ * at the tail as they come off the UART and read from the head by the
+ * parser.
+ *
+ * Besides byte-wise get()/peek(), readSpan() returns a view of the bytes at
+ * the head that are contiguous in memory, and consume() advances the head
+ * past them. This lets payload such as AT#SRECV socket data be handed to
+ * its final destination straight out of the ring, without staging it in
+ * another buffer first. A full FIFO holds RX_RING_SIZE bytes.
+ */
+
+
+#ifndef LTE_LTE_RINGBUFFER_H_
+#define LTE_LTE_RINGBUFFER_H_
+
+#include <stdint.h>
+
+#define RX_RING_SIZE 1024
+
+
+class LTE_RingBuffer {
+public:
+    LTE_RingBuffer();
+
+    uint32_t available();           // Bytes that can be read
+    uint32_t space();               // Bytes that can be written
+    void clear();
+
+    // Writing at the tail
+    bool put(char c);
+    uint32_t write(const char* buf, uint32_t len);
+
+    // Reading at the head
+    int get();
+    int peek(uint32_t offset = 0);
+    uint32_t read(char* buf, uint32_t len);
+
+    // Zero-copy views of the head
+    uint32_t readSpan(const char** span);
+    void consume(uint32_t len);
+
+private:
+    char buf[RX_RING_SIZE];
+    uint32_t head;                  // Next byte to read
+    uint32_t count;                 // Bytes stored
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * An LTE_Socket is a handle to one of the LE910's six connection IDs on an
+ * LTE_TCP object. It holds no state of its own: every call goes to the
+ * LTE_TCP function of the same name with the handle's connection ID, so
+ * handles can be created and copied freely. For example:
+ *
+ *     LTE_Socket mqtt(&lte, 1);
+ *     LTE_Socket http(&lte, 2);
+ *     mqtt.open("broker.example.com", 1883);
+ *     http.open("api.example.com");
+ */
+
+
+#ifndef LTE_LTE_SOCKET_H_
+#define LTE_LTE_SOCKET_H_
+
+#include "LTE_TCP.h"
+
+
+class LTE_Socket {
+public:
+    LTE_Socket(LTE_TCP* tcp, int conn_id) : tcp(tcp), connId(conn_id) {};
+
+    bool open(char* r_ip, int r_port = 80, int packet_size = 300,
+              int inactivity_timeout = 180, int connection_timeout = 600) {
+        return tcp->socketOpen(r_ip, r_port, connId, packet_size,
+                               inactivity_timeout, connection_timeout);
+    };
+    bool ready() { return tcp->socketReady(connId); };
+    int status() { return tcp->getSocketStatus(connId); };
+    int write(const uint8_t* buf, size_t len) {
+        return tcp->socketWrite(connId, buf, len);
+    };
+    int bufferWrite(const uint8_t* buf, size_t len) {
+        return tcp->socketBufferWrite(connId, buf, len);
+    };
+    bool flush() { return tcp->socketFlush(connId); };
+    int available() { return tcp->socketAvailable(connId); };
+    int receive(char* buf, int len) {
+        return tcp->socketReceive(connId, buf, len);
+    };
+    int receive(SocketDataHandler handler, void* context = NULL,
+                int maxBytes = 0) {
+        return tcp->socketReceive(connId, handler, context, maxBytes);
+    };
+    bool onReceive(SocketDataHandler handler, void* context = NULL) {
+        return tcp->setReceiveHandler(connId, handler, context);
+    };
+    bool close() { return tcp->socketClose(connId); };
+    int getConnectionID() { return connId; };
+
+private:
+    LTE_TCP* tcp;
+    int connId;         // Connection ID (1-6)
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_SOCKETPOOL_
+#define LTE_LTE_SOCKETPOOL_
+
+#include "LTE_SocketPool.h"
+
+
+/** Socket pool constructor. The pool starts empty; sockets are opened by
+ *  acquire().
+ *
+ *  @param  tcp         LTE_TCP object the sockets belong to.
+ *  @param  first_id    First connection ID the pool may use (1-6).
+ *  @param  count       Number of connection IDs the pool may use.
+ */
+LTE_SocketPool::LTE_SocketPool(LTE_TCP* tcp, int first_id, int count)
+                    : tcp(tcp) {
+    if (first_id < 1) first_id = 1;
+    if (first_id > MAX_SOCKETS) first_id = MAX_SOCKETS;
+    if (count < 1) count = 1;
+    if (count > MAX_SOCKETS - first_id + 1) count = MAX_SOCKETS - first_id + 1;
+    firstId = first_id;
+    this->count = count;
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+        entries[i].pooled = false;
+        entries[i].inUse = false;
+        entries[i].lastUsed = 0;
+    }
+    setSocketConfig();
+}
+
+/** Sets the socketOpen() parameters used for pooled sockets. The
+ *  inactivity timeout also decides when an idle socket is reopened rather
+ *  than reused.
+ *
+ *  @param  packet_size         Packet size in bytes.
+ *  @param  inactivity_timeout  Modem closes the socket after this many
+ *                              seconds without data, 0 for never.
+ *  @param  connection_timeout  Connect timeout (hundreds of ms).
+ *  @return void
+ */
+void LTE_SocketPool::setSocketConfig(int packet_size, int inactivity_timeout,
+                                     int connection_timeout) {
+    packetSize = packet_size;
+    inactivityTimeout = inactivity_timeout;
+    connTimeout = connection_timeout;
+}
+
+/** Returns a connected socket to host:port. An idle pooled socket to the
+ *  same host and port is reused if it is still open; otherwise a socket is
+ *  opened on a free connection ID, closing the least recently used idle
+ *  socket if there is none.
+ *
+ *  @param  host    Remote IP or host name.
+ *  @param  port    Remote port. Default is 80.
+ *  @return int     Connection ID, -1 on failure.
+ */
+int LTE_SocketPool::acquire(char* host, int port) {
+    if ((host == NULL) || (host[0] == '\0')) return -1;
+    tcp->poll();    // NO CARRIER URCs update the cached socket states
+
+    // Reuse an idle socket to host:port, reopening it if it went away
+    for (int i = 0; i < count; i++) {
+        int id = firstId + i;
+        Entry* e = &entries[i];
+        if (!e->pooled || e->inUse || (tcp->getRemotePort(id) != port) ||
+            (strcmp(tcp->getRemoteHost(id), host) != 0))
+            continue;
+        if (!expired(e) && tcp->socketReady(id)) {
+            e->inUse = true;
+            e->lastUsed = millis();
+            return id;
+        }
+        return reconnect(id) ? id : -1;
+    }
+
+    // Take a connection ID the pool is not using, or else the least
+    // recently used idle one
+    int free = -1;
+    int oldest = -1;
+    for (int i = 0; i < count; i++) {
+        Entry* e = &entries[i];
+        if (e->inUse) continue;
+        if (!e->pooled) {
+            free = i;
+            break;
+        }
+        if ((oldest == -1) ||
+            ((int32_t) (e->lastUsed - entries[oldest].lastUsed) < 0))
+            oldest = i;
+    }
+    if (free == -1) {
+        if (oldest == -1) return -1;    // Every socket is in use
+        close(firstId + oldest);
+        free = oldest;
+    }
+    return openEntry(firstId + free, host, port) ? firstId + free : -1;
+}
+
+/** Hands a socket back to the pool. It stays open for the next acquire()
+ *  of the same host:port.
+ *
+ *  @param  conn_id     Connection ID returned by acquire().
+ *  @return void
+ */
+void LTE_SocketPool::release(int conn_id) {
+    Entry* e = findEntry(conn_id);
+    if (e == NULL) return;
+    e->inUse = false;
+    e->lastUsed = millis();
+}
+
+/** Writes to a pooled socket like LTE_TCP::socketWrite(). If the socket
+ *  turns out to be closed (e.g. the server dropped a kept-alive
+ *  connection), it is reopened and the data sent again once.
+ *
+ *  @param  conn_id     Connection ID returned by acquire().
+ *  @param  buf         Data to write.
+ *  @param  len         Number of bytes.
+ *  @return int         Number of bytes written, -1 on failure.
+ */
+int LTE_SocketPool::write(int conn_id, const uint8_t* buf, size_t len) {
+    Entry* e = findEntry(conn_id);
+    if ((e == NULL) || !e->pooled) return -1;
+    int n = tcp->socketWrite(conn_id, buf, len);
+    if ((n == -1) && !tcp->socketReady(conn_id) && reconnect(conn_id))
+        n = tcp->socketWrite(conn_id, buf, len);
+    e->lastUsed = millis();
+    return n;
+}
+
+/** Closes a pooled socket and opens it again to the same host:port.
+ *
+ *  @param  conn_id     Connection ID returned by acquire().
+ *  @return bool        True on success.
+ */
+bool LTE_SocketPool::reconnect(int conn_id) {
+    Entry* e = findEntry(conn_id);
+    if ((e == NULL) || !e->pooled) return false;
+
+    // The host is stored in the socket, which socketOpen() overwrites
+    char host[256];
+    strncpy(host, tcp->getRemoteHost(conn_id), 255);
+    host[255] = '\0';
+    int port = tcp->getRemotePort(conn_id);
+    tcp->socketClose(conn_id);
+    return openEntry(conn_id, host, port);
+}
+
+/** Closes a socket and removes it from the pool.
+ *
+ *  @param  conn_id     Connection ID returned by acquire().
+ *  @return bool        True on success.
+ */
+bool LTE_SocketPool::close(int conn_id) {
+    Entry* e = findEntry(conn_id);
+    if (e == NULL) return false;
+    e->pooled = false;
+    e->inUse = false;
+    return tcp->socketClose(conn_id);
+}
+
+/** Closes every socket in the pool.
+ *
+ *  @return void
+ */
+void LTE_SocketPool::closeAll() {
+    for (int i = 0; i < count; i++)
+        if (entries[i].pooled) close(firstId + i);
+}
+
+/** Closes idle sockets that the modem's inactivity timeout is about to
+ *  close anyway. Call this from loop() to release them early; acquire()
+ *  works without it.
+ *
+ *  @return int     Number of sockets closed.
+ */
+int LTE_SocketPool::expire() {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        Entry* e = &entries[i];
+        if (e->pooled && !e->inUse && expired(e)) {
+            close(firstId + i);
+            n++;
+        }
+    }
+    return n;
+}
+
+/** Returns the pool entry of a connection ID.
+ *
+ *  @param  conn_id     Connection ID.
+ *  @return Entry*      NULL if the pool does not manage conn_id.
+ */
+LTE_SocketPool::Entry* LTE_SocketPool::findEntry(int conn_id) {
+    if ((conn_id < firstId) || (conn_id >= firstId + count)) return NULL;
+    return &entries[conn_id - firstId];
+}
+
+/** Returns true if an idle socket is within POOL_EXPIRY_MARGIN of the
+ *  modem's inactivity timeout.
+ *
+ *  @param  e       Pool entry.
+ *  @return bool
+ */
+bool LTE_SocketPool::expired(Entry* e) {
+    if (inactivityTimeout == 0) return false;
+    uint32_t limit = (uint32_t) inactivityTimeout * 1000;
+    limit = (limit > POOL_EXPIRY_MARGIN) ? limit - POOL_EXPIRY_MARGIN : 0;
+    return (millis() - e->lastUsed) >= limit;
+}
+
+/** Opens a socket for the pool and marks it acquired.
+ *
+ *  @param  conn_id     Connection ID.
+ *  @param  host        Remote IP or host name.
+ *  @param  port        Remote port.
+ *  @return bool        True on success.
+ */
+bool LTE_SocketPool::openEntry(int conn_id, char* host, int port) {
+    Entry* e = findEntry(conn_id);
+    e->pooled = tcp->socketOpen(host, port, conn_id, packetSize,
+                                inactivityTimeout, connTimeout);
+    e->inUse = e->pooled;
+    e->lastUsed = millis();
+    return e->pooled;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * 4G/LTE Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * An LTE_SocketPool keeps sockets of an LTE_TCP object open between
+ * requests, keyed by remote host and port, so periodic requests to the
+ * same server skip the TCP handshake and teardown. acquire() returns the
+ * connection ID of an idle socket to that host:port, or opens one;
+ * release() hands it back to the pool without closing it. For example:
+ *
+ *     LTE_SocketPool pool(&lte);
+ *     int id = pool.acquire("api.example.com", 80);
+ *     if (id > 0) {
+ *         pool.write(id, (const uint8_t*) request, len);
+ *         lte.socketReceive(id, buf, sizeof(buf));
+ *         pool.release(id);
+ *     }
+ *
+ * An idle socket is checked against LTE_TCP's cached socket state before
+ * reuse, which NO CARRIER URCs keep current, so the check costs no AT
+ * command. Sockets closed by the server, or idle long enough that the
+ * modem's inactivity timeout is about to close them, are reopened on the
+ * same connection ID. write() also reopens a socket found closed and
+ * sends again. When every connection ID is taken, the least recently used
+ * idle socket is closed to make room.
+ *
+ * The pool manages connection IDs first_id to first_id + count - 1; other
+ * IDs remain free for sockets opened directly through LTE_TCP.
+ */
+
+
+#ifndef LTE_LTE_SOCKETPOOL_H_
+#define LTE_LTE_SOCKETPOOL_H_
+
+#include "LTE_TCP.h"
+
+#define POOL_EXPIRY_MARGIN  5000   // Reopen this long (ms) before the
+                                   // modem's inactivity timeout
+
+
+class LTE_SocketPool {
+public:
+    LTE_SocketPool(LTE_TCP* tcp, int first_id = 1, int count = MAX_SOCKETS);
+
+    void setSocketConfig(int packet_size = 300, int inactivity_timeout = 180,
+                         int connection_timeout = 600);
+    int acquire(char* host, int port = 80);
+    void release(int conn_id);
+    int write(int conn_id, const uint8_t* buf, size_t len);
+    bool reconnect(int conn_id);
+    bool close(int conn_id);
+    void closeAll();
+    int expire();
+
+private:
+    struct Entry {              // State of one pooled connection ID
+        bool pooled;            // Opened by the pool, key is host:port
+        bool inUse;             // Acquired and not yet released
+        uint32_t lastUsed;      // millis() of the last acquire/write/release
+    };
+    Entry* findEntry(int conn_id);
+    bool expired(Entry* e);
+    bool openEntry(int conn_id, char* host, int port);
+
+    LTE_TCP* tcp;
+    int firstId;                // First connection ID of the pool
+    int count;                  // Number of connection IDs in the pool
+    Entry entries[MAX_SOCKETS];
+    int packetSize;             // socketOpen() settings for pooled sockets
+    int inactivityTimeout;
+    int connTimeout;
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "LTE_TCP.h"
 #include "LTE_Base.h"
+#include "LTE_Command.h"
 
 
 /** LTE TCP class constructor.
@@ -24,7 +25,14 @@ LTE_TCP::LTE_TCP(HardwareSerial* tp, HardwareSerial* dp)
     #ifdef DEBUG
     debugPort->write(">> Constructing LTE_TCP object ...\r\n");
     #endif
+    for (int i = 0; i < NUM_SOCKETS; i++) {
+        sockets[i].receiveBuf = NULL;
+        sockets[i].sendBuf = NULL;
+    }
     reset();
+    registerURC("SRING: ", onSRING, this);
+    registerURC("NO CARRIER: ", onNoCarrier, this);
+    registerURC("SSLSRING: ", onSSLSRING, this);
 }
 
 /** Initializes access point and internet settings.
@@ -33,23 +41,31 @@ LTE_TCP::LTE_TCP(HardwareSerial* tp, HardwareSerial* dp)
  *  @param  apn       Access point name.
  *  @return bool      True on success.
  */
-bool LTE_TCP::init(uint32_t lte_band, char* apn) {
+bool LTE_TCP::init(uint32_t lte_band, const char* apn) {
     if (!LTE_Base::init(lte_band)) {
         return false;
     }
 
-    char cmd[40];
-    sprintf(cmd, "AT#SGACT=%d,0", DEFAULT_CID);
-    sendATCommand(cmd);
-    receiveData(5000, 100);
+    // The modem may have been reset, so nothing cached is trusted
+    attached = false;
+    sslEnabled = false;
+    contextClosed();
+    for (int i = 0; i < NUM_SOCKETS; i++) {
+        sockets[i].configured = false;
+        sockets[i].extConfigured = false;
+    }
+
+    LTE_Command(this, "AT#SGACT").arg(DEFAULT_CID).arg(0).send();
+    receiveData(TIMEOUT_AUTO, 100);
 
     #ifdef DEBUG
     debugPort->write(">> Setting PDP Context parameters ...\r\n");
     #endif
 
-    sprintf(cmd, "AT+CGDCONT=%d,\"IP\",%s,\"\",0,0",
-            DEFAULT_CID, DEFAULT_APN);
-    if (!sendATCommand(cmd) || !receiveData(2000,500) || !parseFind("OK")) {
+    if (!LTE_Command(this, "AT+CGDCONT").arg(DEFAULT_CID).quoted("IP")
+             .quoted(apn).quoted("").arg(0).arg(0).send() ||
+        !receiveData(TIMEOUT_AUTO, 500) ||
+        (getResultCode() != RESULT_OK)) {
         #ifdef DEBUG
         debugPort->write(">> ... Setting PDP Context params failed\r\n");
         #endif
@@ -60,15 +76,22 @@ bool LTE_TCP::init(uint32_t lte_band, char* apn) {
     debugPort->write(">> Activating PDP Context ...\r\n");
     #endif
 
-    sprintf(cmd, "AT#SGACT=%d,1", DEFAULT_CID);
-    sendATCommand(cmd);
-    receiveData(5000, 100);
-    if (!parseFind("OK")) {
+    LTE_Command(this, "AT#SGACT").arg(DEFAULT_CID).arg(1).send();
+    receiveData(TIMEOUT_AUTO, 100);
+    if (getResultCode() != RESULT_OK) {
         #ifdef DEBUG
         debugPort->write(">> ... Activating PDP Context failed\r\n");
         #endif
         return false;
     }
+
+    // An active context implies the GPRS attach
+    memset(hostIP, '\0', 40);
+    char* ip = findInfo("#SGACT: ");
+    for (int i = 0; (ip != NULL) && (i < 39) && (ip[i] != '\r'); i++)
+        hostIP[i] = ip[i];
+    attached = true;
+    pdpActive = true;
     return true;
 }
 
@@ -76,13 +99,16 @@ bool LTE_TCP::init(uint32_t lte_band, char* apn) {
  *  the socket is opened up on connection ID 1. If you would like to use
  *  multiple sockets at once (to query multiple servers, or to have your
  *  application act as both a server/client), you must open other sockets
- *  on different conenction ID's.
+ *  on different conenction ID's. The socket opened last is the one used by
+ *  the functions that take no conn_id.
  *
  *  @param  r_ip                Remote IP addr (in form "xxx.xxx.xxx.xxx")
  *  @param  r_port              Remote port. Default is 80.
  *  @param  conn_id             TCP socket ID. LE910 has the connection IDs
- *                              (1-6). Default is 1.
- *  @param  pkt_size            Packet size in bytes. Default is 300.
+ *                              (1-6). Default is 1. SSL_CONN_ID opens a
+ *                              TLS connection on the SSL socket.
+ *  @param  pkt_size            Packet size in bytes. Default is 300, at
+ *                              most MAX_SSLSEND_SIZE for SSL_CONN_ID.
  *  @param  inactivity_timeo    Socket times out after there is no data
  *                              exchange for this period of time (seconds).
  *  @param  conn_timeo          Socket times out if it can't establish a
@@ -92,9 +118,76 @@ bool LTE_TCP::init(uint32_t lte_band, char* apn) {
  */
 bool LTE_TCP::socketOpen(char* r_ip, int r_port, int conn_id, int pkt_size,
                          int inactivity_timeo, int conn_timeo) {
+    return openSocket(r_ip, r_port, conn_id, pkt_size, inactivity_timeo,
+                      conn_timeo, 1);
+}
+
+/** Opens a TCP/IP socket like socketOpen(), but in online data mode: once
+ *  connected, the serial port carries the socket's data directly, without
+ *  AT#SSEND/AT#SRECV framing or per-chunk command round trips. Use
+ *  onlineWrite() and onlineRead() to transfer data, and socketSuspend() to
+ *  get back to command mode (socketResume() returns to online mode).
+ *
+ *  No AT commands can be sent while online. This mode suits bulk transfers
+ *  such as firmware or log uploads.
+ *
+ *  @return bool    True once the modem reports CONNECT.
+ */
+bool LTE_TCP::socketOpenOnline(char* r_ip, int r_port, int conn_id,
+                               int pkt_size, int inactivity_timeo,
+                               int conn_timeo) {
+    return openSocket(r_ip, r_port, conn_id, pkt_size, inactivity_timeo,
+                      conn_timeo, 0);
+}
+
+/** Opens a UDP socket in command mode. There is no connection to set up,
+ *  so the modem answers right away. socketWrite() sends each call's data
+ *  as one datagram to r_ip:r_port, and socketSendTo() to any address;
+ *  datagrams arriving on local_port are announced with SRING and read with
+ *  socketReceiveFrom(). socketBufferWrite() merges writes into datagrams of
+ *  pkt_size bytes.
+ *
+ *  @param  r_ip                Remote IP addr or host name.
+ *  @param  r_port              Remote port.
+ *  @param  conn_id             Connection ID (1-6). Default is 1.
+ *  @param  local_port          Local UDP port, 0 to let the modem pick one.
+ *  @param  pkt_size            Packet size in bytes. Default is 300.
+ *  @param  inactivity_timeo    Socket closes after there is no data
+ *                              exchange for this period of time (seconds).
+ *  @return bool                True on success.
+ */
+bool LTE_TCP::socketOpenUDP(char* r_ip, int r_port, int conn_id,
+                            int local_port, int pkt_size,
+                            int inactivity_timeo) {
+    return openSocket(r_ip, r_port, conn_id, pkt_size, inactivity_timeo,
+                      600, 1, true, local_port);
+}
+
+/** Shared implementation of socketOpen(), socketOpenOnline() and
+ *  socketOpenUDP().
+ *
+ *  @param  conn_mode   AT#SD connMode: 0 online mode, 1 command mode.
+ *  @param  udp         True for AT#SD txProt 1.
+ *  @param  local_port  AT#SD lPort of a UDP socket.
+ *  @return bool        True on success.
+ */
+bool LTE_TCP::openSocket(char* r_ip, int r_port, int conn_id, int pkt_size,
+                         int inactivity_timeo, int conn_timeo, int conn_mode,
+                         bool udp, int local_port) {
+    if (onlineMode) {
+        #ifdef DEBUG
+        debugPort->write(">> Socket failed to open. Socket is online\r\n");
+        #endif
+        return false;
+    }
+    bool secure = (conn_id == SSL_CONN_ID);
     if ((r_ip == NULL) || (r_ip[0] == '\0') || (strlen(r_ip) > 255) ||
         (r_port < 1) || (r_port > 65535) || (conn_id < 1) ||
-        (conn_id > 6) || (pkt_size <= 0) || (pkt_size > 1500) ||
+        ((conn_id > 6) && !secure) || (secure && (conn_mode == 0)) ||
+        (pkt_size <= 0) || (pkt_size > 1500) ||
+        (secure && (pkt_size > MAX_SSLSEND_SIZE)) ||
+        (udp && (secure || (conn_mode == 0))) ||
+        (local_port < 0) || (local_port > 65535) ||
         (inactivity_timeo < 0) || (inactivity_timeo > 65535) ||
         (conn_timeo < 10) || (conn_timeo > 1200)) {
         #ifdef DEBUG
@@ -103,68 +196,608 @@ bool LTE_TCP::socketOpen(char* r_ip, int r_port, int conn_id, int pkt_size,
         return false;
     }
 
-    strncpy(remoteIP, r_ip, strlen(r_ip));
-    remotePort = r_port;
+    // A connection ID cached as open is checked with the modem once
+    Socket* s = findSocket(conn_id);
+    if ((s->status != 0) && (getSocketStatus(conn_id) != 0)) {
+        #ifdef DEBUG
+        debugPort->write(">> Socket failed to open. Connection ID in use\r\n");
+        #endif
+        return false;
+    }
+
+    strncpy(s->remoteIP, r_ip, 255);
+    s->remotePort = r_port;
+    s->udp = udp;
+    s->localPort = local_port;
+    if (pkt_size != s->packetSize) s->configured = false;
+    s->packetSize = pkt_size;
+    s->sendLen = 0;     // Buffered data belonged to the previous socket
+
+    // Configures socket for specified socket connection ID, connection ID.
+    // The modem keeps these settings, so they are only sent when changed.
+    // The SSL socket's AT#SSLCFG also asks for "SSLSRING: 1,<bytes>".
+    if (secure && !sslEnable()) return false;
+    if (!s->configured || (s->inactivityTimeout != inactivity_timeo) ||
+        (s->connTimeout != conn_timeo)) {
+        if (secure) {
+            s->configured = LTE_Command(this, "AT#SSLCFG").arg(SSL_ID)
+                .arg(cid).arg(pkt_size).arg(inactivity_timeo).arg(conn_timeo)
+                .arg(50).arg(1).arg(0).arg(0).arg(0).sendOK();
+            s->sringEnabled = s->configured;
+        }
+        else s->configured = LTE_Command(this, "AT#SCFG").arg(conn_id)
+            .arg(cid).arg(pkt_size).arg(inactivity_timeo).arg(conn_timeo)
+            .arg(0).sendOK();
+        if (!s->configured) {
+            #ifdef DEBUG
+            debugPort->write(">> Socket configuration failed\r\n");
+            #endif
+            return false;
+        }
+        s->inactivityTimeout = inactivity_timeo;
+        s->connTimeout = conn_timeo;
+    }
+
+    // Ask for SRING notifications with the number of pending bytes, so
+    // socketReceive() knows when and how much to read. Without them (older
+    // firmware), socketReceive() falls back to polling with AT#SRECV.
+    s->pendingBytes = 0;
+    if ((conn_mode == 1) && !secure && !s->extConfigured) {
+        s->sringEnabled = LTE_Command(this, "AT#SCFGEXT").arg(conn_id)
+            .arg(SRING_MODE).arg(0).arg(0).sendOK();
+
+        // Report remote closes as "NO CARRIER: <connId>,<cause>", which
+        // keeps the cached socket state current (best effort)
+        LTE_Command(this, "AT#SCFGEXT2").arg(conn_id).arg(0).arg(0).arg(0)
+            .arg(0).arg(2).sendOK();
+        s->extConfigured = true;
+    }
+
+    // Reuse the PDP context if it is known to be active
+    bool reused = pdpActive;
+    if (!activateContext()) return false;
+
+    // With the DNS cache on, dial the cached or freshly resolved address.
+    // TLS checks the certificate against the name, so it is dialed as is.
+    char ip[16];
+    char* host = r_ip;
+    bool cachedIP = false;
+    if (dnsEnabled && !secure && !isIPAddress(r_ip)) {
+        cachedIP = (findDNS(r_ip) != NULL);
+        if (resolveHost(r_ip, ip)) host = ip;
+    }
 
-    if (!gprsAttach()) {
+    // Open socket. The modem answers once connected, or after conn_timeo.
+    bool connected = dialSocket(host, r_port, conn_id, conn_timeo, conn_mode);
+    if (!connected && reused && contextLost() && activateContext())
+        connected = dialSocket(host, r_port, conn_id, conn_timeo, conn_mode);
+    if (!connected && cachedIP) {
+        // The name may point somewhere else by now
+        DNSEntry* d = findDNS(r_ip);
+        if (d != NULL) d->host[0] = '\0';
+        if (resolveHost(r_ip, ip))
+            connected = dialSocket(ip, r_port, conn_id, conn_timeo, conn_mode);
+    }
+    if (!connected) {
         #ifdef DEBUG
-        debugPort->write(">> GPRS attach failed when opening socket\r\n");
+        debugPort->write(">> Failed to open socket\r\n");
         #endif
+        s->statusValid = false;
         return false;
     }
+    connectionID = conn_id;
+    if (conn_mode == 0) {
+        onlineMode = true;
+        setStatus(s, 1);    // Active data transfer
+        lastOnlineWrite = millis();
+        return true;
+    }
+    setStatus(s, (s->pendingBytes > 0) ? 3 : 2);    // No AT#SS needed
+    return true;
+}
+
+/** Dials a configured connection ID with AT#SD, or the SSL socket with
+ *  AT#SSLD, which includes the TLS handshake. A UDP socket is dialed with
+ *  txProt 1 and its local port. With session reuse on, the
+ *  SSL socket is dialed with closure type 1 so that the modem keeps the
+ *  session when it closes.
+ *
+ *  @param  conn_mode   AT#SD connMode: 0 online mode, 1 command mode.
+ *  @return bool        True if the modem reports the connection.
+ */
+bool LTE_TCP::dialSocket(char* r_ip, int r_port, int conn_id, int conn_timeo,
+                         int conn_mode) {
+    if (conn_id == SSL_CONN_ID)
+        return LTE_Command(this, "AT#SSLD").arg(SSL_ID).arg(r_port)
+                   .quoted(r_ip).arg(sslReuse ? 1 : 0).arg(1).send() &&
+               receiveData(conn_timeo * 100 + 1000, 100) &&
+               (getResultCode() == RESULT_OK);
+    Socket* s = findSocket(conn_id);
+    return LTE_Command(this, "AT#SD").arg(conn_id).arg(s->udp ? 1 : 0)
+               .arg(r_port).arg(r_ip).arg(s->udp ? 0 : 255).arg(s->localPort)
+               .arg(conn_mode).send() &&
+           receiveData(conn_timeo * 100 + 1000, 100) &&
+           (getResultCode() == ((conn_mode == 0) ? RESULT_CONNECT : RESULT_OK));
+}
 
-    // Configures socket for specified socket connection ID, connection ID
-    char cmd[320];
-    sprintf(cmd, "AT#SCFG=%d,%d,%d,%d,%d,0",
-            conn_id, cid, pkt_size, inactivity_timeo, conn_timeo);
-    if (!getCommandOK(cmd)) {
+/** Loads a certificate or key into the modem for the SSL socket. The
+ *  modem stores it in non-volatile memory, so this is needed once, not on
+ *  every start. The SSL socket must be closed.
+ *
+ *  @param  type    SSL_CERT_CA, SSL_CERT_CLIENT or SSL_KEY_CLIENT.
+ *  @param  data    Certificate or key, PEM format.
+ *  @param  len     Number of bytes.
+ *  @return bool    True if the modem stored it.
+ */
+bool LTE_TCP::sslSetCertificate(int type, const uint8_t* data, size_t len) {
+    if ((type < SSL_CERT_CLIENT) || (type > SSL_KEY_CLIENT) ||
+        (data == NULL) || (len == 0) || onlineMode || !sslEnable())
+        return false;
+    if (!LTE_Command(this, "AT#SSLSECDATA").arg(SSL_ID).arg(1).arg(type)
+             .arg(len).send() ||
+        !receiveData(TIMEOUT_AUTO, 100) ||
+        (getResultCode() != RESULT_PROMPT)) {
         #ifdef DEBUG
-        debugPort->write(">> Socket configuration failed\r\n");
+        debugPort->write(">> Unexpected response from AT#SSLSECDATA\r\n");
         #endif
         return false;
     }
-    
-    // Activate PDP context
-    memset(cmd, '\0', 320);
-    sprintf(cmd, "AT#SGACT=%d,0", cid);
-    getCommandOK(cmd);
-    memset(cmd, '\0', 320);
-    sprintf(cmd, "AT#SGACT=%d,1", cid);
-    if (!sendATCommand(cmd) || !receiveData(2000, 100)) {
+    writePort(data, len);
+    return receiveData(TIMEOUT_AUTO, 100) && (getResultCode() == RESULT_OK);
+}
+
+/** Selects how the SSL socket authenticates. With SSL_AUTH_SERVER the
+ *  server certificate is checked against the CA certificate loaded with
+ *  sslSetCertificate(); SSL_AUTH_MUTUAL also sends the client certificate.
+ *  The SSL socket must be closed.
+ *
+ *  @param  mode    SSL_AUTH_NONE, SSL_AUTH_SERVER or SSL_AUTH_MUTUAL.
+ *  @return bool    True on success.
+ */
+bool LTE_TCP::sslSetAuthMode(int mode) {
+    if ((mode < SSL_AUTH_NONE) || (mode > SSL_AUTH_MUTUAL) || onlineMode ||
+        !sslEnable())
+        return false;
+    return LTE_Command(this, "AT#SSLSECCFG").arg(SSL_ID).arg(0).arg(mode)
+               .sendOK();
+}
+
+/** Sets whether the SSL socket keeps its TLS session when it is closed.
+ *  The next socketOpen() of SSL_CONN_ID to the same server then resumes
+ *  the session with an abbreviated handshake. Default is true.
+ *
+ *  @param  enable  False for a full handshake on every open.
+ *  @return void
+ */
+void LTE_TCP::setSSLSessionReuse(bool enable) {
+    sslReuse = enable;
+}
+
+/** Enables the modem's SSL engine with AT#SSLEN, once. The modem refuses
+ *  to enable it twice, so an ERROR is checked with the read command.
+ *
+ *  @return bool    True if enabled.
+ */
+bool LTE_TCP::sslEnable() {
+    if (sslEnabled) return true;
+    sslEnabled = LTE_Command(this, "AT#SSLEN").arg(SSL_ID).arg(1).sendOK() ||
+                 (LTE_Command(this, "AT#SSLEN").query().sendOK() &&
+                  (getInfoField(findInfo("#SSLEN: ", SSL_ID), 1) == 1));
+    return sslEnabled;
+}
+
+/** Turns the DNS cache on or off. While it is on, socketOpen() resolves
+ *  host names with resolveHost() and dials the IP address.
+ *
+ *  @param  enable  True to use the cache.
+ *  @param  ttl     Seconds a resolved address is used before the name is
+ *                  looked up again.
+ *  @return void
+ */
+void LTE_TCP::setDNSCache(bool enable, uint32_t ttl) {
+    dnsEnabled = enable;
+    dnsTTL = ttl;
+}
+
+/** Resolves a host name to an IPv4 address, from the DNS cache if it holds
+ *  a result younger than its time to live, otherwise with AT#QDNS. The
+ *  result is cached if the name is at most DNS_HOST_SIZE characters long;
+ *  the oldest entry makes room when the cache is full.
+ *
+ *  @param  host    Host name, or an IP address (copied unchanged).
+ *  @param  ip      Receives the address, at least 16 bytes.
+ *  @return bool    True on success.
+ */
+bool LTE_TCP::resolveHost(const char* host, char* ip) {
+    if ((host == NULL) || (host[0] == '\0') || (ip == NULL)) return false;
+    if (isIPAddress(host)) {
+        strcpy(ip, host);
+        return true;
+    }
+    DNSEntry* d = findDNS(host);
+    if (d != NULL) {
+        strcpy(ip, d->ip);
+        return true;
+    }
+    if (!queryDNS(host, ip)) return false;
+
+    if (strlen(host) <= DNS_HOST_SIZE) {
+        d = &dnsCache[0];
+        for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+            if (dnsCache[i].host[0] == '\0') {
+                d = &dnsCache[i];
+                break;
+            }
+            if ((int32_t) (dnsCache[i].time - d->time) < 0) d = &dnsCache[i];
+        }
+        strcpy(d->host, host);
+        strcpy(d->ip, ip);
+        d->time = millis();
+    }
+    return true;
+}
+
+/** Empties the DNS cache.
+ *
+ *  @return void
+ */
+void LTE_TCP::clearDNSCache() {
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) dnsCache[i].host[0] = '\0';
+}
+
+/** Returns the DNS cache entry of a host name, if its time to live has not
+ *  run out.
+ *
+ *  @param  host        Host name.
+ *  @return DNSEntry*   NULL if the name is not cached.
+ */
+LTE_TCP::DNSEntry* LTE_TCP::findDNS(const char* host) {
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DNSEntry* d = &dnsCache[i];
+        if ((d->host[0] == '\0') || (strcmp(d->host, host) != 0)) continue;
+        if ((millis() - d->time) / 1000 < dnsTTL) return d;
+        d->host[0] = '\0';     // Expired
+        return NULL;
+    }
+    return NULL;
+}
+
+/** Looks a host name up with AT#QDNS, which answers
+ *  #QDNS: "<host>","<ip>". The PDP context must be active for the query,
+ *  so it is activated if needed.
+ *
+ *  @param  host    Host name.
+ *  @param  ip      Receives the address, at least 16 bytes.
+ *  @return bool    True on success.
+ */
+bool LTE_TCP::queryDNS(const char* host, char* ip) {
+    if ((strlen(host) > 255) || onlineMode || !activateContext()) return false;
+
+    if (!LTE_Command(this, "AT#QDNS").quoted(host).send() ||
+        !receiveData(DNS_TIMEOUT, 100) ||
+        (getResultCode() != RESULT_OK))
+        return false;
+
+    // The address is between the third and fourth quote
+    char* info = findInfo("#QDNS: ");
+    int quotes = 0;
+    int n = 0;
+    for (char* p = info; (p != NULL) && (*p != '\r') && (*p != '\0'); p++) {
+        if (*p == '"') quotes++;
+        else if ((quotes == 3) && (n < 15)) ip[n++] = *p;
+    }
+    ip[n] = '\0';
+    if ((quotes < 4) || !isIPAddress(ip)) {
         #ifdef DEBUG
-        debugPort->write(">> PDP context failed when opening socket\r\n");
+        debugPort->write(">> DNS lookup failed\r\n");
         #endif
         return false;
     }
+    return true;
+}
 
-    // Get self IP from PDP context
-    if (!parseFind("#SGACT: "))
-        memset(hostIP, '\0', 40);
-    else {
-        strncpy(hostIP, getParsedData(), strlen(getParsedData()));
-        hostIP[strlen(getParsedData())] = '\0';
+/** Returns true if a host is a dotted decimal IPv4 address.
+ *
+ *  @param  host    Host name or address.
+ *  @return bool
+ */
+bool LTE_TCP::isIPAddress(const char* host) {
+    int dots = 0;
+    int digits = 0;
+    for (const char* p = host; *p != '\0'; p++) {
+        if (*p == '.') {
+            if (digits == 0) return false;
+            dots++;
+            digits = 0;
+        }
+        else if ((*p >= '0') && (*p <= '9') && (digits < 3)) digits++;
+        else return false;
     }
+    return (dots == 3) && (digits > 0);
+}
+
+/** Makes sure the modem is attached and the PDP context is active. Both
+ *  are cached, so once known to be up this sends no AT commands.
+ *
+ *  @return bool    True on success.
+ */
+bool LTE_TCP::activateContext() {
+    if (pdpActive) return true;
 
-    // Open socket
-    memset(cmd, '\0', 320);
-    sprintf(cmd, "AT#SD=%d,0,%d,%s,255,0,1", connectionID, remotePort, r_ip);
-    if (!getCommandOK(cmd) || !parseFind("OK")) {
+    if (!attached && !gprsAttach()) {
         #ifdef DEBUG
-        debugPort->write(">> Failed to open socket\r\n");
+        debugPort->write(">> GPRS attach failed when opening socket\r\n");
+        #endif
+        return false;
+    }
+
+    // Deactivate first, in case the context is active in an unknown state
+    LTE_Command(this, "AT#SGACT").arg(cid).arg(0).sendOK();
+    if (!LTE_Command(this, "AT#SGACT").arg(cid).arg(1).send() ||
+        !receiveData(TIMEOUT_AUTO, 100) ||
+        (getResultCode() != RESULT_OK)) {
+        #ifdef DEBUG
+        debugPort->write(">> PDP context failed when opening socket\r\n");
         #endif
+        attached = false;   // Checked again next time
+        return false;
+    }
+
+    // Get self IP from PDP context
+    memset(hostIP, '\0', 40);
+    char* ip = findInfo("#SGACT: ");
+    for (int i = 0; (ip != NULL) && (i < 39) && (ip[i] != '\r'); i++)
+        hostIP[i] = ip[i];
+    pdpActive = true;
+    return true;
+}
+
+/** Checks with AT#SGACT? whether the network deactivated the PDP context
+ *  that is cached as active, e.g. after a failed dial.
+ *
+ *  @return bool    True if the context is gone; the cache is cleared.
+ */
+bool LTE_TCP::contextLost() {
+    if (!getCommandOK("AT#SGACT?") ||
+        (getInfoField(findInfo("#SGACT: ", cid), 1) != 0))
         return false;
+    attached = false;
+    contextClosed();
+    return true;
+}
+
+/** Marks the PDP context inactive, along with every socket using it.
+ *
+ *  @return void
+ */
+void LTE_TCP::contextClosed() {
+    pdpActive = false;
+    for (int i = 0; i < NUM_SOCKETS; i++) {
+        if (sockets[i].status != 0) setStatus(&sockets[i], 0);
+        sockets[i].pendingBytes = 0;
+    }
+}
+
+/** Writes data to a socket in online data mode. The bytes go straight to
+ *  the serial port and may have any value.
+ *
+ *  @param  buf     Data to write.
+ *  @param  len     Number of bytes.
+ *  @return int     Number of bytes written. -1 if not in online mode.
+ */
+int LTE_TCP::onlineWrite(const char* buf, int len) {
+    if (!onlineMode || (buf == NULL) || (len < 0)) return -1;
+    int n = writePort((const uint8_t*) buf, len);
+    telitPort->flush();     // The escape guard time starts on the wire
+    lastOnlineWrite = millis();
+    return n;
+}
+
+/** Reads data from a socket in online data mode. Bytes that were already
+ *  received along with the CONNECT result code are returned first.
+ *
+ *  The "NO CARRIER" the modem sends when the remote host closes the socket
+ *  is not returned as data: it ends online mode and marks the socket
+ *  closed. Bytes that could be its start are held back until the rest
+ *  arrives, or until the line is idle for timeout, since the modem sends
+ *  it in one piece.
+ *
+ *  @param  buf         Destination buffer.
+ *  @param  len         Max bytes to read.
+ *  @param  timeout     Return after no data arrives for this long (ms).
+ *  @return int         Number of bytes read, those before "NO CARRIER" if
+ *                      it arrived. -1 if not in online mode.
+ */
+int LTE_TCP::onlineRead(char* buf, int len, uint32_t timeout) {
+    static const char noCarrier[] = "\r\nNO CARRIER\r\n";
+    if (!onlineMode || (buf == NULL) || (len < 0)) return -1;
+    int n = 0;
+    uint32_t startTime = millis();
+    while (n + carrierMatch < len) {
+        int c;
+        if (rxRing.available() > 0) c = rxRing.get();
+        else if (telitPort->available() > 0) c = telitPort->read();
+        else if ((millis() - startTime) > timeout) {
+            // Held bytes followed by silence were data
+            memcpy(buf + n, noCarrier, carrierMatch);
+            n += carrierMatch;
+            carrierMatch = 0;
+            break;
+        }
+        else continue;
+        startTime = millis();
+
+        if (c == noCarrier[carrierMatch]) {
+            if (++carrierMatch < (int) sizeof(noCarrier) - 1) continue;
+            #ifdef DEBUG
+            debugPort->write(">> Online socket closed by remote host\r\n");
+            #endif
+            carrierMatch = 0;
+            onlineMode = false;
+            setStatus(findSocket(connectionID), 0);
+            break;
+        }
+        memcpy(buf + n, noCarrier, carrierMatch);
+        n += carrierMatch;
+        carrierMatch = 0;
+        if (c == noCarrier[0]) carrierMatch = 1;
+        else buf[n++] = (char) c;
+    }
+    return n;
+}
+
+/** Leaves online data mode with the "+++" escape sequence, which the modem
+ *  only accepts after ESCAPE_GUARD_TIME of silence before and after it.
+ *  The socket stays connected (suspended) and can be used with
+ *  socketWrite()/socketReceive(), or taken back online with socketResume().
+ *  Data the remote host sends during the escape is discarded; read it
+ *  with onlineRead() first.
+ *
+ *  If the remote host closed the socket, the modem is already back in
+ *  command mode: its "NO CARRIER" is taken as the end of online mode, and
+ *  the socket is marked closed.
+ *
+ *  @return bool    True if the modem confirmed with OK, or had already
+ *                  left online mode.
+ */
+bool LTE_TCP::socketSuspend() {
+    if (!onlineMode) return false;
+
+    // Discard data still waiting, looking for "NO CARRIER" in it
+    char scratch[64];
+    while (onlineRead(scratch, sizeof(scratch), ESCAPE_DRAIN_TIME) > 0) {}
+    if (!onlineMode) return true;
+
+    uint32_t quiet = millis() - lastOnlineWrite;
+    if (quiet <= ESCAPE_GUARD_TIME) delay(ESCAPE_GUARD_TIME - quiet + 1);
+    writePort("+++");
+
+    // Skip socket data still in flight; stop at the OK after the guard time
+    onlineMode = false;
+    uint32_t startTime = millis();
+    while ((millis() - startTime) < (ESCAPE_GUARD_TIME + 1000)) {
+        expectResponse("+++");
+        if (receiveData(ESCAPE_GUARD_TIME + 1000, 100) &&
+            (getResultCode() == RESULT_OK)) {
+            setStatus(findSocket(connectionID), 2);     // Suspended
+            return true;
+        }
+        if (getResultCode() == RESULT_NO_CARRIER) {
+            // Closed before the escape; a modem in command mode ignores
+            // "+++", as it does not start with AT
+            setStatus(findSocket(connectionID), 0);
+            return true;
+        }
     }
-    socketStatus = getSocketStatus();
+    onlineMode = true;
+    #ifdef DEBUG
+    debugPort->write(">> Failed to leave online mode\r\n");
+    #endif
+    return false;
+}
+
+/** Takes a suspended socket back into online data mode with AT#SO.
+ *
+ *  @return bool    True once the modem reports CONNECT.
+ */
+bool LTE_TCP::socketResume() {
+    if (onlineMode) return false;
+    socketFlush(connectionID);
+    if (!LTE_Command(this, "AT#SO").arg(connectionID).send() ||
+        !receiveData(TIMEOUT_AUTO, 100) ||
+        (getResultCode() != RESULT_CONNECT))
+        return false;
+    onlineMode = true;
+    setStatus(findSocket(connectionID), 1);
+    lastOnlineWrite = millis();
     return true;
 }
 
-/** Returns true if socket is connected and ready to transmit data.
+/** Returns true while a socket is in online data mode.
+ *
+ *  @return bool
+ */
+bool LTE_TCP::isOnline() {
+    return onlineMode;
+}
+
+/** Returns the number of bytes waiting in the modem for the socket, as
+ *  reported by SRING notifications. Processes URCs that arrived since the
+ *  last command first, so it can be called from loop() to wait for data
+ *  without any AT command traffic.
+ *
+ *  @return int     Pending bytes. -1 if SRING notifications are not
+ *                  enabled, in which case only socketReceive() can tell.
+ */
+int LTE_TCP::socketAvailable() {
+    return socketAvailable(connectionID);
+}
+
+/** socketAvailable() for the socket at a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return int         Pending bytes. -1 if unknown.
+ */
+int LTE_TCP::socketAvailable(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if ((s == NULL) || !s->sringEnabled) return -1;
+    poll();
+    return s->pendingBytes;
+}
+
+/** Returns true if socket is connected and ready to transmit data. Uses
+ *  the cached socket state, which command results and URCs keep current,
+ *  and only queries the modem with AT#SS when the cache is invalid or
+ *  older than the bound set with setStatusMaxAge().
  *
  *  @return bool
  */
 bool LTE_TCP::socketReady() {
-    int x = getSocketStatus();
-    return ((x == 0) || (x == 6) || (x == 7)) ? false : true;
+    return socketReady(connectionID);
+}
+
+/** socketReady() for the socket at a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return bool
+ */
+bool LTE_TCP::socketReady(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if (s == NULL) return false;
+    int x = statusFresh(s) ? s->status : getSocketStatus(conn_id);
+    return ((x == 0) || (x == 6) || (x == 7) || (x == -1)) ? false : true;
+}
+
+/** Bounds how long the cached socket states are trusted. With the default
+ *  of 0 they are trusted until a command result or URC changes them.
+ *
+ *  @param  ms      Max age of the cached states in ms, 0 for no bound.
+ *  @return void
+ */
+void LTE_TCP::setStatusMaxAge(uint32_t ms) {
+    statusMaxAge = ms;
+}
+
+/** Returns true if a cached socket state can be used without AT#SS.
+ *
+ *  @param  s       Socket.
+ *  @return bool
+ */
+bool LTE_TCP::statusFresh(Socket* s) {
+    return s->statusValid &&
+           ((statusMaxAge == 0) || ((millis() - s->statusTime) <= statusMaxAge));
+}
+
+/** Updates a cached socket state.
+ *
+ *  @param  s       Socket.
+ *  @param  status  AT#SS state code, see getSocketStatus().
+ *  @return void
+ */
+void LTE_TCP::setStatus(Socket* s, int status) {
+    s->status = status;
+    s->statusTime = millis();
+    s->statusValid = true;
 }
 
 /** Queries the state of the TCP/IP socket at the connection ID. Updates
@@ -183,161 +816,643 @@ bool LTE_TCP::socketReady() {
  *  @return int     Current socket state. -1 for error.
  */
 int LTE_TCP::getSocketStatus() {
-    getCommandOK("AT#SS");
-    char match[8];
-    sprintf(match, "#SS: %d,", connectionID);
-    if (parseFind(match)) {
-        socketStatus = (getParsedData())[0] - '0';
-        #ifdef DEBUG
-        debugPort->write(">> Socket status code: ");
-        debugPort->write(socketStatus);
-        debugPort->write("\r\n");
-        #endif
-        return socketStatus;
+    return getSocketStatus(connectionID);
+}
+
+/** getSocketStatus() for the socket at a connection ID. AT#SS lists every
+ *  socket, so the cached states of all of them are updated. The SSL
+ *  socket is queried with AT#SSLS and reports 0 or 2 (3 with data).
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return int         Current socket state. -1 for error.
+ */
+int LTE_TCP::getSocketStatus(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if (s == NULL) return -1;
+    if (conn_id == SSL_CONN_ID) {
+        // "#SSLS: 1,<state>", 2 when connected
+        if (!LTE_Command(this, "AT#SSLS").arg(SSL_ID).sendOK() ||
+            (findInfo("#SSLS: ", SSL_ID) == NULL)) {
+            s->statusValid = false;
+            return -1;
+        }
+        bool connected = (getInfoField(findInfo("#SSLS: ", SSL_ID), 1) == 2);
+        setStatus(s, !connected ? 0 : (s->pendingBytes > 0) ? 3 : 2);
+        return s->status;
     }
-    else return -1;
+    if (!getCommandOK("AT#SS") || (findInfo("#SS: ", conn_id) == NULL)) {
+        s->statusValid = false;
+        return -1;
+    }
+    for (int id = 1; id <= MAX_SOCKETS; id++) {
+        long status = getInfoField(findInfo("#SS: ", id), 1);
+        if (status >= 0) setStatus(findSocket(id), status);
+    }
+    #ifdef DEBUG
+    debugPort->write(">> Socket status code: ");
+    debugPort->write(s->status);
+    debugPort->write("\r\n");
+    #endif
+    return s->status;
 }
 
-/** Wrapper function for writing data to the modem's serial port. Makes use
- *  of the AT#SSEND command.
+/** Wrapper function for writing a string to the TCP socket. See
+ *  socketWrite(const uint8_t*, size_t).
  *
  *  @param  str     String to write.
  *  @return int     Number of bytes written. -1 on error.
  */
 int LTE_TCP::socketWrite(char* str) {
+    if (str == NULL) return -1;
+    return socketWrite((const uint8_t*) str, strlen(str));
+}
+
+/** Writes binary data to the TCP socket. Makes use of the AT#SSENDEXT
+ *  command, which takes an explicit byte count instead of a Ctrl-Z
+ *  terminator, so buf may contain any byte value including 0x00 and 0x1A.
+ *  Data longer than MAX_SSEND_SIZE is sent with several commands. Data
+ *  buffered by socketBufferWrite() is sent first.
+ *
+ *  @param  buf     Data to write.
+ *  @param  len     Number of bytes.
+ *  @return int     Number of bytes written. -1 on error.
+ */
+int LTE_TCP::socketWrite(const uint8_t* buf, size_t len) {
+    return socketWrite(connectionID, buf, len);
+}
+
+/** socketWrite() for the socket at a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  buf         Data to write.
+ *  @param  len         Number of bytes.
+ *  @return int         Number of bytes written. -1 on error.
+ */
+int LTE_TCP::socketWrite(int conn_id, const uint8_t* buf, size_t len) {
     #ifdef DEBUG
     debugPort->write(">> Writing to socket ...\r\n");
     #endif
 
-    if (!socketReady()) {
+    if ((buf == NULL) || onlineMode || !socketReady(conn_id)) {
         #ifdef DEBUG
         debugPort->write(">> Socket write failed, socket not ready\r\n");
         #endif
         return -1;
     }
+    if (!socketFlush(conn_id)) return -1;
+
+    size_t written = 0;
+    size_t max = (conn_id == SSL_CONN_ID) ? MAX_SSLSEND_SIZE : MAX_SSEND_SIZE;
+    while (written < len) {
+        size_t n = len - written;
+        if (n > max) n = max;
+        if (!sendPacket(conn_id, buf + written, n))
+            return (written > 0) ? (int) written : -1;
+        written += n;
+    }
+    return written;
+}
+
+/** Adds data to the socket's write buffer instead of sending it right
+ *  away. Small writes are merged, and a packet goes out with one
+ *  AT#SSENDEXT whenever packet_size bytes (see socketOpen()) have been
+ *  collected. Call socketFlush() to send a partial packet; socketReceive()
+ *  and socketClose() flush automatically.
+ *
+ *  @param  buf     Data to write. May contain any byte value.
+ *  @param  len     Number of bytes.
+ *  @return int     Number of bytes accepted. -1 on error.
+ */
+int LTE_TCP::socketBufferWrite(const uint8_t* buf, size_t len) {
+    return socketBufferWrite(connectionID, buf, len);
+}
+
+/** socketBufferWrite() for the socket at a connection ID. Each socket has
+ *  its own write buffer. If a packet fails part way through the data, the
+ *  bytes before it are still reported as accepted.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  buf         Data to write.
+ *  @param  len         Number of bytes.
+ *  @return int         Number of bytes accepted. -1 if none were.
+ */
+int LTE_TCP::socketBufferWrite(int conn_id, const uint8_t* buf, size_t len) {
+    if ((buf == NULL) || onlineMode || !socketReady(conn_id)) return -1;
+    Socket* s = findSocket(conn_id);
+    if (s->sendBuf == NULL) {
+        s->sendBuf = (uint8_t*) malloc(MAX_SSEND_SIZE);
+        if (s->sendBuf == NULL) return -1;
+    }
 
-    char cmd[12];
-    sprintf(cmd, "AT#SSEND=%d", connectionID);
-    sendATCommand(cmd);
-    receiveData(2000, 100);
-    if (!parseFind(">")) {
+    size_t written = 0;
+    while (written < len) {
+        // Whole packets skip the copy when nothing is buffered
+        if ((s->sendLen == 0) && (len - written >= (size_t) s->packetSize)) {
+            if (!sendPacket(conn_id, buf + written, s->packetSize))
+                return (written > 0) ? (int) written : -1;
+            written += s->packetSize;
+            continue;
+        }
+        size_t n = s->packetSize - s->sendLen;
+        if (n > len - written) n = len - written;
+        memcpy(s->sendBuf + s->sendLen, buf + written, n);
+        s->sendLen += n;
+        if ((s->sendLen == (uint32_t) s->packetSize) && !socketFlush(conn_id))
+            return (written > 0) ? (int) written : -1;
+        written += n;
+    }
+    return written;
+}
+
+/** Sends the data collected by socketBufferWrite(). The buffer is emptied
+ *  even if sending fails.
+ *
+ *  @return bool    True if the buffer was empty or its data was sent.
+ */
+bool LTE_TCP::socketFlush() {
+    return socketFlush(connectionID);
+}
+
+/** socketFlush() for the socket at a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return bool        True if the buffer was empty or its data was sent.
+ */
+bool LTE_TCP::socketFlush(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if (s == NULL) return false;
+    if (s->sendLen == 0) return true;
+    uint32_t len = s->sendLen;
+    s->sendLen = 0;
+    return sendPacket(conn_id, s->sendBuf, len);
+}
+
+/** Sends one AT#SSENDEXT packet of at most MAX_SSEND_SIZE bytes, or an
+ *  AT#SSLSENDEXT packet of at most MAX_SSLSEND_SIZE on the SSL socket.
+ *  Given an address, sends an AT#SSENDUDPEXT datagram there instead.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  buf         Data to write.
+ *  @param  len         Number of bytes.
+ *  @param  ip          Destination of a UDP datagram, NULL for the remote
+ *                      host the socket was opened to.
+ *  @param  port        Destination port, with ip.
+ *  @return bool        True if the modem accepted the data.
+ */
+bool LTE_TCP::sendPacket(int conn_id, const uint8_t* buf, size_t len,
+                         const char* ip, int port) {
+    bool sent;
+    if (conn_id == SSL_CONN_ID)
+        sent = LTE_Command(this, "AT#SSLSENDEXT").arg(SSL_ID).arg(len).send();
+    else if (ip != NULL)
+        sent = LTE_Command(this, "AT#SSENDUDPEXT").arg(conn_id).arg(len)
+                   .quoted(ip).arg(port).send();
+    else
+        sent = LTE_Command(this, "AT#SSENDEXT").arg(conn_id).arg(len).send();
+    if (!sent ||
+        !receiveData(TIMEOUT_AUTO, 100) ||
+        (getResultCode() != RESULT_PROMPT)) {
         #ifdef DEBUG
-        debugPort->write(">> Write failed, unexpected response from AT#SSEND");
+        debugPort->write(">> Write failed, unexpected response from AT#SSENDEXT\r\n");
         #endif
-        return -1;  // Timeout, AT#SSEND did not have expected response
+        findSocket(conn_id)->statusValid = false;
+        return false;   // Timeout, AT#SSENDEXT did not have expected response
     }
 
-    telitPort->write(str);
-    telitPort->write((char) 26);    // End AT#SSEND
-    receiveData(500, 100);
-    
-    if (parseFind("OK"))
-        return strlen(str);
-    else return -1;
+    // The modem takes exactly len bytes after the prompt
+    writePort(buf, len);
+    receiveData(TIMEOUT_AUTO, 100);
+    if (getResultCode() == RESULT_OK) return true;
+    findSocket(conn_id)->statusValid = false;   // The socket may have closed
+    return false;
 }
 
 /** Attempts to receive data from the TCP socket and store it in the receive
- *  buffer. If at any point there is an error, -1 is returned, and partially
- *  received data is saved. This function makes use of the AT#SRECV command.
- *
- *  TODO: There is a bug where if the buffer size of the LTE_Base class is
- *  much smaller than the AT#SRECV buffer, we lose some amount of data.
- *  Workaround is to have LTE_Base have a buffer larger than 1500 bytes
- *  (max bytes AT#SRECV can read at once).
+ *  buffer (see getReceivedData()). The buffer is allocated once, on first
+ *  use, and holds at most RECV_BUF_SIZE bytes; data beyond that stays in
+ *  the modem for the next call. If at any point there is an error, -1 is
+ *  returned, and partially received data is saved.
  * 
  *  @return int     Number of bytes received. -1 on error.
  */
 int LTE_TCP::socketReceive() {
+    Socket* s = findSocket(connectionID);
+    if (s->receiveBuf == NULL) {
+        s->receiveBuf = (char*) malloc(RECV_BUF_SIZE + 1);
+        if (s->receiveBuf == NULL) return -1;
+    }
+    s->receiveBuf[0] = '\0';
+    s->recvSize = 0;
+
+    int n = socketReceive(connectionID, s->receiveBuf, RECV_BUF_SIZE);
+    if (n > 0) s->recvSize = n;
+    s->receiveBuf[s->recvSize] = '\0';
+    return n;
+}
+
+/** Returns the data stored by socketReceive() for a socket.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return char*       NUL terminated data, "" if there is none.
+ */
+char* LTE_TCP::getReceivedData(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if ((s == NULL) || (s->receiveBuf == NULL)) return (char*) "";
+    return s->receiveBuf;
+}
+
+/** Returns the remote host a socket was last opened to.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return const char* Host as given to socketOpen(), "" if none.
+ */
+const char* LTE_TCP::getRemoteHost(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    return (s == NULL) ? "" : s->remoteIP;
+}
+
+/** Returns the remote port a socket was last opened to.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return int         Port, -1 if conn_id is out of range.
+ */
+int LTE_TCP::getRemotePort(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    return (s == NULL) ? -1 : s->remotePort;
+}
+
+/** Returns the packet size a socket was last opened with: the most data
+ *  one AT#SSENDEXT from socketBufferWrite() carries.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return int         Packet size in bytes, -1 if conn_id is out of range.
+ */
+int LTE_TCP::getPacketSize(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    return (s == NULL) ? -1 : s->packetSize;
+}
+
+/** Returns true if a socket was last opened with socketOpenUDP().
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return bool
+ */
+bool LTE_TCP::isUDP(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    return (s != NULL) && s->udp;
+}
+
+/** Sends one datagram from a UDP socket to any address with
+ *  AT#SSENDUDPEXT, e.g. a reply to the sender reported by
+ *  socketReceiveFrom(). Data buffered by socketBufferWrite() is sent first.
+ *
+ *  @param  conn_id     Connection ID (1-6) of a socket opened with
+ *                      socketOpenUDP().
+ *  @param  buf         Datagram payload.
+ *  @param  len         Number of bytes, at most MAX_SSEND_SIZE.
+ *  @param  ip          Destination IP address.
+ *  @param  port        Destination port.
+ *  @return int         Number of bytes sent. -1 on error.
+ */
+int LTE_TCP::socketSendTo(int conn_id, const uint8_t* buf, size_t len,
+                          const char* ip, int port) {
+    if ((buf == NULL) || (len == 0) || (len > MAX_SSEND_SIZE) ||
+        (ip == NULL) || (port < 1) || (port > 65535) || !isUDP(conn_id) ||
+        onlineMode || !socketReady(conn_id) || !socketFlush(conn_id))
+        return -1;
+    return sendPacket(conn_id, buf, len, ip, port) ? (int) len : -1;
+}
+
+/** Receives one datagram from a UDP socket, with AT#SRECV asking for the
+ *  sender's address. A datagram longer than len is cut off: the rest is
+ *  read and discarded, so the next call starts at the next datagram.
+ *
+ *  @param  conn_id     Connection ID (1-6) of a socket opened with
+ *                      socketOpenUDP().
+ *  @param  buf         Destination buffer.
+ *  @param  len         Size of buf.
+ *  @param  ip          Receives the sender's IP address, at least 16
+ *                      bytes, or NULL.
+ *  @param  port        Receives the sender's port, or NULL.
+ *  @return int         Number of bytes stored in buf, 0 if no datagram is
+ *                      waiting. -1 on error.
+ */
+int LTE_TCP::socketReceiveFrom(int conn_id, char* buf, int len, char* ip,
+                               int* port) {
+    Socket* s = findSocket(conn_id);
+    if ((buf == NULL) || (len <= 0) || !isUDP(conn_id) || onlineMode ||
+        !socketReady(conn_id))
+        return -1;
+    socketFlush(conn_id);
+    if (s->sringEnabled) {
+        poll();
+        if (s->pendingBytes == 0) return 0;
+    }
+
+    RecvCopy copy;
+    copy.buf = buf;
+    copy.size = len;
+    copy.len = 0;
+    recvHandler = copyReceived;
+    recvContext = &copy;
+    recvLen = 0;
+    int requested = (len < MAX_SRECV_SIZE) ? len : MAX_SRECV_SIZE;
+    bool received = LTE_Command(this, "AT#SRECV").arg(conn_id).arg(requested)
+                        .arg(1).send() && receiveData(TIMEOUT_AUTO, 100);
+    LTE_METRIC(uint32_t srecvs = 1);
+
+    // "#SRECV: <sourceIP>,<sourcePort>,<connId>,<recData>,<dataLeft>"
+    char* info = findInfo("#SRECV: ");
+    long left = received ? getInfoField(info, 4) : -1;
+    if (received && (info != NULL)) {
+        if (ip != NULL) {
+            int i = 0;
+            for (char* p = info; (*p != ',') && (*p >= ' ') && (i < 15); p++)
+                if (*p != '"') ip[i++] = *p;
+            ip[i] = '\0';
+        }
+        if (port != NULL) *port = getInfoField(info, 1);
+    }
+
+    // Discard the part of the datagram that did not fit
+    RecvCopy discard;
+    discard.buf = buf;
+    discard.size = 0;
+    discard.len = 0;
+    recvContext = &discard;
+    while (left > 0) {
+        int n = (left < MAX_SRECV_SIZE) ? left : MAX_SRECV_SIZE;
+        if (!LTE_Command(this, "AT#SRECV").arg(conn_id).arg(n).arg(1).send() ||
+            !receiveData(TIMEOUT_AUTO, 100))
+            break;
+        LTE_METRIC(srecvs++);
+        left = getInfoField(findInfo("#SRECV: "), 4);
+    }
+    recvHandler = NULL;
+
+    s->pendingBytes = (recvLen < s->pendingBytes) ?
+                      s->pendingBytes - recvLen : 0;
+    if ((s->status == 3) && (s->pendingBytes == 0)) setStatus(s, 2);
+    #ifdef LTE_METRICS
+    metrics.receives++;
+    metrics.srecvCommands += srecvs;
+    if (srecvs > metrics.srecvMax) metrics.srecvMax = srecvs;
+    #endif
+    return received ? (int) copy.len : -1;
+}
+
+/** Receives up to len bytes from the TCP socket into a caller-provided
+ *  buffer. The buffer is not NUL terminated, and may receive any byte
+ *  value.
+ *
+ *  @param  buf     Destination buffer.
+ *  @param  len     Size of buf. No more than len bytes are requested from
+ *                  the modem, so nothing is lost if more data is pending.
+ *  @return int     Number of bytes received. -1 on error.
+ */
+int LTE_TCP::socketReceive(char* buf, int len) {
+    return socketReceive(connectionID, buf, len);
+}
+
+/** socketReceive(char*, int) for the socket at a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  buf         Destination buffer.
+ *  @param  len         Size of buf.
+ *  @return int         Number of bytes received. -1 on error.
+ */
+int LTE_TCP::socketReceive(int conn_id, char* buf, int len) {
+    if ((buf == NULL) || (len <= 0)) return -1;
+    RecvCopy copy;
+    copy.buf = buf;
+    copy.size = len;
+    copy.len = 0;
+    return socketReceive(conn_id, copyReceived, &copy, len);
+}
+
+/** Receives data from the TCP socket and streams it to handler in chunks,
+ *  as it comes off the UART. Chunks point into LTE_Base's receive ring
+ *  buffer and are only valid during the call, so data of any size flows
+ *  through in constant memory.
+ *
+ *  AT#SRECV is repeated while the modem fills each request completely, and
+ *  the function returns as soon as the modem reports less data than asked
+ *  for (i.e. nothing more is pending), or maxBytes have been received.
+ *  After the remote host closed the socket, what it sent before closing
+ *  can still be received.
+ *
+ *  @param  handler     Called with each chunk of socket data.
+ *  @param  context     Passed to handler unchanged.
+ *  @param  maxBytes    Max bytes to receive, 0 for no limit.
+ *  @return int         Number of bytes received. -1 on error.
+ */
+int LTE_TCP::socketReceive(SocketDataHandler handler, void* context,
+                           int maxBytes) {
+    return socketReceive(connectionID, handler, context, maxBytes);
+}
+
+/** socketReceive(SocketDataHandler, void*, int) for the socket at a
+ *  connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  handler     Called with each chunk of socket data.
+ *  @param  context     Passed to handler unchanged.
+ *  @param  maxBytes    Max bytes to receive, 0 for no limit.
+ *  @return int         Number of bytes received. -1 on error.
+ */
+int LTE_TCP::socketReceive(int conn_id, SocketDataHandler handler,
+                           void* context, int maxBytes) {
     #ifdef DEBUG
     debugPort->write(">> Reading from socket ...\r\n");
     #endif
-    if (socketStatus == 0) {
+    // A socket the remote host closed is read until its data is gone
+    Socket* s = findSocket(conn_id);
+    if ((handler == NULL) || (maxBytes < 0) || onlineMode || (s == NULL) ||
+        (!socketReady(conn_id) && (s->pendingBytes == 0))) {
         #ifdef DEBUG
         debugPort->write(">> Socket receive failed, socket not ready\r\n");
         #endif
         return -1;
     }
-
-    if (receiveBuf != NULL) {
-        receiveBuf = NULL;
-    }
-    
-    int currentBufSize = MAX_SRECV_SIZE;
-    receiveBuf = (char*) malloc(currentBufSize * sizeof(char));
+    socketFlush(conn_id);   // Buffered requests go out before the replies
+    bool secure = (conn_id == SSL_CONN_ID);
 
     int totalBytesReceived = 0;
-    char cmd[16];
-    sprintf(cmd, "AT#SRECV=%d,%d", connectionID, MAX_SRECV_SIZE);
-    char tofind[16];
-    sprintf(tofind, "#SRECV: %d,", connectionID);
-
-    // Keep sending AT#SRECV requests until all packets read
-    while (true) {
-        if (!sendATCommand(cmd) || !receiveData(2000, 100) ||
-            !parseFind(tofind))
-            break;
-
-        int recPacketSize = (atoi(strsep(&parsedData, "\r\n")));
-        int packetBytesLeft = recPacketSize;
-        parsedData[-1] = '\r';
-        parsedData += 1;    // points to char after "\n" 
-
-        // Reallocate and leave room for terminating null byte
-        if (totalBytesReceived + recPacketSize >= currentBufSize - 1) {
-            realloc(receiveBuf, currentBufSize*2);
+    LTE_METRIC(uint32_t srecvs = 0);
+    while ((maxBytes == 0) || (totalBytesReceived < maxBytes)) {
+        // With SRING, read only what the modem reported, in exact sizes
+        if (s->sringEnabled) {
+            poll();
+            if (s->pendingBytes == 0) break;
         }
+        int requested = secure ? MAX_SSLRECV_SIZE : MAX_SRECV_SIZE;
+        if (s->sringEnabled && (s->pendingBytes < (uint32_t) requested))
+            requested = s->pendingBytes;
+        if ((maxBytes != 0) && (maxBytes - totalBytesReceived < requested))
+            requested = maxBytes - totalBytesReceived;
+        recvHandler = handler;
+        recvContext = context;
+        recvLen = 0;
+        bool received = (secure ?
+            LTE_Command(this, "AT#SSLRECV").arg(SSL_ID).arg(requested).send() :
+            LTE_Command(this, "AT#SRECV").arg(conn_id).arg(requested).send()) &&
+            receiveData(TIMEOUT_AUTO, 100);
+        recvHandler = NULL;
+        LTE_METRIC(srecvs++);
+        totalBytesReceived += recvLen;
+        s->pendingBytes = (recvLen < s->pendingBytes) ?
+                          s->pendingBytes - recvLen : 0;
 
-        // In case the internal LTE_Base buffer is smaller than the TCP receive
-        // buffer, we need to ask the Base to read multiple times to process
-        // the entire AT#SRECV response.
-        if ((BASE_BUF_SIZE - (parsedData - data)) >= recPacketSize) {
-            memcpy(receiveBuf + totalBytesReceived, parsedData, recPacketSize);
-            totalBytesReceived += recPacketSize;
-            packetBytesLeft -= recPacketSize;
-        }
-        else {
-            memcpy(receiveBuf + totalBytesReceived, parsedData,
-                   (BASE_BUF_SIZE - (parsedData - data)));
-            totalBytesReceived += (BASE_BUF_SIZE - (parsedData - data));
-            packetBytesLeft -= (BASE_BUF_SIZE - (parsedData - data));
-            
-            while (packetBytesLeft > 0) {
-                if (!receiveData(500, 100)) {
-                    return -1;
-                }
-                
-                if (packetBytesLeft > BASE_BUF_SIZE) {
-                    memcpy(receiveBuf + totalBytesReceived, data, recDataSize);
-                    totalBytesReceived += recDataSize;
-                    packetBytesLeft -= recDataSize;
-                }
-                else {
-                    memcpy(receiveBuf + totalBytesReceived, data,
-                           packetBytesLeft);
-                    totalBytesReceived += packetBytesLeft;
-                    packetBytesLeft = 0;
-                }
-            }
-        }
+        int reported = secure ? getInfoField(findInfo("#SSLRECV: "), 0) :
+                       getInfoField(findInfo("#SRECV: ", conn_id), 1);
+        if (!received || (reported < requested))
+            break;  // Error, or no more data pending in the modem
     }
-    receiveBuf[totalBytesReceived] = '\0';
+    if ((s->status == 3) && (s->pendingBytes == 0)) setStatus(s, 2);
 
+    #ifdef LTE_METRICS
+    if (srecvs > 0) {
+        metrics.receives++;
+        metrics.srecvCommands += srecvs;
+        if (srecvs > metrics.srecvMax) metrics.srecvMax = srecvs;
+    }
+    #endif
     return totalBytesReceived;
 }
 
-/** Closes socket and closes PDP context.
+/** Sets the handler serviceSockets() passes a socket's data to.
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @param  handler     Called with each chunk of socket data. NULL stops
+ *                      servicing the socket.
+ *  @param  context     Passed to handler unchanged.
+ *  @return bool        False for an invalid connection ID.
+ */
+bool LTE_TCP::setReceiveHandler(int conn_id, SocketDataHandler handler,
+                                void* context) {
+    Socket* s = findSocket(conn_id);
+    if (s == NULL) return false;
+    s->dataHandler = handler;
+    s->dataContext = context;
+    return true;
+}
+
+/** Services every open socket that has a receive handler, for use from
+ *  loop(). Buffered writes are flushed, and each socket with pending data
+ *  gets at most one AT#SRECV of MAX_SRECV_SIZE bytes per call. The socket
+ *  served first rotates between calls, so a busy socket cannot starve the
+ *  others of the UART.
+ *
+ *  @return int     Number of bytes passed to handlers.
+ */
+int LTE_TCP::serviceSockets() {
+    if (onlineMode) return 0;
+    poll();
+    int total = 0;
+    for (int i = 0; i < NUM_SOCKETS; i++) {
+        int id = ((nextService + i) % NUM_SOCKETS) + 1;
+        Socket* s = findSocket(id);
+        if ((s->dataHandler == NULL) ||
+            ((s->status == 0) && (s->pendingBytes == 0)))
+            continue;
+        socketFlush(id);
+        if (s->sringEnabled && (s->pendingBytes == 0)) continue;
+        int n = socketReceive(id, s->dataHandler, s->dataContext,
+                              (id == SSL_CONN_ID) ? MAX_SSLRECV_SIZE :
+                                                    MAX_SRECV_SIZE);
+        if (n > 0) total += n;
+    }
+    nextService = (nextService + 1) % NUM_SOCKETS;
+    return total;
+}
+
+/** URCHandler for "SRING: <connId>,<recData>". Records how many bytes are
+ *  pending on the socket; recData is the total the modem holds.
+ */
+void LTE_TCP::onSRING(const char* line, uint32_t len, void* context) {
+    LTE_TCP* tcp = (LTE_TCP*) context;
+    const char* info = line + 7;    // After "SRING: "
+
+    // A UDP socket may put the sender first: "<ip>,<port>,<connId>,<bytes>"
+    int field = 0;
+    int commas = 0;
+    for (const char* p = info; p < line + len; p++) commas += (*p == ',');
+    if (commas == 3) field = 2;
+    Socket* s = tcp->findSocket(tcp->getInfoField(info, field));
+    if (s == NULL) return;
+    long pending = tcp->getInfoField(info, field + 1);
+    if (pending >= 0) s->pendingBytes = pending;
+    if (s->status == 2) tcp->setStatus(s, 3);
+}
+
+/** URCHandler for "NO CARRIER: <connId>,<cause>", sent when the remote
+ *  host or the network closes a socket. Data the modem still holds for the
+ *  socket stays pending, for socketReceive() to read.
+ */
+void LTE_TCP::onNoCarrier(const char* line, uint32_t len, void* context) {
+    LTE_TCP* tcp = (LTE_TCP*) context;
+    Socket* s = tcp->findSocket(tcp->getInfoField(line + 12, 0));
+    if (s == NULL) return;
+    tcp->setStatus(s, 0);
+}
+
+/** URCHandler for "SSLSRING: <SSId>,<dataLen>", the SRING of the SSL
+ *  socket.
+ */
+void LTE_TCP::onSSLSRING(const char* line, uint32_t len, void* context) {
+    LTE_TCP* tcp = (LTE_TCP*) context;
+    const char* info = line + 10;   // After "SSLSRING: "
+    if (tcp->getInfoField(info, 0) != SSL_ID) return;
+    Socket* s = tcp->findSocket(SSL_CONN_ID);
+    long pending = tcp->getInfoField(info, 1);
+    if (pending >= 0) s->pendingBytes = pending;
+    if (s->status == 2) tcp->setStatus(s, 3);
+}
+
+/** SocketDataHandler used by socketReceive(char*, int). Copies each chunk
+ *  into the RecvCopy buffer given as context.
+ */
+void LTE_TCP::copyReceived(const char* buf, uint32_t len, void* context) {
+    RecvCopy* copy = (RecvCopy*) context;
+    if (len > copy->size - copy->len) len = copy->size - copy->len;
+    memcpy(copy->buf + copy->len, buf, len);
+    copy->len += len;
+}
+
+/** Closes the socket opened last. The PDP context stays active.
  *
  *  @return bool    True on success.
  */
 bool LTE_TCP::socketClose() {
-    char cmd[20];
-    sprintf(cmd, "AT#SH=%d", connectionID);
-    getCommandOK(cmd);
-    memset(cmd, '\0', 20);
-    sprintf(cmd, "AT#SGACT=%d,0", cid);
-    getCommandOK(cmd);
-    if (getSocketStatus() == 0) {
+    return socketClose(connectionID);
+}
+
+/** Closes the socket at a connection ID. The PDP context stays active
+ *  for the next socketOpen(); see pdpDeactivate().
+ *
+ *  @param  conn_id     Connection ID (1-6).
+ *  @return bool        True on success.
+ */
+bool LTE_TCP::socketClose(int conn_id) {
+    Socket* s = findSocket(conn_id);
+    if (s == NULL) return false;
+    if (onlineMode) {
+        if ((conn_id != connectionID) || !socketSuspend()) return false;
+    }
+    if (s->status != 0) socketFlush(conn_id);
+
+    bool closed = (conn_id == SSL_CONN_ID) ?
+        LTE_Command(this, "AT#SSLH").arg(SSL_ID).sendOK() :
+        LTE_Command(this, "AT#SH").arg(conn_id).sendOK();
+    if (closed) {
+        setStatus(s, 0);
+        s->pendingBytes = 0;
+    }
+    else s->statusValid = false;
+    if ((statusFresh(s) ? s->status : getSocketStatus(conn_id)) == 0) {
+        #ifdef DEBUG
         debugPort->write(">> Socket closed.\r\n");
+        #endif
         return true;
     }
     #ifdef DEBUG
@@ -346,6 +1461,29 @@ bool LTE_TCP::socketClose() {
     return false;
 }
 
+/** Deactivates the PDP context, which closes every socket. socketClose()
+ *  leaves the context active so that the next socketOpen() only has to
+ *  dial; call this to release it, e.g. before the modem goes to sleep.
+ *
+ *  @return bool    True on success.
+ */
+bool LTE_TCP::pdpDeactivate() {
+    if (onlineMode) return false;
+    if (!LTE_Command(this, "AT#SGACT").arg(cid).arg(0).sendOK()) return false;
+    contextClosed();
+    return true;
+}
+
+/** Returns the socket state of a connection ID.
+ *
+ *  @param  conn_id     Connection ID (1-6), or SSL_CONN_ID.
+ *  @return Socket*     NULL if conn_id is out of range.
+ */
+LTE_TCP::Socket* LTE_TCP::findSocket(int conn_id) {
+    if ((conn_id < 1) || (conn_id > NUM_SOCKETS)) return NULL;
+    return &sockets[conn_id - 1];
+}
+
 /** Resets private variables to their default values.
  *
  *  @return void
@@ -358,15 +1496,52 @@ void LTE_TCP::reset() {
     connectionID = DEFAULT_CONN_ID;
     cid = DEFAULT_CID;
     memset(hostIP, '\0', 40);
-    memset(remoteIP, '\0', 256);
-    remotePort = 80;
-    socketStatus = 0;
-    
-    if (receiveBuf != NULL) {
-        free(receiveBuf);
-        receiveBuf = NULL;
+    attached = false;
+    pdpActive = false;
+    dnsEnabled = false;
+    dnsTTL = DNS_DEFAULT_TTL;
+    clearDNSCache();
+    statusMaxAge = 0;
+    nextService = 0;
+    sslEnabled = false;
+    sslReuse = true;
+
+    for (int i = 0; i < NUM_SOCKETS; i++) {
+        Socket* s = &sockets[i];
+        memset(s->remoteIP, '\0', 256);
+        s->remotePort = 80;
+        s->status = 0;
+        s->statusValid = false;
+        s->statusTime = 0;
+        s->packetSize = 300;
+        s->configured = false;
+        s->inactivityTimeout = 0;
+        s->connTimeout = 0;
+        s->extConfigured = false;
+        s->udp = false;
+        s->localPort = 0;
+        if (s->sendBuf != NULL) {
+            free(s->sendBuf);
+            s->sendBuf = NULL;
+        }
+        s->sendLen = 0;
+        if (s->receiveBuf != NULL) {
+            free(s->receiveBuf);
+            s->receiveBuf = NULL;
+        }
+        s->recvSize = 0;
+        s->sringEnabled = false;
+        s->pendingBytes = 0;
+        s->dataHandler = NULL;
+        s->dataContext = NULL;
     }
-    recvSize = 0;
+
+    recvHandler = NULL;
+    recvContext = NULL;
+    recvLen = 0;
+    lastOnlineWrite = 0;
+    carrierMatch = 0;
+    onlineMode = false;
 }
 
 /** Connects to the GPRS network. If already connected, returns true.
@@ -379,12 +1554,62 @@ bool LTE_TCP::gprsAttach() {
     #endif
 
     getCommandOK("AT+CGATT?");
-    if (!parseFind("1")) {
-        return getCommandOK("AT+CGATT=1");
+    if (getInfoField(findInfo("+CGATT: "), 0) != 1) {
+        attached = getCommandOK("AT+CGATT=1");
+        return attached;
     }
+    attached = true;
     return true;
 }
 
+/** Returns the length of the socket data that follows an AT#SRECV response
+ *  line ("#SRECV: <connId>,<len>", or with the sender of a UDP datagram
+ *  "#SRECV: <ip>,<port>,<connId>,<len>,<left>") or an AT#SSLRECV one
+ *  ("#SSLRECV: <len>"), so that receiveData() does not look for result
+ *  codes inside received socket data.
+ *
+ *  @param  line        Start of the response line.
+ *  @param  len         Length of the line.
+ *  @return uint32_t    Socket data bytes following the line.
+ */
+uint32_t LTE_TCP::payloadLength(const char* line, uint32_t len) {
+    const char* p;
+    if ((len > 10) && (memcmp(line, "#SSLRECV: ", 10) == 0))
+        p = line + 10;      // "#SSLRECV: <len>"
+    else if ((len >= 10) && (memcmp(line, "#SRECV: ", 8) == 0)) {
+        int commas = 0;
+        for (p = line; p < line + len; p++) commas += (*p == ',');
+        int field = (commas == 4) ? 3 : 1;
+        for (p = line; (p < line + len) && (field > 0); p++)
+            field -= (*p == ',');
+        if (field > 0) return 0;
+    }
+    else return 0;
+    uint32_t n = 0;
+    for (; (p < line + len) && (*p != ','); p++) {
+        if ((*p < '0') || (*p > '9')) return 0;
+        n = (n * 10) + (*p - '0');
+    }
+    return n;
+}
+
+/** Moves AT#SRECV socket data out of LTE_Base's receive ring buffer. While
+ *  socketReceive() is running, the data goes straight to its handler;
+ *  otherwise it is stored in data[] like any other payload.
+ *
+ *  @param  buf     Socket data, a view into the receive ring buffer.
+ *  @param  len     Number of bytes.
+ *  @return void
+ */
+void LTE_TCP::handlePayload(const char* buf, uint32_t len) {
+    if (recvHandler == NULL) {
+        LTE_Base::handlePayload(buf, len);
+        return;
+    }
+    recvHandler(buf, len, recvContext);
+    recvLen += len;
+}
+
 /** Clone of the function LTEBase::parseFind(), but for the LTE_TCP buf.
  *  Finds first instance of substring "stringToFind" in the response data from
  *  the socket, and returns the rest of the data AFTER the substring
@@ -395,9 +1620,10 @@ bool LTE_TCP::gprsAttach() {
  *  @return char*           Substr of receiveBuf, starting after stringToFind
  */
 char* LTE_TCP::socketParseFind(const char* stringToFind) {
+    char* receiveBuf = getReceivedData(connectionID);
     if ((stringToFind == NULL) || (stringToFind[0] == '\0') ||
-        (receiveBuf == NULL) || (receiveBuf[0] == '\0'))
-        return false;
+        (receiveBuf[0] == '\0'))
+        return NULL;
   
     char* beginning = strstr(receiveBuf, stringToFind);
     if (beginning == NULL) {
@@ -23,6 +23,66 @@
  * commands for HTTP/SMTP/FTP/etc, and if you are using one of these protocols
  * exclusively, it is worth looking into using the specific AT commands rather
  * than the TCP connection.
+ *
+ * socketOpen() opens a socket in command mode, where every write and read is
+ * an AT#SSEND or AT#SRECV command. socketOpenOnline() opens it in online
+ * data mode instead: after CONNECT the serial port carries socket data
+ * directly, read and written with onlineRead() and onlineWrite(), with no
+ * per-packet command overhead. socketSuspend() sends the "+++" escape to get
+ * back to command mode, and socketResume() goes online again. When the
+ * remote host closes an online socket, the modem sends "NO CARRIER" and
+ * returns to command mode; onlineRead() stops at it and isOnline() turns
+ * false.
+ *
+ * In command mode, socketWrite() sends binary data with AT#SSENDEXT and an
+ * explicit byte count. socketBufferWrite() merges small writes into packets
+ * of the socket's packet size, sent when full or on socketFlush().
+ *
+ * Sockets opened in command mode get SRING notifications with the number
+ * of bytes waiting in the modem. socketAvailable() reports that number
+ * without sending AT commands, and socketReceive() reads exactly that much
+ * instead of polling with AT#SRECV.
+ *
+ * The socket state is cached and kept current from command results and
+ * URCs (SRING, "NO CARRIER: <connId>"), so writes and reads on a connected
+ * socket don't query it with AT#SS first. setStatusMaxAge() bounds how long
+ * the cache is trusted.
+ *
+ * Each of the LE910's six connection IDs has its own socket state and
+ * buffers, so several sockets can be open at once (for example an MQTT
+ * session, an upload and an HTTP fetch). The functions taking a conn_id
+ * address one socket; those without use the socket opened last. Sockets
+ * can also be given a receive handler and serviced in turn from loop()
+ * with serviceSockets(). See LTE_Socket for a per-socket handle.
+ *
+ * The GPRS attach, the PDP context and each connection ID's AT#SCFG and
+ * AT#SCFGEXT settings are tracked too. socketClose() leaves the context
+ * active, and socketOpen() only sends the commands whose state changed, so
+ * reopening a socket with the same settings is a single AT#SD dial. If
+ * that dial fails because the network dropped the context, it is activated
+ * again and the dial retried once. pdpDeactivate() releases the context.
+ *
+ * With setDNSCache(), socketOpen() resolves host names itself with
+ * AT#QDNS and dials the IP address, keeping up to DNS_CACHE_SIZE results
+ * for a fixed time to live. Otherwise the modem looks the name up on every
+ * AT#SD. A failed dial to a cached address resolves the name again.
+ *
+ * Connection ID SSL_CONN_ID is the modem's SSL socket: TLS runs in the
+ * LE910's own SSL engine (AT#SSLD, AT#SSLSENDEXT, AT#SSLRECV), and the
+ * socket is opened, written, read and closed with the same functions as
+ * the plain ones, e.g. socketOpen(host, 443, SSL_CONN_ID). Certificates
+ * are loaded into the modem with sslSetCertificate(), and sslSetAuthMode()
+ * selects how the server is checked. The TLS session is kept when the
+ * socket closes, so reconnecting to the same server resumes it instead of
+ * doing a full handshake (see setSSLSessionReuse()).
+ *
+ * socketOpenUDP() opens a UDP socket (AT#SD txProt 1) on connection IDs
+ * 1-6, with no handshake to wait for and nothing to tear down. Each
+ * socketWrite() of up to MAX_SSEND_SIZE bytes is one datagram to the
+ * address given when opening, and socketSendTo() sends one to any other
+ * address (AT#SSENDUDPEXT). socketReceiveFrom() reads exactly one
+ * datagram and tells where it came from, so datagram boundaries are kept;
+ * socketReceive() reads the pending bytes as one stream.
  */
 
 
@@ -36,49 +96,202 @@
 #include "LTE_Base.h"
 
 #define DEFAULT_CONN_ID 1
+#define MAX_SOCKETS     6              // LE910 connection IDs 1-6
 #define DEFAULT_CID     3              // PDP context ID.
 #define RECV_BUF_SIZE   10000
 #define DEFAULT_APN     "vzwinternet"  // Change to your APN.
 #define MAX_SRECV_SIZE  1500           // AT#SRECV size. Should not be changed.
+#define MAX_SSEND_SIZE  1500           // AT#SSENDEXT size limit.
+#define SRING_MODE      1              // AT#SCFGEXT srMode, SRING with size
+#define ESCAPE_GUARD_TIME 1000         // "+++" guard time (ms), ATS12 default
+#define ESCAPE_DRAIN_TIME 10           // Idle gap (ms) ending data before "+++"
+#define DNS_CACHE_SIZE  4              // Host names kept by the DNS cache
+#define DNS_HOST_SIZE   64             // Longest host name cached
+#define DNS_DEFAULT_TTL 300            // Seconds a cached address is used
+#define DNS_TIMEOUT     20000          // AT#QDNS response time (ms)
+#define SSL_CONN_ID     7              // Connection ID of the SSL socket
+#define NUM_SOCKETS     SSL_CONN_ID    // TCP sockets plus the SSL socket
+#define SSL_ID          1              // LE910 SSId, only 1 is supported
+#define MAX_SSLSEND_SIZE 1023          // AT#SSLSENDEXT size limit
+#define MAX_SSLRECV_SIZE 1000          // AT#SSLRECV size limit
+
+// sslSetCertificate() types, AT#SSLSECDATA DataType
+#define SSL_CERT_CLIENT 0
+#define SSL_CERT_CA     1
+#define SSL_KEY_CLIENT  2
+
+// sslSetAuthMode() modes, AT#SSLSECCFG auth_mode
+#define SSL_AUTH_NONE   0              // No server check
+#define SSL_AUTH_SERVER 1              // Server checked against the CA cert
+#define SSL_AUTH_MUTUAL 2              // Server and client certificates
+
+// Called by socketReceive() with each chunk of received socket data
+typedef void (*SocketDataHandler)(const char* buf, uint32_t len,
+                                  void* context);
 
 class LTE_TCP : public LTE_Base {
 public:
     LTE_TCP(HardwareSerial* telitPort, HardwareSerial* debugPort = NULL);
-    virtual bool init(uint32_t lte_band, char* apn = DEFAULT_APN);
+    virtual bool init(uint32_t lte_band, const char* apn = DEFAULT_APN);
 
-    char* receivedData() {
-        return (receiveBuf == NULL) ? (char*) "" : receiveBuf;
-    }
+    char* receivedData() { return getReceivedData(connectionID); }
 
-    // TCP/IP stack
+    // TCP/IP stack. Functions without a conn_id use the socket opened last
     bool socketOpen(char* r_ip, int r_port = 80, int conn_id = DEFAULT_CONN_ID,
                     int packet_size = 300, int inactivity_timeout = 180,
                     int connection_timeout = 600);
     bool socketReady();
     int getSocketStatus();
+    void setStatusMaxAge(uint32_t ms);
     int socketWrite(char* str);
+    int socketWrite(const uint8_t* buf, size_t len);
+    int socketBufferWrite(const uint8_t* buf, size_t len);
+    bool socketFlush();
+    int socketAvailable();
     int socketReceive();
+    int socketReceive(char* buf, int len);
+    int socketReceive(SocketDataHandler handler, void* context = NULL,
+                      int maxBytes = 0);
     bool socketClose();
-    char* getReceivedData() { return (receiveBuf == NULL) ? (char*) "" : receiveBuf; };
+    char* getReceivedData() { return getReceivedData(connectionID); };
+
+    // Several sockets at once, addressed by connection ID (1-6)
+    bool socketReady(int conn_id);
+    int getSocketStatus(int conn_id);
+    int socketWrite(int conn_id, const uint8_t* buf, size_t len);
+    int socketBufferWrite(int conn_id, const uint8_t* buf, size_t len);
+    bool socketFlush(int conn_id);
+    int socketAvailable(int conn_id);
+    int socketReceive(int conn_id, char* buf, int len);
+    int socketReceive(int conn_id, SocketDataHandler handler,
+                      void* context = NULL, int maxBytes = 0);
+    bool socketClose(int conn_id);
+    char* getReceivedData(int conn_id);
+    const char* getRemoteHost(int conn_id);
+    int getRemotePort(int conn_id);
+    int getPacketSize(int conn_id);
+    bool isUDP(int conn_id);
+    bool setReceiveHandler(int conn_id, SocketDataHandler handler,
+                           void* context = NULL);
+    int serviceSockets();
+
+    // UDP sockets, connection IDs 1-6
+    bool socketOpenUDP(char* r_ip, int r_port, int conn_id = DEFAULT_CONN_ID,
+                       int local_port = 0, int packet_size = 300,
+                       int inactivity_timeout = 180);
+    int socketSendTo(int conn_id, const uint8_t* buf, size_t len,
+                     const char* ip, int port);
+    int socketReceiveFrom(int conn_id, char* buf, int len, char* ip = NULL,
+                          int* port = NULL);
+
+    // Online data mode
+    bool socketOpenOnline(char* r_ip, int r_port = 80,
+                          int conn_id = DEFAULT_CONN_ID, int packet_size = 300,
+                          int inactivity_timeout = 180,
+                          int connection_timeout = 600);
+    int onlineWrite(const char* buf, int len);
+    int onlineRead(char* buf, int len, uint32_t timeout = 1000);
+    bool socketSuspend();
+    bool socketResume();
+    bool isOnline();
+
+    // SSL socket, SSL_CONN_ID
+    bool sslSetCertificate(int type, const uint8_t* data, size_t len);
+    bool sslSetAuthMode(int mode);
+    void setSSLSessionReuse(bool enable);
+
+    // DNS cache
+    void setDNSCache(bool enable, uint32_t ttl = DNS_DEFAULT_TTL);
+    bool resolveHost(const char* host, char* ip);
+    void clearDNSCache();
 
     // Other utility functions
     void reset();
     bool gprsAttach();
+    bool pdpDeactivate();
     char* socketParseFind(const char* stringToFind);
 
+protected:
+    virtual uint32_t payloadLength(const char* line, uint32_t len);
+    virtual void handlePayload(const char* buf, uint32_t len);
+
 private:
-    int connectionID;   // Socket ID. Numbers 1-6
+    struct Socket {             // State of one connection ID
+        char remoteIP[256];     // Remote IP or URL to be solved by DNS query
+        int remotePort;         // Remote TCP port
+        int status;             // See getSocketStatus(). Cached
+        bool statusValid;       // status is known
+        uint32_t statusTime;    // millis() when status was last known
+        int packetSize;         // pkt_size, socketBufferWrite() threshold
+        bool configured;        // AT#SCFG applied with the values below
+        int inactivityTimeout;  // Last applied AT#SCFG maxTo
+        int connTimeout;        // Last applied AT#SCFG connTo
+        bool extConfigured;     // AT#SCFGEXT and AT#SCFGEXT2 applied
+        bool udp;               // Opened with AT#SD txProt 1
+        int localPort;          // AT#SD lPort of a UDP socket
+        uint8_t* sendBuf;       // socketBufferWrite() data, MAX_SSEND_SIZE
+        uint32_t sendLen;       // Bytes in sendBuf
+        char* receiveBuf;       // socketReceive() data, RECV_BUF_SIZE
+        int recvSize;
+        bool sringEnabled;      // Modem sends "SRING: <connId>,<bytes>"
+        uint32_t pendingBytes;  // Bytes waiting in the modem, from SRING
+        SocketDataHandler dataHandler;  // Used by serviceSockets()
+        void* dataContext;
+    };
+    struct DNSEntry {           // One cached AT#QDNS result
+        char host[DNS_HOST_SIZE + 1];   // "" if the entry is free
+        char ip[16];
+        uint32_t time;          // millis() when resolved
+    };
+    struct RecvCopy {           // Context of copyReceived()
+        char* buf;
+        uint32_t size;
+        uint32_t len;
+    };
+    static void copyReceived(const char* buf, uint32_t len, void* context);
+    static void onSRING(const char* line, uint32_t len, void* context);
+    static void onNoCarrier(const char* line, uint32_t len, void* context);
+    static void onSSLSRING(const char* line, uint32_t len, void* context);
+    Socket* findSocket(int conn_id);
+    bool statusFresh(Socket* s);
+    void setStatus(Socket* s, int status);
+    bool sendPacket(int conn_id, const uint8_t* buf, size_t len,
+                    const char* ip = NULL, int port = 0);
+    bool openSocket(char* r_ip, int r_port, int conn_id, int pkt_size,
+                    int inactivity_timeo, int conn_timeo, int conn_mode,
+                    bool udp = false, int local_port = 0);
+    bool activateContext();
+    bool contextLost();
+    void contextClosed();
+    bool dialSocket(char* r_ip, int r_port, int conn_id, int conn_timeo,
+                    int conn_mode);
+    DNSEntry* findDNS(const char* host);
+    bool queryDNS(const char* host, char* ip);
+    static bool isIPAddress(const char* host);
+    bool sslEnable();
+
+    int connectionID;   // Socket opened last, or the online socket
     int cid;            // PDP context ID. For LE910, numbers 1-3
 
     char hostIP[40];
-    char remoteIP[256]; // String containing remote IP or URL to be solved
-                        // by DNS query. Ex: "123.456.789" or "www.google.com"
+    bool attached;      // GPRS attach known to be done
+    bool pdpActive;     // PDP context cid known to be active
+    bool dnsEnabled;    // socketOpen() resolves names through the cache
+    uint32_t dnsTTL;    // Seconds a cached address is used
+    DNSEntry dnsCache[DNS_CACHE_SIZE];
+    bool sslEnabled;    // AT#SSLEN applied
+    bool sslReuse;      // Keep the TLS session when the SSL socket closes
+    Socket sockets[NUM_SOCKETS];    // Connection IDs 1-6, SSL_CONN_ID
+    uint32_t statusMaxAge;  // Trust cached states this long, 0 for no bound
+    int nextService;        // Socket serviceSockets() starts with
 
-    int remotePort;     // Remote TCP port
-    int socketStatus;   // See getSocketStatus()
+    SocketDataHandler recvHandler;  // Where handlePayload() sends data
+    void* recvContext;
+    uint32_t recvLen;               // Bytes passed to recvHandler
 
-    char* receiveBuf;
-    int recvSize;
+    uint32_t lastOnlineWrite;       // millis() of last online mode write
+    uint8_t carrierMatch;           // Bytes of "NO CARRIER" held back by
+                                    // onlineRead()
 };
 
 #endif
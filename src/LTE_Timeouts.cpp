@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ */
+
+
+#ifndef LTE_LTE_TIMEOUTS_
+#define LTE_LTE_TIMEOUTS_
+
+#include <string.h>
+
+#include "LTE_Timeouts.h"
+
+// Floor, default and cap (ms) of each class, in TIMEOUT_* order
+static const uint32_t classLimits[TIMEOUT_CLASSES][3] = {
+    {  300, 1000,  5000 },      // TIMEOUT_LOCAL
+    { 1000, 2000, 10000 },      // TIMEOUT_CONFIG
+    { 1000, 2000, 10000 },      // TIMEOUT_SOCKET
+    { 3000, 5000, 30000 }       // TIMEOUT_NETWORK
+};
+
+static const char* const classNames[TIMEOUT_CLASSES] = {
+    "local", "config", "socket", "network"
+};
+
+// Commands that are not TIMEOUT_LOCAL, by name as in LTE_Base. Some are
+// slow only when they change something: their read ("?") and test ("=?")
+// forms are answered by the modem itself.
+struct CommandClass {
+    const char* name;
+    uint8_t cls;
+    bool setOnly;       // Read and test forms are TIMEOUT_LOCAL
+};
+static const CommandClass commandClasses[] = {
+    { "+CGDCONT",       TIMEOUT_CONFIG, false },
+    { "+IPR",           TIMEOUT_CONFIG, false },
+    { "+IFC",           TIMEOUT_CONFIG, false },
+    { "&W",             TIMEOUT_CONFIG, false },
+    { "#BND",           TIMEOUT_CONFIG, false },
+    { "#SCFG",          TIMEOUT_CONFIG, false },
+    { "#SCFGEXT",       TIMEOUT_CONFIG, false },
+    { "#SCFGEXT2",      TIMEOUT_CONFIG, false },
+    { "#SSLEN",         TIMEOUT_CONFIG, false },
+    { "#SSLCFG",        TIMEOUT_CONFIG, false },
+    { "#SSLSECCFG",     TIMEOUT_CONFIG, false },
+    { "#SSLSECDATA",    TIMEOUT_CONFIG, false },
+    { "#SRECV",         TIMEOUT_SOCKET, false },
+    { "#SSEND",         TIMEOUT_SOCKET, false },
+    { "#SSENDEXT",      TIMEOUT_SOCKET, false },
+    { "#SSENDUDPEXT",   TIMEOUT_SOCKET, false },
+    { "#SSLRECV",       TIMEOUT_SOCKET, false },
+    { "#SSLSENDEXT",    TIMEOUT_SOCKET, false },
+    { "#SS",            TIMEOUT_SOCKET, false },
+    { "#SSLS",          TIMEOUT_SOCKET, false },
+    { "#SI",            TIMEOUT_SOCKET, false },
+    { "#SO",            TIMEOUT_SOCKET, false },
+    { "#SH",            TIMEOUT_SOCKET, false },
+    { "#SSLH",          TIMEOUT_SOCKET, false },
+    { "#SGACT",         TIMEOUT_NETWORK, false },
+    { "#SD",            TIMEOUT_NETWORK, false },
+    { "#SSLD",          TIMEOUT_NETWORK, false },
+    { "#QDNS",          TIMEOUT_NETWORK, false },
+    { "+CGATT",         TIMEOUT_NETWORK, true },
+    { "+CGACT",         TIMEOUT_NETWORK, true },
+    { "+COPS",          TIMEOUT_NETWORK, true }
+};
+
+
+/** Timeout policy constructor. Every class starts at its default.
+ */
+LTE_Timeouts::LTE_Timeouts() {
+    for (int i = 0; i < TIMEOUT_CLASSES; i++) {
+        classes[i].floorMs = classLimits[i][0];
+        classes[i].defaultMs = classLimits[i][1];
+        classes[i].capMs = classLimits[i][2];
+    }
+    reset();
+}
+
+/** Forgets all samples, so every class is back at its default deadline.
+ *  Limits set with setLimits() are kept.
+ *
+ *  @return void
+ */
+void LTE_Timeouts::reset() {
+    for (int i = 0; i < TIMEOUT_CLASSES; i++) {
+        Class* c = &classes[i];
+        c->next = 0;
+        c->count = 0;
+        c->total = 0;
+        c->timedOut = 0;
+        c->backoff = 0;
+        update(c);
+    }
+}
+
+/** Sets the shortest and longest deadline of a class.
+ *
+ *  @param  cls     TIMEOUT_LOCAL, TIMEOUT_CONFIG, TIMEOUT_SOCKET or
+ *                  TIMEOUT_NETWORK.
+ *  @param  floorMs Shortest deadline (ms), at least 1.
+ *  @param  capMs   Longest deadline (ms), at least floorMs.
+ *  @return bool    False if an argument is out of range.
+ */
+bool LTE_Timeouts::setLimits(uint8_t cls, uint32_t floorMs, uint32_t capMs) {
+    if ((cls >= TIMEOUT_CLASSES) || (floorMs == 0) || (capMs < floorMs))
+        return false;
+    classes[cls].floorMs = floorMs;
+    classes[cls].capMs = capMs;
+    update(&classes[cls]);
+    return true;
+}
+
+/** Adds the response time of a command to its class, replacing the oldest
+ *  sample once TIMEOUT_SAMPLES are kept.
+ *
+ *  @param  cls         Class of the command, see classify().
+ *  @param  ms          Time from sending the command to its final result
+ *                      code, or until it was given up.
+ *  @param  timedOut    True if no final result code arrived.
+ *  @return void
+ */
+void LTE_Timeouts::record(uint8_t cls, uint32_t ms, bool timedOut) {
+    if (cls >= TIMEOUT_CLASSES) return;
+    Class* c = &classes[cls];
+    c->total++;
+    if (timedOut) {
+        // How long the response would have taken is unknown, so there is
+        // no sample, only a longer deadline for the next command
+        c->timedOut++;
+        if (c->timeoutMs < c->capMs) c->backoff++;
+        update(c);
+        return;
+    }
+    if ((c->backoff > 0) && (ms <= c->learnedMs)) c->backoff--;
+    if (ms > 0xFFFF) ms = 0xFFFF;
+    c->samples[c->next] = (uint16_t) ms;
+    c->next = (c->next + 1) % TIMEOUT_SAMPLES;
+    if (c->count < TIMEOUT_SAMPLES) c->count++;
+    update(c);
+}
+
+/** Returns the class of a command.
+ *
+ *  @param  name    Command name without "AT", e.g. "+CGATT" for
+ *                  "AT+CGATT=1".
+ *  @param  query   True for the read ("AT+CGATT?") or test ("AT+CGATT=?")
+ *                  form of the command.
+ *  @return uint8_t TIMEOUT_* class, TIMEOUT_LOCAL if not listed.
+ */
+uint8_t LTE_Timeouts::classify(const char* name, bool query) {
+    for (size_t i = 0; i < sizeof(commandClasses) / sizeof(commandClasses[0]);
+         i++)
+        if (strcmp(commandClasses[i].name, name) == 0)
+            return (query && commandClasses[i].setOnly) ?
+                   TIMEOUT_LOCAL : commandClasses[i].cls;
+    return TIMEOUT_LOCAL;
+}
+
+/** Returns the current deadline of a class.
+ *
+ *  @param  cls         TIMEOUT_* class.
+ *  @return uint32_t    Deadline (ms), 0 if cls is out of range.
+ */
+uint32_t LTE_Timeouts::getTimeout(uint8_t cls) {
+    return (cls < TIMEOUT_CLASSES) ? classes[cls].timeoutMs : 0;
+}
+
+/** Returns the TIMEOUT_PERCENTILE response time of a class.
+ *
+ *  @param  cls         TIMEOUT_* class.
+ *  @return uint32_t    Response time (ms), 0 before TIMEOUT_MIN_SAMPLES.
+ */
+uint32_t LTE_Timeouts::getLatency(uint8_t cls) {
+    return (cls < TIMEOUT_CLASSES) ? classes[cls].latencyMs : 0;
+}
+
+/** Returns the number of commands recorded for a class since the last
+ *  reset(), including those that timed out.
+ *
+ *  @param  cls         TIMEOUT_* class.
+ *  @return uint32_t
+ */
+uint32_t LTE_Timeouts::getSamples(uint8_t cls) {
+    return (cls < TIMEOUT_CLASSES) ? classes[cls].total : 0;
+}
+
+/** Returns the number of commands of a class that timed out since the last
+ *  reset().
+ *
+ *  @param  cls         TIMEOUT_* class.
+ *  @return uint32_t
+ */
+uint32_t LTE_Timeouts::getTimedOut(uint8_t cls) {
+    return (cls < TIMEOUT_CLASSES) ? classes[cls].timedOut : 0;
+}
+
+/** Prints one line per class: samples, timeouts, percentile response time
+ *  and deadline in ms, and the deadline's floor and cap.
+ *
+ *  @param  out     Where to print, e.g. &Serial.
+ *  @return void
+ */
+void LTE_Timeouts::dump(Print* out) {
+    if (out == NULL) return;
+    out->print("class samples t/o p");
+    out->print((long) TIMEOUT_PERCENTILE);
+    out->print("_ms timeout_ms floor_ms cap_ms\r\n");
+    for (int i = 0; i < TIMEOUT_CLASSES; i++) {
+        Class* c = &classes[i];
+        out->print(classNames[i]);
+        out->print(' '); out->print((long) c->total);
+        out->print(' '); out->print((long) c->timedOut);
+        out->print(' '); out->print((long) c->latencyMs);
+        out->print(' '); out->print((long) c->timeoutMs);
+        out->print(' '); out->print((long) c->floorMs);
+        out->print(' '); out->print((long) c->capMs);
+        out->print("\r\n");
+    }
+}
+
+/** Recomputes the percentile response time and the deadline of a class,
+ *  with its backoff.
+ *
+ *  @param  c       Class.
+ *  @return void
+ */
+void LTE_Timeouts::update(Class* c) {
+    if (c->count < TIMEOUT_MIN_SAMPLES) {
+        c->latencyMs = 0;
+        c->learnedMs = c->defaultMs;
+    }
+    else {
+        // Sort a copy; the ring keeps the order samples arrived in
+        uint16_t sorted[TIMEOUT_SAMPLES];
+        for (int i = 0; i < c->count; i++) {
+            uint16_t s = c->samples[i];
+            int j = i;
+            for (; (j > 0) && (sorted[j - 1] > s); j--)
+                sorted[j] = sorted[j - 1];
+            sorted[j] = s;
+        }
+        int rank = (c->count * TIMEOUT_PERCENTILE + 99) / 100;
+        c->latencyMs = sorted[(rank > 0) ? rank - 1 : 0];
+        c->learnedMs = c->latencyMs * TIMEOUT_MARGIN;
+    }
+    if (c->learnedMs < c->floorMs) c->learnedMs = c->floorMs;
+    if (c->learnedMs > c->capMs) c->learnedMs = c->capMs;
+
+    c->timeoutMs = c->learnedMs;
+    for (int i = 0; (i < c->backoff) && (c->timeoutMs < c->capMs); i++)
+        c->timeoutMs *= TIMEOUT_MARGIN;
+    if (c->timeoutMs > c->capMs) c->timeoutMs = c->capMs;
+}
+
+#endif
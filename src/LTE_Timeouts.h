@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016 by Wenlong Xiong <wenlongx@ucla.edu>
+ * Serial AT Command Library for Telit LE910SV module and Energia.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ *
+ * The LTE_Timeouts class decides how long LTE_Base waits for the modem to
+ * answer a command. AT commands fall into a few classes with very different
+ * response times: the modem answers most commands itself within
+ * milliseconds, but a command that writes non-volatile memory, moves
+ * socket data or waits for the network takes longer, and much longer under
+ * poor radio conditions.
+ *
+ * For each class the latest TIMEOUT_SAMPLES response times (from sending
+ * the command to its final result code) are kept, and the deadline is the
+ * TIMEOUT_PERCENTILE of them times TIMEOUT_MARGIN, kept between the class's
+ * floor and cap. Until TIMEOUT_MIN_SAMPLES responses were seen, a fixed
+ * default is used instead. A command that times out adds no sample, but
+ * multiplies the deadline by TIMEOUT_MARGIN again, up to the cap, so a
+ * retry waits longer while the modem is slow; each response that arrives
+ * within the learned deadline takes one such step back.
+ *
+ * receiveData(), getCommandOK(), queueCommand() and LTE_Command::sendOK()
+ * use these deadlines unless they are given a timeout. getTimeouts()
+ * returns the policy, to read the estimates or change the limits:
+ *
+ *     lte.getTimeouts()->setLimits(TIMEOUT_NETWORK, 5000, 120000);
+ *     lte.getTimeouts()->dump(&Serial);
+ */
+
+
+#ifndef LTE_LTE_TIMEOUTS_H_
+#define LTE_LTE_TIMEOUTS_H_
+
+#include <Energia.h>
+
+#define TIMEOUT_AUTO        0xFFFFFFFFUL    // Timeout argument: use the policy
+
+// Command classes
+#define TIMEOUT_LOCAL       0   // Answered by the modem, e.g. ATE0, AT+CGATT?
+#define TIMEOUT_CONFIG      1   // Stored in NVM, e.g. AT+CGDCONT, AT#SCFG
+#define TIMEOUT_SOCKET      2   // Socket data, e.g. AT#SRECV, AT#SSENDEXT
+#define TIMEOUT_NETWORK     3   // Network round trip, e.g. AT#SGACT, AT#SD,
+                                // AT+CGATT=1 (but not AT+CGATT?)
+#define TIMEOUT_CLASSES     4
+
+#define TIMEOUT_SAMPLES     20  // Response times kept per class
+#define TIMEOUT_MIN_SAMPLES 5   // Samples needed before the default is left
+#define TIMEOUT_PERCENTILE  95  // Percentile of the samples the deadline uses
+#define TIMEOUT_MARGIN      3   // Deadline = percentile * margin
+
+
+class LTE_Timeouts {
+public:
+    LTE_Timeouts();
+    void reset();
+    bool setLimits(uint8_t cls, uint32_t floorMs, uint32_t capMs);
+    void record(uint8_t cls, uint32_t ms, bool timedOut);
+    static uint8_t classify(const char* name, bool query = false);
+
+    uint32_t getTimeout(uint8_t cls);
+    uint32_t getLatency(uint8_t cls);
+    uint32_t getSamples(uint8_t cls);
+    uint32_t getTimedOut(uint8_t cls);
+    void dump(Print* out);
+
+private:
+    struct Class {
+        uint16_t samples[TIMEOUT_SAMPLES];  // Latest response times (ms)
+        uint8_t next;           // Oldest sample, replaced next
+        uint8_t count;          // Samples kept
+        uint32_t total;         // Commands recorded
+        uint32_t timedOut;      // Of which timed out, without a sample
+        uint32_t floorMs;
+        uint32_t capMs;
+        uint32_t defaultMs;     // Used until TIMEOUT_MIN_SAMPLES
+        uint32_t latencyMs;     // TIMEOUT_PERCENTILE of samples[]
+        uint32_t learnedMs;     // Deadline from latencyMs
+        uint32_t timeoutMs;     // Current deadline, after backoff
+        uint8_t backoff;        // Timeouts not yet taken back
+    };
+
+    void update(Class* c);
+
+    Class classes[TIMEOUT_CLASSES];
+};
+
+#endif